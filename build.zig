@@ -6,6 +6,7 @@ const LibBuildOpts = struct {
     optimize: std.builtin.OptimizeMode,
     baremetal: bool,
     bit32: bool,
+    profile: bool,
 };
 
 fn addEngineSources(b: *std.Build, opts: LibBuildOpts) *std.Build.Module {
@@ -28,6 +29,7 @@ fn addEngineSources(b: *std.Build, opts: LibBuildOpts) *std.Build.Module {
         .flags = &.{
             if (opts.baremetal) "-DNN_BAREMETAL" else "",
             if (opts.bit32) "-DNN_BIT32" else "",
+            if (opts.profile) "-DNN_PROFILE" else "",
             if (strict) "-Wall" else "",
             if (strict) "-Werror" else "",
             "-std=gnu23",
@@ -139,6 +141,7 @@ pub fn build(b: *std.Build) !void {
         .optimize = optimize,
         .baremetal = b.option(bool, "baremetal", "Compiles without libc integration") orelse false,
         .bit32 = target.result.ptrBitWidth() == 32,
+        .profile = b.option(bool, "profile", "Compiles in the invocation profiler") orelse false,
     };
 
     const noEmu = b.option(bool, "noEmu", "Disable compiling the emulator (fixes some build system quirks)") orelse false;
@@ -169,6 +172,28 @@ pub fn build(b: *std.Build) !void {
     sharedStep.dependOn(&includeFiles.step);
     sharedStep.dependOn(&b.addInstallArtifact(engineShared, .{}).step);
 
+    const bench = b.addExecutable(.{
+        .name = "neonucleus-bench",
+        .root_module = b.addModule("bench", .{
+            .target = target,
+            .optimize = optimize,
+        }),
+    });
+    bench.linkLibC();
+    bench.addCSourceFiles(.{
+        .files = &.{
+            "src/bench.c",
+        },
+        .flags = &.{
+            if (opts.bit32) "-DNN_BIT32" else "",
+        },
+    });
+    bench.linkLibrary(engineStatic);
+
+    const benchStep = b.step("bench", "Builds and runs the headless microbenchmarks");
+    benchStep.dependOn(&b.addInstallArtifact(bench, .{}).step);
+    benchStep.dependOn(&b.addRunArtifact(bench).step);
+
     if (!noEmu) {
         const emulator = b.addExecutable(.{
             .name = "neonucleus",
@@ -205,6 +230,31 @@ pub fn build(b: *std.Build) !void {
         emulator.linkLibrary(l);
         emulator.linkLibrary(engineStatic);
 
+        // headless, so it shares Lua but not raylib
+        const loadtest = b.addExecutable(.{
+            .name = "neonucleus-load",
+            .root_module = b.addModule("loadtest", .{
+                .target = target,
+                .optimize = optimize,
+            }),
+        });
+        loadtest.linkLibC();
+        loadtest.addCSourceFiles(.{
+            .files = &.{
+                "src/luaarch.c",
+                "src/loadtest.c",
+            },
+            .flags = &.{
+                if (opts.bit32) "-DNN_BIT32" else "",
+            },
+        });
+        try includeTheRightLua(b, loadtest, luaVer);
+        loadtest.linkLibrary(l);
+        loadtest.linkLibrary(engineStatic);
+
+        const loadStep = b.step("load", "Builds the headless multi-computer load test");
+        loadStep.dependOn(&b.addInstallArtifact(loadtest, .{}).step);
+
         const emulatorStep = b.step("emulator", "Builds the emulator");
         emulatorStep.dependOn(&emulator.step);
         emulatorStep.dependOn(&b.addInstallArtifact(emulator, .{}).step);
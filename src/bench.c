@@ -0,0 +1,664 @@
+// Headless microbenchmarks for NN.
+// Every benchmark runs a fixed amount of iterations, so runs are comparable,
+// and the results are printed as JSON to stdout.
+// Build with make bench MODE=release, as the default mode has sanitizers.
+
+#include "neonucleus.h"
+#include "ncomplib.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static bool bench_first = true;
+
+static double bench_now(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void bench_report(const char *name, size_t iterations, double seconds) {
+	printf("%s\n\t\t{\"name\": \"%s\", \"iterations\": %zu, \"seconds\": %.6f, \"nsPerOp\": %.2f}",
+		bench_first ? "" : ",", name, iterations, seconds, seconds * 1e9 / iterations);
+	bench_first = false;
+}
+
+// a fixed LCG, so every run looks up the same sequence
+static size_t bench_rand(size_t *state) {
+	*state = *state * 6364136223846793005ull + 1442695040888963407ull;
+	return *state >> 33;
+}
+
+static nn_Exit bench_nopHandler(nn_ComponentRequest *req) {
+	if(req->action == NN_COMP_CHECKMETHOD) req->methodEnabled = true;
+	return NN_OK;
+}
+
+#define BENCH_LOOKUPS 1000000
+
+static void bench_componentLookup(nn_Universe *u, size_t count) {
+	char name[64];
+	nn_Computer *C = nn_createComputer(u, NULL, NULL, 1 * NN_MiB, count, 16);
+	nn_Component **comps = malloc(sizeof(nn_Component *) * count);
+	size_t *hashes = malloc(sizeof(size_t) * count);
+	for(size_t i = 0; i < count; i++) {
+		// random UUIDs, like real addresses
+		comps[i] = nn_createComponent(u, NULL, "bench");
+		nn_setComponentHandler(comps[i], bench_nopHandler);
+		nn_mountComponent(C, comps[i], i, true);
+		hashes[i] = nn_strhash(nn_getComponentAddress(comps[i]));
+	}
+
+	size_t found = 0, rng = 1;
+	double start = bench_now();
+	for(size_t i = 0; i < BENCH_LOOKUPS; i++) {
+		size_t j = bench_rand(&rng) % count;
+		found += nn_getComponent(C, nn_getComponentAddress(comps[j])) != NULL;
+	}
+	snprintf(name, sizeof(name), "getComponent/uuid/%zu", count);
+	bench_report(name, BENCH_LOOKUPS, bench_now() - start);
+
+	rng = 1;
+	start = bench_now();
+	for(size_t i = 0; i < BENCH_LOOKUPS; i++) {
+		size_t j = bench_rand(&rng) % count;
+		found += nn_getComponentHashed(C, nn_getComponentAddress(comps[j]), hashes[j]) != NULL;
+	}
+	snprintf(name, sizeof(name), "getComponentHashed/uuid/%zu", count);
+	bench_report(name, BENCH_LOOKUPS, bench_now() - start);
+
+	// addresses which came from the VM, as strings on the stack
+	for(size_t i = 0; i < count; i++) nn_pushstring(C, nn_getComponentAddress(comps[i]));
+	rng = 1;
+	start = bench_now();
+	for(size_t i = 0; i < BENCH_LOOKUPS; i++) {
+		size_t j = bench_rand(&rng) % count;
+		found += nn_tocomponent(C, j) != NULL;
+	}
+	snprintf(name, sizeof(name), "tocomponent/uuid/%zu", count);
+	bench_report(name, BENCH_LOOKUPS, bench_now() - start);
+	nn_clearstack(C);
+
+	if(found != BENCH_LOOKUPS * 3) {
+		fprintf(stderr, "component lookup failed\n");
+		exit(1);
+	}
+
+	for(size_t i = 0; i < count; i++) nn_dropComponent(comps[i]);
+	free(comps);
+	free(hashes);
+	nn_destroyComputer(C);
+}
+
+static void bench_strhash(nn_Context *ctx) {
+	nn_uuid id;
+	nn_randomUUID(ctx, id);
+	size_t sum = 0;
+	double start = bench_now();
+	for(size_t i = 0; i < BENCH_LOOKUPS; i++) {
+		id[i % 36] ^= 1;
+		sum += nn_strhash(id);
+	}
+	bench_report("strhash/uuid", BENCH_LOOKUPS, bench_now() - start);
+	// so it is not optimized out
+	if(sum == 0) fprintf(stderr, "unlucky\n");
+}
+
+static nn_Exit bench_nopArch(nn_ArchitectureRequest *req) {
+	static int state;
+	if(req->action == NN_ARCH_INIT) req->localState = &state;
+	return NN_OK;
+}
+
+// a running computer, so signals are kept
+static nn_Computer *bench_computer(nn_Universe *u) {
+	static nn_Architecture arch = {"bench", NULL, bench_nopArch};
+	nn_Computer *C = nn_createComputer(u, NULL, NULL, 4 * NN_MiB, 64, 16);
+	nn_setArchitecture(C, &arch);
+	nn_setCallBudget(C, nn_unlimitedCallBudget);
+	if(C == NULL || nn_tick(C) != NN_OK) {
+		fprintf(stderr, "computer failed to start\n");
+		exit(1);
+	}
+	return C;
+}
+
+// invokes with the arguments on the stack, dropping the results
+static void bench_call(nn_Computer *C, nn_Component *comp, const char *method) {
+	// the benchmarks are not rate limited
+	nn_resetComponentBudgets(C);
+	nn_resetCallBudget(C);
+	if(nn_invokeComponent(C, nn_getComponentAddress(comp), method) != NN_OK) {
+		fprintf(stderr, "%s failed: %s\n", method, nn_getError(C));
+		exit(1);
+	}
+}
+
+#define BENCH_CALLS 200000
+
+static void bench_invoke(nn_Universe *u) {
+	nn_Computer *C = bench_computer(u);
+	nn_Component *comp = nn_createComponent(u, NULL, "bench");
+	nn_Method methods[] = {
+		{"nop", "function() - Does nothing", NN_DIRECT},
+		{NULL},
+	};
+	nn_setComponentMethods(comp, methods);
+	nn_setComponentHandler(comp, bench_nopHandler);
+	nn_mountComponent(C, comp, 0, true);
+
+	double start = bench_now();
+	for(size_t i = 0; i < BENCH_CALLS; i++) {
+		bench_call(C, comp, "nop");
+	}
+	bench_report("invoke/nop", BENCH_CALLS, bench_now() - start);
+
+	nn_MethodHandle handle;
+	nn_resolveMethod(C, nn_getComponentAddress(comp), "nop", &handle);
+	start = bench_now();
+	for(size_t i = 0; i < BENCH_CALLS; i++) {
+		nn_invokeHandle(C, &handle);
+	}
+	bench_report("invokeHandle/nop", BENCH_CALLS, bench_now() - start);
+
+	nn_dropComponent(comp);
+	nn_destroyComputer(C);
+}
+
+#define BENCH_SIGNALS 100000
+
+static void bench_signals(nn_Universe *u) {
+	nn_Computer *C = bench_computer(u);
+	double start = bench_now();
+	for(size_t i = 0; i < BENCH_SIGNALS; i++) {
+		nn_pushstring(C, "key_down");
+		nn_pushstring(C, "0d6a5a4c-2b7f-4f0e-9a6e-0c0c4e3f9d21");
+		nn_pushnumber(C, 97);
+		nn_pushnumber(C, 30);
+		nn_pushSignal(C, 4);
+		nn_popSignal(C, NULL);
+		nn_clearstack(C);
+	}
+	bench_report("signal/pushpop", BENCH_SIGNALS, bench_now() - start);
+
+	// a full queue, to see the cost of the ring wrapping
+	for(size_t i = 0; i < NN_MAX_SIGNALS / 2; i++) {
+		nn_pushstring(C, "filler");
+		nn_pushSignal(C, 1);
+	}
+	start = bench_now();
+	for(size_t i = 0; i < BENCH_SIGNALS; i++) {
+		nn_pushstring(C, "modem_message");
+		nn_pushnumber(C, i);
+		nn_pushSignal(C, 2);
+		nn_popSignal(C, NULL);
+		nn_clearstack(C);
+	}
+	bench_report("signal/pushpop/queued", BENCH_SIGNALS, bench_now() - start);
+	nn_destroyComputer(C);
+}
+
+#define BENCH_CHURN 2000
+
+// The hashmap is internal, so this goes through the component map, which
+// sees a put on every mount and a removal on every unmount.
+static void bench_hashChurn(nn_Universe *u) {
+	enum { count = 64 };
+	nn_Computer *C = nn_createComputer(u, NULL, NULL, 1 * NN_MiB, count, 16);
+	nn_Component *comps[count];
+	for(size_t i = 0; i < count; i++) {
+		comps[i] = nn_createComponent(u, NULL, "bench");
+		nn_setComponentHandler(comps[i], bench_nopHandler);
+	}
+	size_t rng = 1, found = 0;
+	double start = bench_now();
+	for(size_t i = 0; i < BENCH_CHURN; i++) {
+		for(size_t j = 0; j < count; j++) nn_mountComponent(C, comps[j], j, true);
+		for(size_t j = 0; j < count; j++) {
+			found += nn_getComponent(C, nn_getComponentAddress(comps[bench_rand(&rng) % count])) != NULL;
+		}
+		for(size_t j = 0; j < count; j++) nn_unmountComponent(C, nn_getComponentAddress(comps[j]), true);
+	}
+	bench_report("hashmap/churn/64", BENCH_CHURN * count * 3, bench_now() - start);
+	if(found != BENCH_CHURN * count) {
+		fprintf(stderr, "hashmap churn failed\n");
+		exit(1);
+	}
+	for(size_t i = 0; i < count; i++) nn_dropComponent(comps[i]);
+	nn_destroyComputer(C);
+}
+
+#define BENCH_UNICODE 20000
+
+static void bench_unicode(nn_Context *ctx) {
+	// ASCII, accents, CJK and box drawing, like OpenOS output
+	const char *pattern = "hello, wörld! 你好世界 ┌─┐│└┘ ";
+	char text[1024];
+	size_t len = 0, plen = strlen(pattern);
+	while(len + plen < sizeof(text)) {
+		memcpy(text + len, pattern, plen);
+		len += plen;
+	}
+	size_t sum = 0;
+
+	double start = bench_now();
+	for(size_t i = 0; i < BENCH_UNICODE; i++) sum += nn_unicode_len(text, len);
+	bench_report("unicode/len/1KiB", BENCH_UNICODE, bench_now() - start);
+
+	start = bench_now();
+	for(size_t i = 0; i < BENCH_UNICODE; i++) sum += nn_unicode_wlen(text, len);
+	bench_report("unicode/wlen/1KiB", BENCH_UNICODE, bench_now() - start);
+
+	// what unicode.sub does
+	nn_codepoint *cp = nn_alloc(ctx, sizeof(nn_codepoint) * len);
+	char *buf = nn_alloc(ctx, len);
+	start = bench_now();
+	for(size_t i = 0; i < BENCH_UNICODE; i++) {
+		size_t cplen = nn_unicode_lenPermissive(text, len);
+		nn_unicode_codepointsPermissive(text, len, cp);
+		size_t from = i % (cplen / 2);
+		size_t sublen = cplen / 2;
+		size_t bytes = nn_unicode_countBytes(cp + from, sublen);
+		nn_unicode_writeBytes(buf, cp + from, sublen);
+		sum += bytes;
+	}
+	bench_report("unicode/sub/1KiB", BENCH_UNICODE, bench_now() - start);
+	nn_free(ctx, cp, sizeof(nn_codepoint) * len);
+	nn_free(ctx, buf, len);
+	if(sum == 0) fprintf(stderr, "unlucky\n");
+}
+
+#define BENCH_GPU 20000
+// bitblt onto the screen maps every pixel through the palette
+#define BENCH_BITBLT 50
+
+static void bench_gpu(nn_Universe *u) {
+	nn_Computer *C = bench_computer(u);
+	nn_Component *screen = ncl_createScreen(u, NULL, &nn_defaultScreens[2]);
+	nn_Component *gpu = ncl_createGPU(u, NULL, &nn_defaultGPUs[2]);
+	nn_mountComponent(C, screen, -1, true);
+	nn_mountComponent(C, gpu, 0, true);
+	nn_pushstring(C, nn_getComponentAddress(screen));
+	bench_call(C, gpu, "bind");
+	nn_clearstack(C);
+
+	// the screen, then a VRAM buffer
+	for(int buffer = 0; buffer < 2; buffer++) {
+		char name[64];
+		if(buffer) {
+			nn_pushinteger(C, 160);
+			nn_pushinteger(C, 50);
+			bench_call(C, gpu, "allocateBuffer");
+			nn_clearstack(C);
+			nn_pushinteger(C, 1);
+			bench_call(C, gpu, "setActiveBuffer");
+			nn_clearstack(C);
+		}
+		const char *target = buffer ? "vram" : "screen";
+
+		double start = bench_now();
+		for(size_t i = 0; i < BENCH_GPU; i++) {
+			nn_pushinteger(C, 1 + i % 80);
+			nn_pushinteger(C, 1 + i % 50);
+			nn_pushstring(C, "The quick brown fox jumps over the lazy dog");
+			bench_call(C, gpu, "set");
+			nn_clearstack(C);
+		}
+		snprintf(name, sizeof(name), "gpu/set/%s", target);
+		bench_report(name, BENCH_GPU, bench_now() - start);
+
+		start = bench_now();
+		for(size_t i = 0; i < BENCH_GPU; i++) {
+			nn_pushinteger(C, 1);
+			nn_pushinteger(C, 1);
+			nn_pushinteger(C, 80);
+			nn_pushinteger(C, 25);
+			nn_pushstring(C, i % 2 ? " " : "#");
+			bench_call(C, gpu, "fill");
+			nn_clearstack(C);
+		}
+		snprintf(name, sizeof(name), "gpu/fill/80x25/%s", target);
+		bench_report(name, BENCH_GPU, bench_now() - start);
+
+		start = bench_now();
+		for(size_t i = 0; i < BENCH_GPU; i++) {
+			nn_pushinteger(C, 1);
+			nn_pushinteger(C, 2);
+			nn_pushinteger(C, 80);
+			nn_pushinteger(C, 24);
+			nn_pushinteger(C, 0);
+			nn_pushinteger(C, -1);
+			bench_call(C, gpu, "copy");
+			nn_clearstack(C);
+		}
+		snprintf(name, sizeof(name), "gpu/copy/80x24/%s", target);
+		bench_report(name, BENCH_GPU, bench_now() - start);
+	}
+
+	// the buffer onto the screen
+	double start = bench_now();
+	for(size_t i = 0; i < BENCH_BITBLT; i++) {
+		nn_pushinteger(C, 0);
+		nn_pushinteger(C, 1);
+		nn_pushinteger(C, 1);
+		nn_pushinteger(C, 80);
+		nn_pushinteger(C, 25);
+		nn_pushinteger(C, 1);
+		nn_pushinteger(C, 1);
+		nn_pushinteger(C, 1);
+		bench_call(C, gpu, "bitblt");
+		nn_clearstack(C);
+	}
+	bench_report("gpu/bitblt/80x25", BENCH_BITBLT, bench_now() - start);
+
+	nn_dropComponent(gpu);
+	nn_dropComponent(screen);
+	nn_destroyComputer(C);
+}
+
+#define BENCH_FILE_CHUNK 1024
+#define BENCH_FILE_CHUNKS 64
+#define BENCH_FILES 500
+#define BENCH_APPEND_SIZE 64
+#define BENCH_APPENDS (NN_MiB / BENCH_APPEND_SIZE)
+
+static void bench_tmpfs(nn_Universe *u) {
+	nn_Computer *C = bench_computer(u);
+	nn_Component *fs = ncl_createTmpFS(u, NULL, &nn_defaultFilesystems[3], NCL_FILECOST_DEFAULT, false);
+	nn_mountComponent(C, fs, -1, true);
+	char chunk[BENCH_FILE_CHUNK];
+	memset(chunk, 'x', sizeof(chunk));
+
+	// every round rewrites the same file, so it never fills up
+	double start = bench_now();
+	for(size_t i = 0; i < BENCH_FILES; i++) {
+		nn_pushstring(C, "/bench");
+		nn_pushstring(C, "w");
+		bench_call(C, fs, "open");
+		double fd = nn_tonumber(C, 0);
+		nn_clearstack(C);
+		for(size_t j = 0; j < BENCH_FILE_CHUNKS; j++) {
+			nn_pushnumber(C, fd);
+			nn_pushlstring(C, chunk, sizeof(chunk));
+			bench_call(C, fs, "write");
+			nn_clearstack(C);
+		}
+		nn_pushnumber(C, fd);
+		bench_call(C, fs, "close");
+		nn_clearstack(C);
+	}
+	bench_report("tmpfs/write/1KiB", BENCH_FILES * BENCH_FILE_CHUNKS, bench_now() - start);
+
+	start = bench_now();
+	for(size_t i = 0; i < BENCH_FILES; i++) {
+		nn_pushstring(C, "/bench");
+		nn_pushstring(C, "r");
+		bench_call(C, fs, "open");
+		double fd = nn_tonumber(C, 0);
+		nn_clearstack(C);
+		for(size_t j = 0; j < BENCH_FILE_CHUNKS; j++) {
+			nn_pushnumber(C, fd);
+			nn_pushnumber(C, BENCH_FILE_CHUNK);
+			bench_call(C, fs, "read");
+			nn_clearstack(C);
+		}
+		nn_pushnumber(C, fd);
+		bench_call(C, fs, "close");
+		nn_clearstack(C);
+	}
+	bench_report("tmpfs/read/1KiB", BENCH_FILES * BENCH_FILE_CHUNKS, bench_now() - start);
+
+	// a log growing line by line, to 1 MiB
+	nn_pushstring(C, "/log");
+	nn_pushstring(C, "a");
+	bench_call(C, fs, "open");
+	double fd = nn_tonumber(C, 0);
+	nn_clearstack(C);
+	start = bench_now();
+	for(size_t i = 0; i < BENCH_APPENDS; i++) {
+		nn_pushnumber(C, fd);
+		nn_pushlstring(C, chunk, BENCH_APPEND_SIZE);
+		bench_call(C, fs, "write");
+		nn_clearstack(C);
+	}
+	bench_report("tmpfs/append/64B", BENCH_APPENDS, bench_now() - start);
+	nn_pushnumber(C, fd);
+	bench_call(C, fs, "close");
+	nn_clearstack(C);
+
+	nn_dropComponent(fs);
+	nn_destroyComputer(C);
+}
+
+#define BENCH_SECTORS 100000
+
+static void bench_sectors(nn_Universe *u, nn_Component *device, size_t sectorCount, const char *name) {
+	nn_Computer *C = bench_computer(u);
+	nn_mountComponent(C, device, -1, true);
+	size_t rng = 1;
+	double start = bench_now();
+	for(size_t i = 0; i < BENCH_SECTORS; i++) {
+		nn_pushinteger(C, 1 + bench_rand(&rng) % sectorCount);
+		bench_call(C, device, "readSector");
+		nn_clearstack(C);
+	}
+	bench_report(name, BENCH_SECTORS, bench_now() - start);
+	nn_destroyComputer(C);
+}
+
+#define BENCH_SEQ_CHUNK 64
+
+// a boot loader reading the start of the drive, one sector per call and many per call
+static void bench_sequential(nn_Universe *u, nn_Component *device, size_t sectorCount, const char *single, const char *vectored) {
+	nn_Computer *C = bench_computer(u);
+	nn_mountComponent(C, device, -1, true);
+	size_t total = BENCH_SECTORS - BENCH_SECTORS % BENCH_SEQ_CHUNK;
+	double start = bench_now();
+	for(size_t i = 0; i < total; i++) {
+		nn_pushinteger(C, 1 + i % sectorCount);
+		bench_call(C, device, "readSector");
+		nn_clearstack(C);
+	}
+	bench_report(single, total, bench_now() - start);
+
+	start = bench_now();
+	for(size_t i = 0; i < total; i += BENCH_SEQ_CHUNK) {
+		nn_pushinteger(C, 1 + i % (sectorCount - BENCH_SEQ_CHUNK));
+		nn_pushinteger(C, BENCH_SEQ_CHUNK);
+		bench_call(C, device, "readSectors");
+		nn_clearstack(C);
+	}
+	// per sector, to compare with the single sector reads
+	bench_report(vectored, total, bench_now() - start);
+	nn_destroyComputer(C);
+}
+
+// submitRead on a drive which does not seek, so it is the cost of queueing and completing a request
+static void bench_asyncDrive(nn_Universe *u) {
+	nn_Drive drive = nn_defaultDrives[0];
+	drive.rpm = 0;
+	size_t sectorCount = drive.capacity / drive.sectorSize;
+	nn_Component *d = ncl_createDrive(u, NULL, &drive, NULL, 0, false);
+	ncl_setDriveAsync(d, true);
+	nn_Computer *C = bench_computer(u);
+	nn_mountComponent(C, d, -1, true);
+	size_t total = BENCH_SECTORS - BENCH_SECTORS % NCL_MAX_DRIVEQUEUE;
+	size_t rng = 1;
+	double start = bench_now();
+	for(size_t i = 0; i < total; i += NCL_MAX_DRIVEQUEUE) {
+		for(size_t j = 0; j < NCL_MAX_DRIVEQUEUE; j++) {
+			nn_pushinteger(C, 1 + bench_rand(&rng) % sectorCount);
+			bench_call(C, d, "submitRead");
+			nn_clearstack(C);
+		}
+		size_t done = 0;
+		while(done < NCL_MAX_DRIVEQUEUE) {
+			nn_tick(C);
+			size_t valueCount;
+			while(nn_popSignal(C, &valueCount) == NN_OK) {
+				nn_clearstack(C);
+				done++;
+			}
+		}
+	}
+	bench_report("drive/submitRead", total, bench_now() - start);
+	nn_destroyComputer(C);
+	nn_dropComponent(d);
+}
+
+static void bench_storage(nn_Universe *u) {
+	const nn_Drive *drive = &nn_defaultDrives[0];
+	nn_Component *d = ncl_createDrive(u, NULL, drive, NULL, 0, false);
+	bench_sectors(u, d, drive->capacity / drive->sectorSize, "drive/readSector");
+	bench_sequential(u, d, drive->capacity / drive->sectorSize, "drive/readSector/sequential", "drive/readSectors/64");
+	nn_dropComponent(d);
+	bench_asyncDrive(u);
+
+	const nn_NandFlash *flash = &nn_defaultSSDs[0];
+	nn_Component *f = ncl_createFlash(u, NULL, flash, NULL, 0, false);
+	bench_sectors(u, f, flash->capacity / flash->sectorSize, "flash/readSector");
+	bench_sequential(u, f, flash->capacity / flash->sectorSize, "flash/readSector/sequential", "flash/readSectors/64");
+	nn_dropComponent(f);
+
+	// NULL where files cannot be mapped
+	nn_Component *m = ncl_createDriveFromFile(u, NULL, drive, "neonucleus-bench.img", NULL, false);
+	if(m != NULL) {
+		bench_sectors(u, m, drive->capacity / drive->sectorSize, "fileDrive/readSector");
+		nn_dropComponent(m);
+		remove("neonucleus-bench.img");
+	}
+}
+
+#define BENCH_IMAGE_DRIVES 500
+
+// many drives made from one OS image, each writing a little
+static void bench_diskImage(nn_Universe *u) {
+	const nn_Drive *drive = &nn_defaultDrives[2];
+	char *data = malloc(drive->capacity);
+	for(size_t i = 0; i < drive->capacity; i++) data[i] = (char)i;
+	ncl_DiskImage *image = ncl_createDiskImage(u, data, drive->capacity);
+	free(data);
+	nn_Component **drives = malloc(sizeof(nn_Component *) * BENCH_IMAGE_DRIVES);
+
+	double start = bench_now();
+	for(size_t i = 0; i < BENCH_IMAGE_DRIVES; i++) {
+		drives[i] = ncl_createDriveFromImage(u, NULL, drive, image, false);
+	}
+	bench_report("diskImage/create/500", BENCH_IMAGE_DRIVES, bench_now() - start);
+
+	start = bench_now();
+	for(size_t i = 0; i < BENCH_IMAGE_DRIVES; i++) {
+		ncl_writeDrive(drives[i], i * drive->sectorSize, "written", 7);
+	}
+	bench_report("diskImage/firstWrite", BENCH_IMAGE_DRIVES, bench_now() - start);
+
+	for(size_t i = 0; i < BENCH_IMAGE_DRIVES; i++) nn_dropComponent(drives[i]);
+	free(drives);
+	ncl_releaseDiskImage(image);
+}
+
+#define BENCH_NETWORK 100000
+
+static void bench_network(nn_Universe *u) {
+	nn_Computer *C = bench_computer(u);
+	char payload[256];
+	memset(payload, 'p', sizeof(payload));
+	size_t values = 0;
+
+	double start = bench_now();
+	for(size_t i = 0; i < BENCH_NETWORK; i++) {
+		nn_pushstring(C, "modem_message");
+		nn_pushnumber(C, i);
+		nn_pushbool(C, true);
+		nn_pushlstring(C, payload, sizeof(payload));
+		nn_EncodedNetworkContents contents;
+		nn_encodeNetworkContents(C, &contents, 4);
+		nn_clearstack(C);
+		nn_pushNetworkContents(C, &contents);
+		values += nn_getstacksize(C);
+		nn_clearstack(C);
+		nn_dropNetworkContents(&contents);
+	}
+	bench_report("network/encodeDecode/4", BENCH_NETWORK, bench_now() - start);
+	if(values != BENCH_NETWORK * 4) {
+		fprintf(stderr, "network encode failed\n");
+		exit(1);
+	}
+	nn_destroyComputer(C);
+}
+
+#define BENCH_SNAPSHOTS 50000
+
+static void bench_snapshot(nn_Universe *u) {
+	nn_Context *ctx = nn_getUniverseContext(u);
+	nn_Computer *C = bench_computer(u);
+	nn_Computer *restored = bench_computer(u);
+	nn_Component *comps[8];
+	for(size_t i = 0; i < 8; i++) {
+		comps[i] = nn_createComponent(u, NULL, "bench");
+		nn_mountComponent(C, comps[i], i, true);
+		nn_mountComponent(restored, comps[i], -1, true);
+	}
+	nn_addUser(C, "alice");
+	nn_addUser(C, "bob");
+	nn_CommonDeviceInfo info;
+	nn_clearCommonDeviceInfo(&info);
+	info.CLASS = NN_DEVICECLASS_SYSTEM;
+	info.VENDOR = "NeoNucleus Inc.";
+	nn_addCommonDeviceInfo(C, nn_getComputerAddress(C), info);
+	// a typical backlog of input
+	for(size_t i = 0; i < 8; i++) nn_pushKeyDown(C, nn_getComponentAddress(comps[0]), 'a' + i, 30 + i, "alice");
+
+	char *buf = NULL;
+	size_t len = 0;
+	double start = bench_now();
+	for(size_t i = 0; i < BENCH_SNAPSHOTS; i++) {
+		if(buf != NULL) nn_free(ctx, buf, len);
+		if(nn_snapshotComputer(C, &buf, &len) != NN_OK) {
+			fprintf(stderr, "snapshot failed: %s\n", nn_getError(C));
+			exit(1);
+		}
+	}
+	bench_report("snapshot/8signals", BENCH_SNAPSHOTS, bench_now() - start);
+
+	start = bench_now();
+	for(size_t i = 0; i < BENCH_SNAPSHOTS; i++) {
+		if(nn_deserializeComputer(restored, buf, len) != NN_OK) {
+			fprintf(stderr, "restore failed: %s\n", nn_getError(restored));
+			exit(1);
+		}
+	}
+	bench_report("restore/8signals", BENCH_SNAPSHOTS, bench_now() - start);
+
+	nn_free(ctx, buf, len);
+	nn_destroyComputer(restored);
+	nn_destroyComputer(C);
+	for(size_t i = 0; i < 8; i++) nn_dropComponent(comps[i]);
+}
+
+int main(void) {
+	nn_Context ctx;
+	nn_initContext(&ctx);
+	nn_Universe *u = nn_createUniverse(&ctx, NULL);
+
+	printf("{\n\t\"benchmarks\": [");
+	bench_strhash(&ctx);
+	bench_componentLookup(u, 16);
+	bench_componentLookup(u, 64);
+	bench_componentLookup(u, 128);
+	bench_invoke(u);
+	bench_signals(u);
+	bench_hashChurn(u);
+	bench_unicode(&ctx);
+	bench_gpu(u);
+	bench_tmpfs(u);
+	bench_storage(u);
+	bench_diskImage(u);
+	bench_network(u);
+	bench_snapshot(u);
+	printf("\n\t]\n}\n");
+
+	nn_destroyUniverse(u);
+	return 0;
+}
@@ -0,0 +1,412 @@
+// A headless load test.
+// It boots many computers from the same OS directory through the Lua architecture,
+// feeds them synthetic keyboard and modem signals, and prints aggregate stats as JSON to stdout.
+// It needs neither raylib nor a display, so it can run on any Linux box.
+// Like the emulator, error handling has been omitted in most places.
+//
+// Usage: neonucleus-load [computers] [seconds] [OS directory in data/]
+// NN_TIER, NN_EEPROM and NN_TICKDELAY work like in the emulator.
+// NN_GPU gives every computer a screen and a GPU.
+// NN_INPUTRATE is how many synthetic signals every computer gets per second, 0 for none.
+// NN_INPUT is the text typed into every computer, over and over.
+
+#include "neonucleus.h"
+#include "ncomplib.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+nn_Architecture getLuaArch();
+
+static const char minBIOS[] = {
+#embed "minBIOS.lua"
+,'\0'
+};
+
+// every n-th synthetic signal is a modem message instead of a key press
+#define LOAD_MODEMEVERY 8
+#define LOAD_PORT 1
+
+typedef struct load_Alloc {
+	void *state;
+	nn_AllocProc *alloc;
+	// bytes the host allocated, including computers, components and VMs
+	size_t used;
+	size_t peak;
+} load_Alloc;
+
+typedef struct load_Host {
+	nn_Computer *computer;
+	nn_Component *eeprom;
+	nn_Component *fs;
+	nn_Component *tmpfs;
+	nn_Component *keyboard;
+	nn_Component *modem;
+	// NULL unless NN_GPU is set
+	nn_Component *screen;
+	nn_Component *gpu;
+	double nextTick;
+	double nextInput;
+	// polled from the idle timer wheel, so it is ticked this round
+	bool due;
+	// powered off or crashed, no longer ticked
+	bool dead;
+	size_t inputs;
+	size_t ticks;
+} load_Host;
+
+static double load_now(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void load_sleep(double seconds) {
+	struct timespec ts;
+	ts.tv_sec = seconds;
+	ts.tv_nsec = (seconds - ts.tv_sec) * 1e9;
+	nanosleep(&ts, NULL);
+}
+
+static void *load_alloc(void *state, void *memory, size_t oldSize, size_t newSize) {
+	load_Alloc *a = state;
+	void *mem = a->alloc(a->state, memory, oldSize, newSize);
+	if(newSize == 0) {
+		a->used -= oldSize;
+		return mem;
+	}
+	if(mem == NULL) return NULL;
+	a->used = a->used - oldSize + newSize;
+	if(a->used > a->peak) a->peak = a->used;
+	return mem;
+}
+
+static int load_compareTimes(const void *a, const void *b) {
+	double x = *(const double *)a, y = *(const double *)b;
+	return (x > y) - (x < y);
+}
+
+// [times] must be sorted
+static double load_percentile(const double *times, size_t len, double percentile) {
+	if(len == 0) return 0;
+	size_t i = len * percentile;
+	if(i >= len) i = len - 1;
+	return times[i];
+}
+
+static void load_env(nn_EnvironmentRequest *req) {
+	// unlimited power, this measures the engine and not the power grid
+	if(req->action == NN_ENV_DRAWENERGY) {
+		req->energy = nn_getTotalEnergy(req->computer);
+		return;
+	}
+}
+
+static nn_Exit load_modem(nn_ModemRequest *req) {
+	nn_Computer *C = req->computer;
+
+	if(req->action == NN_MODEM_DROP) {
+		return NN_OK;
+	}
+	if(req->action == NN_MODEM_ISOPEN) {
+		req->isOpen.opened = req->isOpen.port == LOAD_PORT;
+		return NN_OK;
+	}
+	if(req->action == NN_MODEM_OPEN || req->action == NN_MODEM_CLOSE) {
+		return NN_OK;
+	}
+	if(req->action == NN_MODEM_GETPORTS) {
+		req->getPorts.len = 1;
+		req->getPorts.activePorts[0] = LOAD_PORT;
+		return NN_OK;
+	}
+	// nobody is listening
+	if(req->action == NN_MODEM_SEND) {
+		req->send.strengthSent = req->modem->maxRange;
+		return NN_OK;
+	}
+	if(req->action == NN_MODEM_GETWAKEMESSAGE) {
+		req->getWake.len = 0;
+		req->getWake.isFuzzy = false;
+		return NN_OK;
+	}
+	if(req->action == NN_MODEM_SETWAKEMESSAGE) {
+		return NN_OK;
+	}
+
+	if(C) nn_setError(C, "load: modem method not implemented");
+	return NN_EBADCALL;
+}
+
+// OC keycodes of the few non-printable keys we type
+static int load_keycode(char c) {
+	if(c == '\r') return 28;
+	if(c == '\b') return 14;
+	if(c == '\t') return 15;
+	if(c == ' ') return 57;
+	return 0;
+}
+
+// posts the next synthetic input, which wakes the computer if it waits for a signal.
+// Returns how many signals were posted.
+static size_t load_input(nn_Context *ctx, load_Host *host, const char *input) {
+	nn_Computer *C = host->computer;
+	size_t n = host->inputs++;
+	if(n % LOAD_MODEMEVERY == LOAD_MODEMEVERY - 1) {
+		nn_EncodedNetworkContents contents;
+		nn_initNetworkContents(ctx, &contents);
+		nn_appendstring(&contents, "load");
+		nn_appendinteger(&contents, n);
+		const char *modem = nn_getComponentAddress(host->modem);
+		nn_postModemMessage(C, modem, modem, LOAD_PORT, 0, &contents);
+		nn_dropNetworkContents(&contents);
+		return 1;
+	}
+	size_t len = strlen(input);
+	if(len == 0) return 0;
+	char c = input[n % len];
+	const char *keyboard = nn_getComponentAddress(host->keyboard);
+	nn_postKeyDown(C, keyboard, c, load_keycode(c), "load");
+	nn_postKeyUp(C, keyboard, c, load_keycode(c), "load");
+	return 2;
+}
+
+int main(int argc, char **argv) {
+	size_t count = 16;
+	double seconds = 10;
+	const char *mainDir = "openos";
+	if(argc > 1) count = atoi(argv[1]);
+	if(argc > 2) seconds = atof(argv[2]);
+	if(argc > 3) mainDir = argv[3];
+	if(count == 0) count = 1;
+
+	const char *tierStr = getenv("NN_TIER");
+	if(tierStr == NULL) tierStr = "4";
+	int tier = atoi(tierStr);
+	if(tier < 1) tier = 1;
+	if(tier > 4) tier = 4;
+
+	bool withGPU = getenv("NN_GPU") != NULL;
+	double tickDelay = 0.05;
+	if(getenv("NN_TICKDELAY") != NULL) tickDelay = atof(getenv("NN_TICKDELAY"));
+	double inputRate = 5;
+	if(getenv("NN_INPUTRATE") != NULL) inputRate = atof(getenv("NN_INPUTRATE"));
+	double inputDelay = inputRate > 0 ? 1 / inputRate : 0;
+	const char *input = getenv("NN_INPUT");
+	if(input == NULL) input = "ls /\r";
+
+	nn_Context ctx;
+	nn_initContext(&ctx);
+	nn_initPalettes();
+
+	load_Alloc hostAlloc = {
+		.state = ctx.state,
+		.alloc = ctx.alloc,
+		.used = 0,
+		.peak = 0,
+	};
+	ctx.state = &hostAlloc;
+	ctx.alloc = load_alloc;
+
+	char *eepromCode = (char *)minBIOS;
+	size_t eepromSize = strlen(minBIOS);
+	const char *eepromPath = getenv("NN_EEPROM");
+	if(eepromPath != NULL) {
+		FILE *eeprom = fopen(eepromPath, "rb");
+		if(eeprom == NULL) {
+			fprintf(stderr, "no such eeprom: %s\n", eepromPath);
+			return 1;
+		}
+
+		fseek(eeprom, 0, SEEK_END);
+		eepromSize = ftell(eeprom);
+		fseek(eeprom, 0, SEEK_SET);
+
+		eepromCode = malloc(eepromSize);
+		size_t amount = 0;
+		while(amount < eepromSize) {
+			amount += fread(eepromCode + amount, sizeof(char), eepromSize - amount, eeprom);
+		}
+		fclose(eeprom);
+	}
+
+	char mainfspath[NN_MAX_PATH];
+	snprintf(mainfspath, NN_MAX_PATH, "data/%s", mainDir);
+
+	nn_Universe *u = nn_createUniverse(&ctx, NULL);
+	nn_Architecture arch = getLuaArch();
+	size_t ramTotal = 4 * nn_ramSizes[tier*2-1];
+
+	load_Host *hosts = calloc(count, sizeof(load_Host));
+	nn_Computer **due = malloc(sizeof(nn_Computer *) * count);
+	nn_Computer **active = malloc(sizeof(nn_Computer *) * count);
+	size_t timeCap = 4096, timeLen = 0;
+	double *tickTimes = malloc(sizeof(double) * timeCap);
+
+	double start = load_now();
+	for(size_t i = 0; i < count; i++) {
+		load_Host *host = hosts + i;
+		host->eeprom = ncl_createEEPROM(u, NULL, &nn_defaultEEPROMs[3], eepromCode, eepromSize, false);
+		// read-only, as every computer shares the same directory
+		host->fs = ncl_createFilesystem(u, NULL, mainfspath, &nn_defaultFilesystems[tier-1], true);
+		host->tmpfs = ncl_createTmpFS(u, NULL, &nn_defaultTmpFS, NCL_FILECOST_DEFAULT, false);
+		host->keyboard = nn_createComponent(u, NULL, "keyboard");
+		host->modem = nn_createModem(u, NULL, &nn_defaultWirelessModems[1], NULL, load_modem);
+
+		nn_Computer *c = nn_createComputer(u, host, NULL, ramTotal, nn_defaultComponentLimits[tier-1] * 4, 256);
+		host->computer = c;
+		nn_Environment env = {
+			.userdata = NULL,
+			.handler = load_env,
+		};
+		nn_setComputerEnvironment(c, env);
+		nn_setCallBudget(c, nn_defaultCallBudgets[tier-1] * 5);
+		nn_setArchitecture(c, &arch);
+		nn_addSupportedArchitecture(c, &arch);
+		nn_setTmpAddress(c, nn_getComponentAddress(host->tmpfs));
+
+		nn_mountComponent(c, host->tmpfs, -1, false);
+		nn_mountComponent(c, host->keyboard, -1, false);
+		nn_mountComponent(c, host->eeprom, 0, false);
+		nn_mountComponent(c, host->fs, 1, false);
+		nn_mountComponent(c, host->modem, 3, false);
+
+		if(withGPU) {
+			host->screen = ncl_createScreen(u, NULL, &nn_defaultScreens[tier-1]);
+			host->gpu = ncl_createGPU(u, NULL, &nn_defaultGPUs[tier-1]);
+			ncl_mountKeyboard(nn_getComponentState(host->screen), nn_getComponentAddress(host->keyboard));
+			nn_mountComponent(c, host->screen, -1, false);
+			nn_mountComponent(c, host->gpu, 2, false);
+		}
+
+		// spread the ticks and inputs over the first tick
+		host->nextTick = start + tickDelay * i / count;
+		host->nextInput = start + inputDelay * i / count;
+	}
+	size_t hostMemory = hostAlloc.used;
+
+	double end = start + seconds;
+	size_t restarts = 0, deaths = 0, signals = 0;
+	while(true) {
+		double now = load_now();
+		if(now >= end) break;
+		double wait = end - now;
+
+		if(inputDelay > 0) {
+			for(size_t i = 0; i < count; i++) {
+				load_Host *host = hosts + i;
+				if(host->dead) continue;
+				while(host->nextInput <= now) {
+					signals += load_input(&ctx, host, input);
+					host->nextInput += inputDelay;
+				}
+				if(host->nextInput - now < wait) wait = host->nextInput - now;
+			}
+		}
+
+		// idle computers whose deadline passed, or which got a signal while waiting for one
+		size_t dueCount = nn_pollIdleTimers(u, due, count);
+		for(size_t i = 0; i < dueCount; i++) {
+			load_Host *host = nn_getComputerUserdata(due[i]);
+			host->due = true;
+		}
+
+		// the wheel tells us when the others are done idling
+		size_t activeCount = nn_getActiveComputers(u, active, count);
+		for(size_t j = 0; j < activeCount; j++) {
+			nn_Computer *c = active[j];
+			load_Host *host = nn_getComputerUserdata(c);
+			size_t i = host - hosts;
+			if(host->dead) continue;
+			if(!host->due) {
+				if(nn_isComputerIdle(c)) continue;
+				if(now < host->nextTick) {
+					if(host->nextTick - now < wait) wait = host->nextTick - now;
+					continue;
+				}
+			}
+			host->due = false;
+			host->nextTick = now + tickDelay;
+
+			double tickStart = load_now();
+			nn_clearstack(c);
+			nn_Exit e = nn_tick(c);
+			if(e == NN_OK) e = nn_tickSynchronized(c);
+			double tickTime = load_now() - tickStart;
+			host->ticks++;
+
+			if(timeLen == timeCap) {
+				timeCap *= 2;
+				tickTimes = realloc(tickTimes, sizeof(double) * timeCap);
+			}
+			tickTimes[timeLen++] = tickTime;
+
+			nn_ComputerState state = nn_getComputerState(c);
+			if(state == NN_RESTART) {
+				restarts++;
+				nn_stopComputer(c);
+				if(host->screen != NULL) ncl_resetScreen(nn_getComponentState(host->screen));
+				nn_addIdleTime(c, 1);
+				// queues it in the idle timer wheel
+				nn_tick(c);
+				continue;
+			}
+			if(e != NN_OK || state == NN_POWEROFF || state == NN_CRASHED || state == NN_BLACKOUT || state == NN_CHARCH) {
+				fprintf(stderr, "computer %zu stopped: %s\n", i, state == NN_POWEROFF ? "powered off" : nn_getError(c));
+				host->dead = true;
+				deaths++;
+				continue;
+			}
+		}
+
+		double untilTimer = nn_timeUntilIdleTimer(u);
+		if(untilTimer >= 0 && untilTimer < wait) wait = untilTimer;
+		if(wait > 0) load_sleep(wait);
+	}
+	double elapsed = load_now() - start;
+
+	size_t ticks = 0, invokes = 0, vmMemory = 0;
+	for(size_t i = 0; i < count; i++) {
+		ticks += hosts[i].ticks;
+		invokes += nn_getInvokeCount(hosts[i].computer);
+		vmMemory += nn_getUsedMemory(hosts[i].computer);
+	}
+	qsort(tickTimes, timeLen, sizeof(double), load_compareTimes);
+
+	printf("{\n");
+	printf("\t\"computers\": %zu,\n", count);
+	printf("\t\"gpu\": %s,\n", withGPU ? "true" : "false");
+	printf("\t\"seconds\": %.3f,\n", elapsed);
+	printf("\t\"ticks\": %zu,\n", ticks);
+	printf("\t\"ticksPerSecond\": %.2f,\n", ticks / elapsed);
+	printf("\t\"invokes\": %zu,\n", invokes);
+	printf("\t\"invokesPerSecond\": %.2f,\n", invokes / elapsed);
+	printf("\t\"signals\": %zu,\n", signals);
+	printf("\t\"restarts\": %zu,\n", restarts);
+	printf("\t\"stopped\": %zu,\n", deaths);
+	printf("\t\"tickLatency\": {\"p50\": %.6f, \"p99\": %.6f, \"max\": %.6f},\n",
+		load_percentile(tickTimes, timeLen, 0.5), load_percentile(tickTimes, timeLen, 0.99), timeLen ? tickTimes[timeLen - 1] : 0);
+	printf("\t\"memoryPerComputer\": {\"vm\": %zu, \"host\": %zu, \"hostAtStart\": %zu, \"hostPeak\": %zu}\n",
+		vmMemory / count, hostAlloc.used / count, hostMemory / count, hostAlloc.peak / count);
+	printf("}\n");
+
+	for(size_t i = 0; i < count; i++) {
+		load_Host *host = hosts + i;
+		nn_destroyComputer(host->computer);
+		nn_dropComponent(host->eeprom);
+		nn_dropComponent(host->fs);
+		nn_dropComponent(host->tmpfs);
+		nn_dropComponent(host->keyboard);
+		nn_dropComponent(host->modem);
+		if(host->screen != NULL) nn_dropComponent(host->screen);
+		if(host->gpu != NULL) nn_dropComponent(host->gpu);
+	}
+	nn_destroyUniverse(u);
+	if(eepromPath != NULL) free(eepromCode);
+	free(tickTimes);
+	free(due);
+	free(active);
+	free(hosts);
+	return 0;
+}
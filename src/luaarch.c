@@ -21,8 +21,16 @@ typedef struct luaArch {
 	nn_Computer *computer;
 	lua_State *L;
 	size_t freeMem;
+	// entries in the address hash table
+	size_t hashCount;
 } luaArch;
 
+// how many address hashes are kept before the table is thrown out
+#define LUAARCH_MAXHASHES 256
+
+// the registry key of the address hash table
+static const char luaArch_addressHashesKey = 0;
+
 void *luaArch_alloc(void *ud, void *ptr, size_t osize, size_t nsize) {
 	luaArch *arch = ud;
 	if(nsize == 0) {
@@ -287,6 +295,12 @@ static int luaArch_computer_isIdle(lua_State *L) {
 	return 1;
 }
 
+static int luaArch_computer_waitSignal(lua_State *L) {
+	nn_Computer *c = luaArch_from(L)->computer;
+	nn_waitForSignal(c, luaL_checknumber(L, 1));
+	return 0;
+}
+
 static int luaArch_computer_pushSignal(lua_State *L) {
 	luaArch *arch = luaArch_from(L);
 	nn_Computer *c = arch->computer;
@@ -348,6 +362,42 @@ static int luaArch_computer_getDeviceInfo(lua_State *L) {
 	return 1;
 }
 
+// Addresses from the VM are interned Lua strings, which Lua looks up in tables without rehashing,
+// so their NN hash is kept in a table keyed by them, instead of being computed on every call.
+static size_t luaArch_addressHash(luaArch *arch, lua_State *L, int idx) {
+	lua_rawgetp(L, LUA_REGISTRYINDEX, &luaArch_addressHashesKey);
+	lua_pushvalue(L, idx);
+	lua_rawget(L, -2);
+	if(lua_isinteger(L, -1)) {
+		size_t hash = (size_t)lua_tointeger(L, -1);
+		lua_pop(L, 2);
+		return hash;
+	}
+	lua_pop(L, 1);
+	size_t len;
+	const char *address = lua_tolstring(L, idx, &len);
+	size_t hash = nn_lstrhash(address, len);
+	if(arch->hashCount == LUAARCH_MAXHASHES) {
+		lua_pop(L, 1);
+		lua_createtable(L, 0, LUAARCH_MAXHASHES);
+		lua_pushvalue(L, -1);
+		lua_rawsetp(L, LUA_REGISTRYINDEX, &luaArch_addressHashesKey);
+		arch->hashCount = 0;
+	}
+	lua_pushvalue(L, idx);
+	lua_pushinteger(L, (lua_Integer)hash);
+	lua_rawset(L, -3);
+	lua_pop(L, 1);
+	arch->hashCount++;
+	return hash;
+}
+
+// the component whose address is the string at idx, which must be one
+static nn_Component *luaArch_getComponent(luaArch *arch, lua_State *L, int idx) {
+	const char *address = lua_tostring(L, idx);
+	return nn_getComponentHashed(arch->computer, address, luaArch_addressHash(arch, L, idx));
+}
+
 static int luaArch_component_list(lua_State *L) {
 	luaArch *arch = luaArch_from(L);
 	lua_createtable(L, 64, 0);
@@ -361,7 +411,7 @@ static int luaArch_component_list(lua_State *L) {
 	for(size_t i = 0; i < len; i++) {
 		nn_Component *c = nn_getComponent(arch->computer, comps[i]);
 		if(c != NULL) {
-			lua_pushstring(L, nn_getComponentType(nn_getComponent(arch->computer, comps[i])));
+			lua_pushstring(L, nn_getComponentType(c));
 			lua_setfield(L, -2, comps[i]);
 		}
 	}
@@ -378,7 +428,9 @@ static int luaArch_component_invoke(lua_State *L) {
 	for(size_t i = 3; i <= argc; i++) {
 		luaArch_luaToNN(arch, L, i);
 	}
-	nn_Exit err = nn_invokeComponent(arch->computer, address, method);
+	nn_MethodHandle handle;
+	nn_Exit err = nn_resolveMethodHashed(arch->computer, address, luaArch_addressHash(arch, L, 1), method, &handle);
+	if(err == NN_OK) err = nn_invokeHandle(arch->computer, &handle);
 	if(err != NN_OK) {
 		lua_pushnil(L);
 		lua_pushstring(L, nn_getError(arch->computer));
@@ -392,11 +444,129 @@ static int luaArch_component_invoke(lua_State *L) {
 	return retc;
 }
 
-static int luaArch_component_type(lua_State *L) {
+// returns the handle and whether the method is direct
+static int luaArch_component_resolve(lua_State *L) {
 	luaArch *arch = luaArch_from(L);
 	const char *address = luaL_checkstring(L, 1);
+	const char *method = luaL_checkstring(L, 2);
+
+	nn_MethodHandle *handle = lua_newuserdata(L, sizeof(*handle));
+	nn_Exit err = nn_resolveMethodHashed(arch->computer, address, luaArch_addressHash(arch, L, 1), method, handle);
+	if(err != NN_OK) {
+		lua_pushnil(L);
+		lua_pushstring(L, nn_getError(arch->computer));
+		return 2;
+	}
+	lua_pushboolean(L, (nn_getMethodHandleFlags(handle) & NN_DIRECT) != 0);
+	return 2;
+}
+
+static int luaArch_component_isHandleValid(lua_State *L) {
+	luaArch *arch = luaArch_from(L);
+	luaL_checktype(L, 1, LUA_TUSERDATA);
+	nn_MethodHandle *handle = lua_touserdata(L, 1);
+	lua_pushboolean(L, nn_isMethodHandleValid(arch->computer, handle));
+	return 1;
+}
 
-	nn_Component *c = nn_getComponent(arch->computer, address);
+static int luaArch_component_invokeHandle(lua_State *L) {
+	luaArch *arch = luaArch_from(L);
+	luaL_checktype(L, 1, LUA_TUSERDATA);
+	nn_MethodHandle *handle = lua_touserdata(L, 1);
+	size_t argc = lua_gettop(L);
+
+	nn_clearstack(arch->computer);
+	for(size_t i = 2; i <= argc; i++) {
+		luaArch_luaToNN(arch, L, i);
+	}
+	nn_Exit err = nn_invokeHandle(arch->computer, handle);
+	if(err != NN_OK) {
+		lua_pushnil(L);
+		lua_pushstring(L, nn_getError(arch->computer));
+		return 2;
+	}
+	size_t retc = nn_getstacksize(arch->computer);
+	for(size_t i = 0; i < retc; i++) {
+		luaArch_nnToLua(arch, L, i);
+	}
+	nn_clearstack(arch->computer);
+	return retc;
+}
+
+// takes a list of {handle, args...}, with an optional n like table.pack(), and returns a list of
+// results packed the same way. If it stops early, the list is shorter,
+// and if a call errors, the error is returned after it.
+static int luaArch_component_batch(lua_State *L) {
+	luaArch *arch = luaArch_from(L);
+	nn_Computer *C = arch->computer;
+	luaL_checktype(L, 1, LUA_TTABLE);
+	size_t count = lua_rawlen(L, 1);
+	if(count > NN_MAX_BATCH) {
+		return luaL_error(L, "too many calls in batch (max %d)", NN_MAX_BATCH);
+	}
+
+	nn_BatchCall calls[NN_MAX_BATCH];
+	nn_clearstack(C);
+	for(size_t i = 0; i < count; i++) {
+		lua_rawgeti(L, 1, i + 1);
+		if(lua_type(L, -1) != LUA_TTABLE) {
+			nn_clearstack(C);
+			return luaL_error(L, "bad call #%d (table expected)", (int)(i + 1));
+		}
+		lua_rawgeti(L, -1, 1);
+		if(lua_type(L, -1) != LUA_TUSERDATA) {
+			nn_clearstack(C);
+			return luaL_error(L, "bad call #%d (handle expected)", (int)(i + 1));
+		}
+		calls[i].handle = lua_touserdata(L, -1);
+		lua_pop(L, 1);
+		lua_getfield(L, -1, "n");
+		size_t argc = lua_isnumber(L, -1) ? lua_tointeger(L, -1) : lua_rawlen(L, -2);
+		lua_pop(L, 1);
+		// the handle is not an argument
+		argc = argc > 0 ? argc - 1 : 0;
+		calls[i].argc = argc;
+		for(size_t j = 0; j < argc; j++) {
+			lua_rawgeti(L, -1, j + 2);
+			nn_Exit e = luaArch_luaToNN(arch, L, lua_gettop(L));
+			lua_pop(L, 1);
+			if(e != NN_OK) {
+				nn_clearstack(C);
+				lua_pushnil(L);
+				lua_pushstring(L, "too many arguments in batch");
+				return 2;
+			}
+		}
+		lua_pop(L, 1);
+	}
+
+	size_t done;
+	nn_Exit err = nn_invokeBatch(C, calls, count, &done);
+	lua_createtable(L, done, 0);
+	size_t off = 0;
+	for(size_t i = 0; i < done; i++) {
+		lua_createtable(L, calls[i].retc, 1);
+		for(size_t j = 0; j < calls[i].retc; j++) {
+			luaArch_nnToLua(arch, L, off + j);
+			lua_rawseti(L, -2, j + 1);
+		}
+		lua_pushinteger(L, calls[i].retc);
+		lua_setfield(L, -2, "n");
+		lua_rawseti(L, -2, i + 1);
+		off += calls[i].retc;
+	}
+	nn_clearstack(C);
+	if(err != NN_OK) {
+		lua_pushstring(L, nn_getError(C));
+		return 2;
+	}
+	return 1;
+}
+static int luaArch_component_type(lua_State *L) {
+	luaArch *arch = luaArch_from(L);
+	luaL_checkstring(L, 1);
+
+	nn_Component *c = luaArch_getComponent(arch, L, 1);
 	if(c == NULL) {
 		lua_pushnil(L);
 		lua_pushstring(L, "no such component");
@@ -408,10 +578,10 @@ static int luaArch_component_type(lua_State *L) {
 
 static int luaArch_component_doc(lua_State *L) {
 	luaArch *arch = luaArch_from(L);
-	const char *address = luaL_checkstring(L, 1);
+	luaL_checkstring(L, 1);
 	const char *method = luaL_checkstring(L, 2);
 
-	nn_Component *c = nn_getComponent(arch->computer, address);
+	nn_Component *c = luaArch_getComponent(arch, L, 1);
 	if(c == NULL) {
 		lua_pushnil(L);
 		lua_pushstring(L, "no such component");
@@ -429,10 +599,10 @@ static int luaArch_component_doc(lua_State *L) {
 
 static int luaArch_component_getMethodFlags(lua_State *L) {
 	luaArch *arch = luaArch_from(L);
-	const char *address = luaL_checkstring(L, 1);
+	luaL_checkstring(L, 1);
 	const char *method = luaL_checkstring(L, 2);
 
-	nn_Component *c = nn_getComponent(arch->computer, address);
+	nn_Component *c = luaArch_getComponent(arch, L, 1);
 	if(c == NULL) {
 		lua_pushnil(L);
 		lua_pushstring(L, "no such component");
@@ -453,7 +623,7 @@ static int luaArch_component_slot(lua_State *L) {
 	luaArch *arch = luaArch_from(L);
 	const char *address = luaL_checkstring(L, 1);
 
-	if(nn_getComponent(arch->computer, address) == NULL) {
+	if(luaArch_getComponent(arch, L, 1) == NULL) {
 		lua_pushnil(L);
 		lua_pushstring(L, "no such component");
 		return 2;
@@ -464,9 +634,9 @@ static int luaArch_component_slot(lua_State *L) {
 
 static int luaArch_component_methods(lua_State *L) {
 	luaArch *arch = luaArch_from(L);
-	const char *address = luaL_checkstring(L, 1);
+	luaL_checkstring(L, 1);
 
-	nn_Component *c = nn_getComponent(arch->computer, address);
+	nn_Component *c = luaArch_getComponent(arch, L, 1);
 
 	if(c == NULL) {
 		lua_pushnil(L);
@@ -493,9 +663,9 @@ static int luaArch_component_methods(lua_State *L) {
 
 static int luaArch_component_fields(lua_State *L) {
 	luaArch *arch = luaArch_from(L);
-	const char *address = luaL_checkstring(L, 1);
+	luaL_checkstring(L, 1);
 
-	nn_Component *c = nn_getComponent(arch->computer, address);
+	nn_Component *c = luaArch_getComponent(arch, L, 1);
 
 	if(c == NULL) {
 		lua_pushnil(L);
@@ -736,6 +906,8 @@ static void luaArch_loadEnv(lua_State *L) {
 	lua_setfield(L, computer, "isOverused");
 	lua_pushcfunction(L, luaArch_computer_isIdle);
 	lua_setfield(L, computer, "isIdle");
+	lua_pushcfunction(L, luaArch_computer_waitSignal);
+	lua_setfield(L, computer, "waitSignal");
 	lua_pushcfunction(L, luaArch_computer_pushSignal);
 	lua_setfield(L, computer, "pushSignal");
 	lua_pushcfunction(L, luaArch_computer_popSignal);
@@ -750,6 +922,16 @@ static void luaArch_loadEnv(lua_State *L) {
 	lua_setfield(L, component, "list");
 	lua_pushcfunction(L, luaArch_component_invoke);
 	lua_setfield(L, component, "invoke");
+	lua_pushcfunction(L, luaArch_component_resolve);
+	lua_setfield(L, component, "resolve");
+	lua_pushcfunction(L, luaArch_component_isHandleValid);
+	lua_setfield(L, component, "isHandleValid");
+	lua_pushcfunction(L, luaArch_component_invokeHandle);
+	lua_setfield(L, component, "invokeHandle");
+	lua_pushcfunction(L, luaArch_component_batch);
+	lua_setfield(L, component, "batch");
+	lua_pushinteger(L, NN_MAX_BATCH);
+	lua_setfield(L, component, "maxBatch");
 	lua_pushcfunction(L, luaArch_component_doc);
 	lua_setfield(L, component, "doc");
 	lua_pushcfunction(L, luaArch_component_type);
@@ -816,6 +998,9 @@ static nn_Exit luaArch_handler(nn_ArchitectureRequest *req) {
 			luaL_openlibs(L);
 			lua_pushlightuserdata(L, arch);
 			lua_setfield(L, LUA_REGISTRYINDEX, "archPtr");
+			lua_createtable(L, 0, LUAARCH_MAXHASHES);
+			lua_rawsetp(L, LUA_REGISTRYINDEX, &luaArch_addressHashesKey);
+			arch->hashCount = 0;
 
 			luaArch_loadEnv(L);
 
@@ -851,6 +1036,13 @@ static nn_Exit luaArch_handler(nn_ArchitectureRequest *req) {
 			nn_setComputerState(computer, NN_CRASHED);
 			return NN_OK;
 		}
+		// why it yielded, for traces
+		if(nn_isTracing(computer)) {
+			const char *reason = "yield";
+			if(nn_isComputerIdle(computer)) reason = "yield: idle";
+			else if(nn_componentsOverused(computer)) reason = "yield: overused";
+			nn_traceInstant(computer, reason);
+		}
 		return NN_OK;
 	case NN_ARCH_SERIALIZE:
 		return nn_pushstring(computer, "lua stuff");
@@ -40,6 +40,11 @@ function coroutine.wrap(f)
 end
 
 local clist, cinvoke, computer, component, print, unicode = component.list, component.invoke, computer, component, print, unicode
+local cresolve, cinvokeHandle, chandleValid = component.resolve, component.invokeHandle, component.isHandleValid
+local cbatch, cmaxBatch = component.batch, component.maxBatch
+-- read once, as invoking is hot
+local fastInvoke = os.getenv("NN_FAST")
+local invokeDebugType, methodDebug = os.getenv("NN_INVDBG"), os.getenv("NN_METDBG")
 debug.print = print
 debug.sysyield = sysyield
 
@@ -126,17 +131,23 @@ local function sandboxValue(val)
 	return val
 end
 
-local function realInvoke(address, method, ...)
+-- handle is optional, it skips looking up the address and method again
+local function realInvoke(address, method, handle, ...)
 	local args = {...}
 	for i=1,#args do args[i] = unsandboxValue(args[i]) end
-	local t = {pcall(cinvoke, address, method, table.unpack(args))}
-	if not _SYNCED and not os.getenv("NN_FAST") then
+	local t
+	if handle then
+		t = {pcall(cinvokeHandle, handle, table.unpack(args))}
+	else
+		t = {pcall(cinvoke, address, method, table.unpack(args))}
+	end
+	if not _SYNCED and not fastInvoke then
 		if computer.energy() <= 0 then sysyield() end -- out of power
 		if computer.isOverused() then sysyield() end -- overused
 		if computer.isIdle() then sysyield() end -- machine idle
 	end
 
-	if component.type(address) == os.getenv("NN_INVDBG") or string.find(os.getenv("NN_METDBG") or "", method, nil, true) then
+	if (invokeDebugType and component.type(address) == invokeDebugType) or (methodDebug and string.find(methodDebug, method, nil, true)) then
 		print("invoked", address, method, ...)
 		print(string.format("got %d values", #t), table.unpack(t))
 	end
@@ -149,14 +160,12 @@ local function realInvoke(address, method, ...)
 	return nil, t[2]
 end
 
-function component.invoke(address, method, ...)
-	if type(address) ~= "string" then return nil, "bad argument #1 (string expected)" end
-	if type(method) ~= "string" then return nil, "bad argument #2 (string expected)" end
-	if component.getMethodFlags(address, method).direct or os.getenv("NN_FAST") then
-		return realInvoke(address, method, ...)
+local function doInvoke(address, method, handle, direct, ...)
+	if direct or fastInvoke then
+		return realInvoke(address, method, handle, ...)
 	else
 		-- must sync
-		syncedMethodStats = {address, method, ...}
+		syncedMethodStats = table.pack(realInvoke, address, method, handle, ...)
 		sysyield()
 		local rets = syncedMethodStats
 		syncedMethodStats = nil
@@ -164,9 +173,106 @@ function component.invoke(address, method, ...)
 	end
 end
 
+function component.invoke(address, method, ...)
+	if type(address) ~= "string" then return nil, "bad argument #1 (string expected)" end
+	if type(method) ~= "string" then return nil, "bad argument #2 (string expected)" end
+	return doInvoke(address, method, nil, component.getMethodFlags(address, method).direct, ...)
+end
+
+-- raw is a list of {handle, args..., n = argc + 1}
+local function realBatch(raw)
+	local ok, results, err = pcall(cbatch, raw)
+	if not ok then return nil, results end
+	if not _SYNCED and not fastInvoke then
+		if computer.energy() <= 0 then sysyield() end -- out of power
+		if computer.isOverused() then sysyield() end -- overused
+		if computer.isIdle() then sysyield() end -- machine idle
+	end
+	if not results then return nil, err end
+	for i=1,#results do
+		local r = results[i]
+		for j=1,r.n do r[j] = sandboxValue(r[j]) end
+	end
+	return results, err
+end
+
+local function doBatch(raw, direct)
+	if direct or fastInvoke then
+		return realBatch(raw)
+	end
+	-- one sync for the whole batch
+	syncedMethodStats = table.pack(realBatch, raw)
+	sysyield()
+	local rets = syncedMethodStats
+	syncedMethodStats = nil
+	return table.unpack(rets)
+end
+
+-- handles for component.batch, by address and method.
+-- They all go stale at once, so they are all thrown out at once.
+local batchHandles = {}
+
+-- calls is a list of {address, method, args...}, with an optional n like table.pack().
+-- Returns a list of packed results, with the error of the call which failed, if any.
+-- Lists longer than component.maxBatch are run as several batches.
+function component.batch(calls)
+	checkArg(1, calls, "table")
+	local raw, direct = {}, true
+	for i=1,#calls do
+		local call = calls[i]
+		if type(call) ~= "table" or type(call[1]) ~= "string" or type(call[2]) ~= "string" then
+			return nil, "bad call #" .. i .. " (address and method expected)"
+		end
+		local key = call[1] .. "\0" .. call[2]
+		local cached = batchHandles[key]
+		if cached and not chandleValid(cached.handle) then
+			batchHandles = {}
+			cached = nil
+		end
+		if not cached then
+			local handle, d = cresolve(call[1], call[2])
+			if not handle then return nil, d end
+			cached = {handle = handle, direct = d}
+			batchHandles[key] = cached
+		end
+		direct = direct and cached.direct
+		local n = call.n or #call
+		local entry = {cached.handle, n = n - 1}
+		for j=3,n do entry[j-1] = unsandboxValue(call[j]) end
+		raw[i] = entry
+	end
+
+	-- a batch stops early once the components are overused, so the rest runs after
+	local results, start = {}, 1
+	while start <= #raw do
+		local chunk = raw
+		local last = math.min(#raw, start + cmaxBatch - 1)
+		if start > 1 or last < #raw then chunk = table.move(raw, start, last, 1, {}) end
+		local res, err = doBatch(chunk, direct)
+		if not res then return nil, err end
+		table.move(res, 1, #res, #results + 1, results)
+		if err then return results, err end
+		start = start + #res
+	end
+	return results
+end
+
+-- handles of proxy callbacks, kept out of the callbacks themselves,
+-- as sandboxed code can write to those
+local callbackHandles = setmetatable({}, {__mode = "k"})
+
 local componentCallback = {
 	__call = function(self, ...)
-		return component.invoke(self.address, self.name, ...)
+		local address, name = self.address, self.name
+		local cached = callbackHandles[self]
+		-- handles go stale when any component is removed
+		if not cached or cached.address ~= address or cached.name ~= name or not chandleValid(cached.handle) then
+			local handle, direct = cresolve(address, name)
+			if not handle then return nil, direct end
+			cached = {handle = handle, direct = direct, address = address, name = name}
+			callbackHandles[self] = cached
+		end
+		return doInvoke(address, name, cached.handle, cached.direct, ...)
 	end,
 	__tostring = function(self)
 		return component.doc(self.address, self.name) or "function"
@@ -254,6 +360,8 @@ function computer.pullSignal(timeout)
 		local t = {computer.popSignal()}
 		for i=1,#t do t[i] = unsandboxValue(t[i]) end
 		if #t == 0 then
+			-- idle until a signal comes in, so the host does not need to tick us
+			computer.waitSignal(deadline - computer.uptime())
 			sysyield()
 		else
 			return table.unpack(t)
@@ -464,6 +572,8 @@ sandbox = {
 	checkArg = checkArg,
 
 	component = {
+		batch = component.batch,
+		maxBatch = component.maxBatch,
 		doc = component.doc,
 		fields = component.fields,
 		invoke = component.invoke,
@@ -568,7 +678,7 @@ while true do
 	if _SYNCED then
 		if syncedMethodStats then
 			--debug.print("calling synced method")
-			syncedMethodStats = {realInvoke(table.unpack(syncedMethodStats))}
+			syncedMethodStats = {syncedMethodStats[1](table.unpack(syncedMethodStats, 2, syncedMethodStats.n))}
 		end
 	else
 		local ok, err = resume(thread)
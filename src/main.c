@@ -536,6 +536,12 @@ double accumulatedEnergyCost = 0;
 double totalEnergyLoss = 0;
 // default capacity of a tablet
 double allEnergy = 10000;
+// a signal came in while the computer was waiting, so it is ticked right away
+bool wokenUp = false;
+
+static void ne_traceWriter(void *userdata, const char *data, size_t len) {
+	fwrite(data, 1, len, userdata);
+}
 
 void ne_env(nn_EnvironmentRequest *req) {
 	if(req->action == NN_ENV_BEEP) {
@@ -546,6 +552,10 @@ void ne_env(nn_EnvironmentRequest *req) {
 		printf("morse beep: %s, %f Hz %fs %.02f%%\n", req->morseBeep.pattern, req->morseBeep.frequency, req->morseBeep.beepDuration, req->morseBeep.volume*100);
 		return;
 	}
+	if(req->action == NN_ENV_WAKEUP) {
+		wokenUp = true;
+		return;
+	}
 	if(req->action == NN_ENV_DRAWENERGY) {
 		accumulatedEnergyCost += req->energy;
 		totalEnergyLoss += req->energy;
@@ -684,6 +694,14 @@ int main(int argc, char **argv) {
 		"component.invoke(g, 'set', 1, 2, 'took ' .. (now - start) .. 's')\n"
 		"component.invoke(g, 'set', 1, 3, 'random read speed: ' .. (tc * ss / (now - start)) .. 'B/s')\n"
 		"while computer.uptime() < now + 3 do computer.pullSignal(0.05) end\n"
+		"component.invoke(g, 'bind', s, true)\n"
+		"component.invoke(g, 'set', 1, 1, 'starting vectored bench...')\n"
+		"start = computer.uptime()\n"
+		"local i = 1 while i <= tc do i = i + #component.invoke(d, 'readSectors', i, math.min(32, tc - i + 1)) // ss end\n"
+		"now = computer.uptime()\n"
+		"component.invoke(g, 'set', 1, 2, 'took ' .. (now - start) .. 's')\n"
+		"component.invoke(g, 'set', 1, 3, 'vectored read speed: ' .. (tc * ss / (now - start)) .. 'B/s')\n"
+		"while computer.uptime() < now + 3 do computer.pullSignal(0.05) end\n"
 		"computer.shutdown(true)\n"
 	;
 	nn_Component *testDrive = ncl_createDrive(u, NULL, &nn_defaultDrives[tier-1], testDriveData, strlen(testDriveData), false);
@@ -718,6 +736,9 @@ int main(int argc, char **argv) {
 	double nextTick = 0;
 	double nextSecond = 0;
 	double wattage = 0;
+	// the call which took the most time last second, if profiling
+	nn_ProfileEntry topCall;
+	bool hasTopCall = false;
 
 	nn_Component *screen = ncl_createScreen(u, NULL, &nn_defaultScreens[tier-1]);
 	nn_GPU gpuConf = nn_defaultGPUs[tier-1];
@@ -738,6 +759,11 @@ int main(int argc, char **argv) {
 	// 5 cuz CPU + each RAM stick all have same tier call budgets
 	nn_setCallBudget(c, nn_defaultCallBudgets[tier-1] * 5);
 	nn_setTotalEnergy(c, allEnergy);
+	// does nothing unless NN_PROFILE was defined
+	if(showStats) nn_setProfiling(c, true);
+	// the last events are written to this file on exit
+	const char *tracePath = getenv("NN_TRACE");
+	if(tracePath != NULL) nn_setTracing(c, 65536);
 	if(getenv("NN_FAST") != NULL) {
 		tickDelay = 0;
 		noIdle = true;
@@ -885,6 +911,10 @@ int main(int argc, char **argv) {
 			statY += 20;
 			DrawText(TextFormat("Tick time: %.5fs", tickTime), 10, statY, 20, (tickTime < tickDelay || tickDelay == 0) ? GREEN : RED);
 			statY += 20;
+			if(hasTopCall) {
+				DrawText(TextFormat("Top call: %s.%s %zux %.5fs (p99 %.5fs)", topCall.type, topCall.method, topCall.calls, topCall.time, nn_getProfilePercentile(&topCall, 0.99)), 10, statY, 20, GREEN);
+				statY += 20;
+			}
 		}
 
 		EndDrawing();
@@ -941,11 +971,22 @@ int main(int argc, char **argv) {
 
 		if(tickNow >= nextSecond) {
 			nextSecond = tickNow + 1;
+			const nn_Profile *profile = nn_getProfile(c);
+			if(profile != NULL) {
+				hasTopCall = false;
+				for(size_t i = 0; i < profile->len; i++) {
+					if(hasTopCall && profile->entries[i].time <= topCall.time) continue;
+					topCall = profile->entries[i];
+					hasTopCall = true;
+				}
+				nn_resetProfile(c);
+			}
 			wattage = accumulatedEnergyCost;
 			accumulatedEnergyCost = 0;
 		}
 
-		if(tickNow >= nextTick) {
+		if(tickNow >= nextTick || wokenUp) {
+			wokenUp = false;
 			nextTick = tickNow + tickDelay;
 			nn_clearstack(c);
 
@@ -1000,6 +1041,14 @@ int main(int argc, char **argv) {
 	}
 
 cleanup:;
+	if(tracePath != NULL) {
+		FILE *traceFile = fopen(tracePath, "w");
+		if(traceFile != NULL) {
+			nn_Computer *traced = c;
+			nn_exportTrace(&traced, 1, ne_traceWriter, traceFile);
+			fclose(traceFile);
+		}
+	}
 	nn_destroyComputer(c);
 	nn_dropComponent(ocelotCard);
 	nn_dropComponent(eepromCard);
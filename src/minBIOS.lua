@@ -57,7 +57,19 @@ local function getBootCode(addr)
 	local sectorsIn32K = math.ceil(32768 / sectorSize)
 	local bootCode = {firstSector}
 	-- since its null terminated, this is an optimization
-	if not firstSector:find("\0") then
+	if not firstSector:find("\0") and drive.readSectors then
+		-- few calls instead of one per sector, as it may stop short
+		local sector = 2
+		local count = math.min(sectorsIn32K, drive.getCapacity() // sectorSize) - 1
+		while count > 0 do
+			local data = drive.readSectors(sector, count)
+			table.insert(bootCode, data)
+			if data:find("\0") then break end
+			local n = #data // sectorSize
+			sector = sector + n
+			count = count - n
+		end
+	elseif not firstSector:find("\0") then
 		for i=2,sectorsIn32K do
 			local sec = drive.readSector(i)
 			table.insert(bootCode, sec)
@@ -2,6 +2,7 @@
 #include "ncomplib.h"
 #include <stdlib.h>
 #include <string.h>
+#include <limits.h>
 
 static bool ncl_defaultHandler(ncl_VFSRequest *request);
 
@@ -16,6 +17,11 @@ bool ncl_defaultHandler(ncl_VFSRequest *request) {
 
 #include <dirent.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <time.h>
 
 // Read me all my rights
 #elif defined(NN_WINDOWS)
@@ -530,6 +536,8 @@ struct ncl_ScreenState {
 	int *palette;
 	int *resolvedPalette;
 	ncl_ScreenPixel *pixels;
+	// one bit per row, set when the row changed since the last encode
+	unsigned char *dirtyRows;
 	ncl_ScreenFlags flags;
 	size_t keyboardCount;
 	double brightness;
@@ -539,6 +547,8 @@ struct ncl_ScreenState {
 typedef struct nn_VRAMBuf {
 	int width;
 	int height;
+	// changed since the last encode
+	bool dirty;
 	ncl_ScreenPixel pixels[];
 } ncl_VRAMBuf;
 
@@ -549,6 +559,7 @@ typedef struct ncl_GPUState {
 	size_t vramFree;
 	ncl_VRAMBuf *vram[NCL_MAX_VRAMBUF];
 	char *screenAddress;
+	size_t screenHash;
 	int currentFg;
 	int currentBg;
 	int activeBuffer;
@@ -565,6 +576,7 @@ static ncl_VRAMBuf *ncl_allocVRAM(nn_Context *ctx, int width, int height) {
 	if(buf == NULL) return NULL;
 	buf->width = width;
 	buf->height = height;
+	buf->dirty = true;
 	for(int i = 0; i < width*height; i++) {
 		buf->pixels[i] = (ncl_ScreenPixel) {
 			.codepoint = ' ',
@@ -598,7 +610,9 @@ static ncl_ScreenPixel ncl_vramGet(ncl_VRAMBuf *buf, int x, int y) {
 
 static void ncl_vramSet(ncl_VRAMBuf *buf, int x, int y, ncl_ScreenPixel pixel) {
 	ncl_ScreenPixel *ptr = ncl_vramPtr(buf, x, y);
-	if(ptr != NULL) *ptr = pixel;
+	if(ptr == NULL) return;
+	*ptr = pixel;
+	buf->dirty = true;
 }
 
 typedef struct ncl_FSState {
@@ -620,16 +634,509 @@ typedef struct ncl_FSState {
 	size_t labellen;
 } ncl_FSState;
 
+static size_t ncl_dirtySize(size_t count) {
+	return (count + 7) / 8;
+}
+
+static void ncl_setDirty(unsigned char *dirty, size_t i) {
+	dirty[i / 8] |= 1 << (i % 8);
+}
+
+static bool ncl_isDirty(const unsigned char *dirty, size_t i) {
+	return (dirty[i / 8] >> (i % 8)) & 1;
+}
+
+static size_t ncl_sectorCount(size_t capacity, size_t sectorSize) {
+	if(sectorSize == 0) return 0;
+	return (capacity + sectorSize - 1) / sectorSize;
+}
+
+struct ncl_DiskImage {
+	nn_Context *ctx;
+	nn_Lock *lock;
+	size_t refs;
+	size_t len;
+	char data[];
+};
+
+static bool ncl_isZero(const char *data, size_t len) {
+	for(size_t i = 0; i < len; i++) {
+		if(data[i] != 0) return false;
+	}
+	return true;
+}
+
+// The shared zero page.
+// Sectors pointing to it read as zeros without owning any memory,
+// for when they are zeroed over an image which is not.
+static char ncl_zeroPage;
+
+// The storage of drives and nandflash.
+// It is sparse: sectors are read from the shared image, or are zeros past it,
+// until they are first written to, which makes a private copy of them.
+// Sectors written back to all zeros give their copy back.
+// File-backed disks instead map the file, and all their sectors point into it.
+// Read-only files are mapped as the base instead, like an image, so they are never written to.
+typedef struct ncl_Disk {
+	nn_Context *ctx;
+	size_t capacity;
+	size_t sectorSize;
+	size_t sectorCount;
+	// can be NULL, in which case unwritten sectors are zeros
+	ncl_DiskImage *image;
+	// what unwritten sectors read from, the image or a read-only mapped file
+	const char *base;
+	size_t baseLen;
+	// the read-only mapped file, or NULL
+	char *baseMap;
+	// the private copies, NULL if not written to yet, or &ncl_zeroPage
+	char **sectors;
+	// how many private copies there are
+	size_t resident;
+	// one bit per sector, set when it changed since the last encode
+	unsigned char *dirty;
+	// the mapped file, or NULL if it is in RAM
+	char *map;
+	int fd;
+	// one bit per sector, set when it changed since the last flush
+	unsigned char *unsynced;
+	// the lock of the component, taken by the flusher
+	nn_Lock *lock;
+	ncl_DiskFlusher *flusher;
+	struct ncl_Disk *prevFlushed;
+	struct ncl_Disk *nextFlushed;
+} ncl_Disk;
+
+static bool ncl_diskIsPrivate(const ncl_Disk *disk, size_t i) {
+	return disk->sectors[i] != NULL && disk->sectors[i] != &ncl_zeroPage;
+}
+
+static nn_Exit ncl_initDisk(nn_Context *ctx, ncl_Disk *disk, size_t capacity, size_t sectorSize, ncl_DiskImage *image) {
+	disk->ctx = ctx;
+	disk->map = NULL;
+	disk->baseMap = NULL;
+	disk->fd = -1;
+	disk->unsynced = NULL;
+	disk->lock = NULL;
+	disk->flusher = NULL;
+	disk->capacity = capacity;
+	disk->sectorSize = sectorSize;
+	disk->sectorCount = ncl_sectorCount(capacity, sectorSize);
+	disk->resident = 0;
+	disk->sectors = nn_alloc(ctx, sizeof(char *) * disk->sectorCount);
+	if(disk->sectors == NULL) return NN_ENOMEM;
+	disk->dirty = nn_alloc(ctx, ncl_dirtySize(disk->sectorCount));
+	if(disk->dirty == NULL) {
+		nn_free(ctx, disk->sectors, sizeof(char *) * disk->sectorCount);
+		return NN_ENOMEM;
+	}
+	for(size_t i = 0; i < disk->sectorCount; i++) disk->sectors[i] = NULL;
+	memset(disk->dirty, 0, ncl_dirtySize(disk->sectorCount));
+	disk->image = image;
+	disk->base = image != NULL ? image->data : NULL;
+	disk->baseLen = image != NULL ? image->len : 0;
+	if(image != NULL) ncl_retainDiskImage(image);
+	return NN_OK;
+}
+
+static void ncl_unmapDisk(ncl_Disk *disk);
+
+static void ncl_deinitDisk(nn_Context *ctx, ncl_Disk *disk) {
+	if(disk->map != NULL || disk->baseMap != NULL) ncl_unmapDisk(disk);
+	if(disk->map != NULL) nn_free(ctx, disk->unsynced, ncl_dirtySize(disk->sectorCount));
+	for(size_t i = 0; disk->map == NULL && i < disk->sectorCount; i++) {
+		if(ncl_diskIsPrivate(disk, i)) nn_free(ctx, disk->sectors[i], disk->sectorSize);
+	}
+	nn_free(ctx, disk->sectors, sizeof(char *) * disk->sectorCount);
+	nn_free(ctx, disk->dirty, ncl_dirtySize(disk->sectorCount));
+	if(disk->image != NULL) ncl_releaseDiskImage(disk->image);
+}
+
+// how many bytes of the image sit at [off, off+len)
+static size_t ncl_diskImageBytes(const ncl_Disk *disk, size_t off, size_t len) {
+	if(off >= disk->baseLen) return 0;
+	size_t left = disk->baseLen - off;
+	return left < len ? left : len;
+}
+
+// the bytes of sector i which are within the capacity
+static size_t ncl_diskSectorBytes(const ncl_Disk *disk, size_t i) {
+	size_t off = i * disk->sectorSize;
+	size_t left = disk->capacity - off;
+	return left < disk->sectorSize ? left : disk->sectorSize;
+}
+
+// whether sector i is all zeros when it has no private copy
+static bool ncl_diskBaseIsZero(const ncl_Disk *disk, size_t i) {
+	size_t off = i * disk->sectorSize;
+	size_t fromImage = ncl_diskImageBytes(disk, off, ncl_diskSectorBytes(disk, i));
+	return fromImage == 0 || ncl_isZero(disk->base + off, fromImage);
+}
+
+static bool ncl_diskIsZero(const ncl_Disk *disk, size_t i) {
+	if(disk->sectors[i] == &ncl_zeroPage) return true;
+	if(disk->sectors[i] != NULL) return ncl_isZero(disk->sectors[i], ncl_diskSectorBytes(disk, i));
+	return ncl_diskBaseIsZero(disk, i);
+}
+
+// reads [off, off+len), which must be within the capacity
+static void ncl_diskRead(const ncl_Disk *disk, size_t off, char *buf, size_t len) {
+	size_t ss = disk->sectorSize;
+	while(len > 0) {
+		size_t i = off / ss;
+		size_t inner = off % ss;
+		size_t n = ss - inner < len ? ss - inner : len;
+		if(disk->sectors[i] == &ncl_zeroPage) {
+			memset(buf, 0, n);
+		} else if(disk->sectors[i] != NULL) {
+			memcpy(buf, disk->sectors[i] + inner, n);
+		} else {
+			size_t fromImage = ncl_diskImageBytes(disk, off, n);
+			if(fromImage > 0) memcpy(buf, disk->base + off, fromImage);
+			memset(buf + fromImage, 0, n - fromImage);
+		}
+		off += n;
+		buf += n;
+		len -= n;
+	}
+}
+
+// the private copy of sector i, which is made if needed.
+// NULL if out of memory.
+static char *ncl_diskSector(nn_Context *ctx, ncl_Disk *disk, size_t i) {
+	if(!ncl_diskIsPrivate(disk, i)) {
+		char *sector = nn_alloc(ctx, disk->sectorSize);
+		if(sector == NULL) return NULL;
+		memset(sector, 0, disk->sectorSize);
+		ncl_diskRead(disk, i * disk->sectorSize, sector, ncl_diskSectorBytes(disk, i));
+		disk->sectors[i] = sector;
+		disk->resident++;
+	}
+	ncl_setDirty(disk->dirty, i);
+	if(disk->unsynced != NULL) ncl_setDirty(disk->unsynced, i);
+	return disk->sectors[i];
+}
+
+// makes sector i all zeros without a private copy
+static void ncl_diskZeroSector(nn_Context *ctx, ncl_Disk *disk, size_t i) {
+	if(disk->map != NULL) {
+		memset(ncl_diskSector(ctx, disk, i), 0, ncl_diskSectorBytes(disk, i));
+		return;
+	}
+	if(ncl_diskIsPrivate(disk, i)) {
+		nn_free(ctx, disk->sectors[i], disk->sectorSize);
+		disk->resident--;
+	}
+	disk->sectors[i] = ncl_diskBaseIsZero(disk, i) ? NULL : &ncl_zeroPage;
+}
+
+// writes [off, off+len), which must be within the capacity
+static nn_Exit ncl_diskWrite(nn_Context *ctx, ncl_Disk *disk, size_t off, const char *buf, size_t len) {
+	size_t ss = disk->sectorSize;
+	while(len > 0) {
+		size_t i = off / ss;
+		size_t inner = off % ss;
+		size_t n = ss - inner < len ? ss - inner : len;
+		bool zeros = ncl_isZero(buf, n);
+		// zeros over zeros change nothing, and should not allocate
+		if(!zeros || !ncl_diskIsZero(disk, i)) {
+			char *sector = ncl_diskSector(ctx, disk, i);
+			if(sector == NULL) return NN_ENOMEM;
+			memcpy(sector + inner, buf, n);
+			if(zeros && ncl_isZero(sector, ncl_diskSectorBytes(disk, i))) ncl_diskZeroSector(ctx, disk, i);
+		}
+		off += n;
+		buf += n;
+		len -= n;
+	}
+	return NN_OK;
+}
+
+#if defined(NN_POSIX) && !defined(NN_BAREMETAL)
+
+struct ncl_DiskFlusher {
+	nn_Context *ctx;
+	double interval;
+	pthread_mutex_t mutex;
+	pthread_cond_t wake;
+	pthread_t thread;
+	bool stop;
+	ncl_Disk *disks;
+};
+
+// Maps a read-only file as the base of the disk, which is then like one made from an image.
+// The file is neither created nor grown, and what is past its end reads as zeros.
+static nn_Exit ncl_mapDiskBase(nn_Context *ctx, ncl_Disk *disk, size_t capacity, size_t sectorSize, const char *path) {
+	if(ncl_initDisk(ctx, disk, capacity, sectorSize, NULL)) return NN_ENOMEM;
+	int fd = open(path, O_RDONLY);
+	if(fd < 0) goto fail;
+	struct stat s;
+	if(fstat(fd, &s) != 0) goto fail;
+	size_t len = (size_t)s.st_size < capacity ? (size_t)s.st_size : capacity;
+	if(len > 0) {
+		void *map = mmap(NULL, len, PROT_READ, MAP_SHARED, fd, 0);
+		if(map == MAP_FAILED) goto fail;
+		disk->baseMap = map;
+		disk->base = map;
+		disk->baseLen = len;
+	}
+	// the mapping does not need it
+	close(fd);
+	return NN_OK;
+fail:
+	if(fd >= 0) close(fd);
+	ncl_deinitDisk(ctx, disk);
+	return NN_EBADCALL;
+}
+
+// Maps the file at path as the disk, growing it to the capacity if needed.
+// The file is not read, so this is quick even for big images.
+// Read-only disks are mapped with ncl_mapDiskBase() instead.
+static nn_Exit ncl_mapDisk(nn_Context *ctx, ncl_Disk *disk, size_t capacity, size_t sectorSize, const char *path, nn_Lock *lock, bool isReadonly) {
+	if(isReadonly) return ncl_mapDiskBase(ctx, disk, capacity, sectorSize, path);
+	if(ncl_initDisk(ctx, disk, capacity, sectorSize, NULL)) return NN_ENOMEM;
+	disk->unsynced = nn_alloc(ctx, ncl_dirtySize(disk->sectorCount));
+	if(disk->unsynced == NULL) goto fail;
+	memset(disk->unsynced, 0, ncl_dirtySize(disk->sectorCount));
+	disk->fd = open(path, O_RDWR | O_CREAT, 0666);
+	if(disk->fd < 0) goto fail;
+	// Reserved, not just sparse, as writing into a hole of the mapping
+	// once the host disk is full would raise SIGBUS
+	if(posix_fallocate(disk->fd, 0, capacity) != 0) goto fail;
+	void *map = mmap(NULL, capacity, PROT_READ | PROT_WRITE, MAP_SHARED, disk->fd, 0);
+	if(map == MAP_FAILED) goto fail;
+	disk->map = map;
+	disk->lock = lock;
+	for(size_t i = 0; i < disk->sectorCount; i++) disk->sectors[i] = disk->map + i * sectorSize;
+	return NN_OK;
+fail:
+	if(disk->fd >= 0) close(disk->fd);
+	nn_free(ctx, disk->unsynced, ncl_dirtySize(disk->sectorCount));
+	ncl_deinitDisk(ctx, disk);
+	return NN_EBADCALL;
+}
+
+static void ncl_clearDirty(unsigned char *dirty, size_t i) {
+	dirty[i / 8] &= ~(1 << (i % 8));
+}
+
+// Writes the sectors changed since the last flush back to the file.
+// If wait is set, this only returns once they are on the disk.
+static bool ncl_flushDisk(ncl_Disk *disk, bool wait) {
+	size_t page = sysconf(_SC_PAGESIZE);
+	int flags = wait ? MS_SYNC : MS_ASYNC;
+	bool ok = true;
+	size_t i = 0;
+	while(i < disk->sectorCount) {
+		if(!ncl_isDirty(disk->unsynced, i)) {
+			i++;
+			continue;
+		}
+		size_t start = i;
+		while(i < disk->sectorCount && ncl_isDirty(disk->unsynced, i)) i++;
+		size_t off = start * disk->sectorSize;
+		size_t end = i * disk->sectorSize;
+		if(end > disk->capacity) end = disk->capacity;
+		// msync wants page aligned addresses
+		size_t aligned = off - off % page;
+		if(msync(disk->map + aligned, end - aligned, flags) != 0) {
+			// kept, so the next flush tries again
+			ok = false;
+			continue;
+		}
+		for(size_t j = start; j < i; j++) ncl_clearDirty(disk->unsynced, j);
+	}
+	if(wait && fsync(disk->fd) != 0) ok = false;
+	return ok;
+}
+
+// Like ncl_flushDisk(disk, true), but the disk's lock is only held to take the unsynced sectors,
+// so readers do not wait on the disk.
+static bool ncl_syncDisk(ncl_Disk *disk) {
+	// set once mapped, so it is fine to check unlocked
+	if(disk->map == NULL) return true;
+	nn_lock(disk->ctx, disk->lock);
+	size_t lo = disk->sectorCount, hi = 0;
+	for(size_t i = 0; i < disk->sectorCount; i++) {
+		if(!ncl_isDirty(disk->unsynced, i)) continue;
+		if(i < lo) lo = i;
+		hi = i + 1;
+		ncl_clearDirty(disk->unsynced, i);
+	}
+	nn_unlock(disk->ctx, disk->lock);
+
+	bool ok = true;
+	if(lo < hi) {
+		size_t page = sysconf(_SC_PAGESIZE);
+		size_t off = lo * disk->sectorSize;
+		size_t end = hi * disk->sectorSize;
+		if(end > disk->capacity) end = disk->capacity;
+		size_t aligned = off - off % page;
+		// the clean pages in between cost nothing
+		if(msync(disk->map + aligned, end - aligned, MS_SYNC) != 0) ok = false;
+	}
+	if(fsync(disk->fd) != 0) ok = false;
+	if(!ok && lo < hi) {
+		// marked again, so the next flush tries again
+		nn_lock(disk->ctx, disk->lock);
+		for(size_t i = lo; i < hi; i++) ncl_setDirty(disk->unsynced, i);
+		nn_unlock(disk->ctx, disk->lock);
+	}
+	return ok;
+}
+
+static void ncl_unmapDisk(ncl_Disk *disk) {
+	if(disk->baseMap != NULL) {
+		munmap(disk->baseMap, disk->baseLen);
+		return;
+	}
+	ncl_DiskFlusher *flusher = disk->flusher;
+	if(flusher != NULL) {
+		pthread_mutex_lock(&flusher->mutex);
+		if(disk->prevFlushed != NULL) disk->prevFlushed->nextFlushed = disk->nextFlushed;
+		else flusher->disks = disk->nextFlushed;
+		if(disk->nextFlushed != NULL) disk->nextFlushed->prevFlushed = disk->prevFlushed;
+		pthread_mutex_unlock(&flusher->mutex);
+	}
+	// the kernel still writes back what is left
+	ncl_flushDisk(disk, false);
+	munmap(disk->map, disk->capacity);
+	close(disk->fd);
+}
+
+static void ncl_attachDisk(ncl_Disk *disk, ncl_DiskFlusher *flusher) {
+	// read-only ones have nothing to write back
+	if(flusher == NULL || disk->map == NULL) return;
+	pthread_mutex_lock(&flusher->mutex);
+	disk->flusher = flusher;
+	disk->prevFlushed = NULL;
+	disk->nextFlushed = flusher->disks;
+	if(flusher->disks != NULL) flusher->disks->prevFlushed = disk;
+	flusher->disks = disk;
+	pthread_mutex_unlock(&flusher->mutex);
+}
+
+static void *ncl_flusherThread(void *arg) {
+	ncl_DiskFlusher *flusher = arg;
+	pthread_mutex_lock(&flusher->mutex);
+	while(!flusher->stop) {
+		struct timespec until;
+		clock_gettime(CLOCK_REALTIME, &until);
+		double secs = until.tv_sec + until.tv_nsec / 1e9 + flusher->interval;
+		until.tv_sec = secs;
+		until.tv_nsec = (secs - until.tv_sec) * 1e9;
+		pthread_cond_timedwait(&flusher->wake, &flusher->mutex, &until);
+		if(flusher->stop) break;
+		for(ncl_Disk *disk = flusher->disks; disk != NULL; disk = disk->nextFlushed) {
+			nn_lock(disk->ctx, disk->lock);
+			ncl_flushDisk(disk, false);
+			nn_unlock(disk->ctx, disk->lock);
+		}
+	}
+	pthread_mutex_unlock(&flusher->mutex);
+	return NULL;
+}
+
+ncl_DiskFlusher *ncl_createDiskFlusher(nn_Universe *universe, double interval) {
+	nn_Context *ctx = nn_getUniverseContext(universe);
+	ncl_DiskFlusher *flusher = nn_alloc(ctx, sizeof(*flusher));
+	if(flusher == NULL) return NULL;
+	flusher->ctx = ctx;
+	flusher->interval = interval;
+	flusher->stop = false;
+	flusher->disks = NULL;
+	if(pthread_mutex_init(&flusher->mutex, NULL) != 0) goto fail;
+	if(pthread_cond_init(&flusher->wake, NULL) != 0) {
+		pthread_mutex_destroy(&flusher->mutex);
+		goto fail;
+	}
+	if(pthread_create(&flusher->thread, NULL, ncl_flusherThread, flusher) != 0) {
+		pthread_cond_destroy(&flusher->wake);
+		pthread_mutex_destroy(&flusher->mutex);
+		goto fail;
+	}
+	return flusher;
+fail:
+	nn_free(ctx, flusher, sizeof(*flusher));
+	return NULL;
+}
+
+void ncl_destroyDiskFlusher(ncl_DiskFlusher *flusher) {
+	pthread_mutex_lock(&flusher->mutex);
+	flusher->stop = true;
+	pthread_cond_signal(&flusher->wake);
+	pthread_mutex_unlock(&flusher->mutex);
+	pthread_join(flusher->thread, NULL);
+	pthread_cond_destroy(&flusher->wake);
+	pthread_mutex_destroy(&flusher->mutex);
+	nn_free(flusher->ctx, flusher, sizeof(*flusher));
+}
+
+#else
+
+// no mmap, so no file-backed disks
+
+static nn_Exit ncl_mapDisk(nn_Context *ctx, ncl_Disk *disk, size_t capacity, size_t sectorSize, const char *path, nn_Lock *lock, bool isReadonly) {
+	return NN_EBADSTATE;
+}
+
+static bool ncl_flushDisk(ncl_Disk *disk, bool wait) {
+	return true;
+}
+
+static bool ncl_syncDisk(ncl_Disk *disk) {
+	return true;
+}
+
+static void ncl_unmapDisk(ncl_Disk *disk) {}
+
+static void ncl_attachDisk(ncl_Disk *disk, ncl_DiskFlusher *flusher) {}
+
+ncl_DiskFlusher *ncl_createDiskFlusher(nn_Universe *universe, double interval) {
+	return NULL;
+}
+
+void ncl_destroyDiskFlusher(ncl_DiskFlusher *flusher) {}
+
+#endif
+
+// a queued submitRead or submitWrite
+typedef struct ncl_DriveIO {
+	nn_Computer *computer;
+	size_t id;
+	size_t sector;
+	// a copy of what to write, or NULL for a read
+	char *data;
+	// in context time
+	double submitted;
+	// whether the head was sent to it, and when it is done, in context time
+	bool scheduled;
+	double done;
+	// whether it was returned by a poll, which for writes means it landed, with err set
+	bool performed;
+	nn_Exit err;
+} ncl_DriveIO;
+
 typedef struct ncl_DriveState {
 	nn_Context *ctx;
 	nn_Lock *lock;
 	nn_Drive conf;
 	bool isReadonly;
 	size_t usage;
+	// also where the head is, for queued requests
 	size_t lastSector;
-	char *data;
+	ncl_Disk disk;
 	char label[NN_MAX_LABEL];
 	size_t labellen;
+	// see ncl_setDriveAsync()
+	bool async;
+	// which way the elevator sweeps
+	bool sweepingUp;
+	// when the head is free again, in context time
+	double busyUntil;
+	size_t nextID;
+	size_t queueLen;
+	ncl_DriveIO queue[NCL_MAX_DRIVEQUEUE];
 } ncl_DriveState;
 
 typedef struct ncl_FlashState {
@@ -639,7 +1146,7 @@ typedef struct ncl_FlashState {
 	bool isReadonly;
 	size_t usage;
 	size_t writeCount;
-	char *data;
+	ncl_Disk disk;
 	char label[NN_MAX_LABEL];
 	size_t labellen;
 } ncl_FlashState;
@@ -1076,6 +1583,10 @@ nn_Component *ncl_createFilesystem(nn_Universe *universe, const char *address, c
 }
 
 typedef struct ncl_TmpFile {
+	// stable across renames, so encoded deltas can refer to it
+	size_t inode;
+	// contents changed since the last encode
+	bool dirty;
 	size_t openHandles;
 	struct ncl_TmpFile *parent;
 	struct ncl_TmpFile *next;
@@ -1084,12 +1595,49 @@ typedef struct ncl_TmpFile {
 		struct ncl_TmpFile *files;
 		struct {
 			char *data;
+			// the size of the file, which is what it costs in space
 			size_t datalen;
+			// what data can hold. It grows geometrically, so appends are amortized O(1),
+			// and is trimmed back to datalen once the file is closed.
+			size_t datacap;
 		};
 	};
 	char *name;
 } ncl_TmpFile;
 
+// the smallest allocation for the contents of a file
+#define NCL_TMPFILE_MINCAP 64
+
+// makes room for len bytes, growing to at least twice the previous capacity
+static bool ncl_tmpReserve(nn_Context *ctx, ncl_TmpFile *f, size_t len, size_t limit) {
+	if(len <= f->datacap) return true;
+	size_t cap = f->datacap < NCL_TMPFILE_MINCAP ? NCL_TMPFILE_MINCAP : f->datacap;
+	while(cap < len) cap *= 2;
+	// no point in going past what the filesystem can hold
+	if(cap > limit && len <= limit) cap = limit;
+	char *data = nn_realloc(ctx, f->data, f->datacap, cap);
+	if(data == NULL) return false;
+	f->data = data;
+	f->datacap = cap;
+	return true;
+}
+
+// gives back the spare capacity, which does not count towards the space used
+static void ncl_tmpTrim(nn_Context *ctx, ncl_TmpFile *f) {
+	if(f->datacap == f->datalen) return;
+	if(f->datalen == 0) {
+		nn_free(ctx, f->data, f->datacap);
+		f->data = NULL;
+		f->datacap = 0;
+		return;
+	}
+	char *data = nn_realloc(ctx, f->data, f->datacap, f->datalen);
+	// it can keep the bigger buffer
+	if(data == NULL) return;
+	f->data = data;
+	f->datacap = f->datalen;
+}
+
 size_t ncl_segmentLen(const char *text) {
 	size_t l = 0;
 	while(text[l]) {
@@ -1117,6 +1665,7 @@ typedef struct ncl_TmpFS {
 	size_t usage;
 	nn_Filesystem conf;
 	ncl_TmpFile *root;
+	size_t nextInode;
 	size_t spaceUsed;
 	size_t labellen;
 	char label[NN_MAX_LABEL];
@@ -1138,7 +1687,8 @@ ncl_TmpFile *ncl_tmpGet(ncl_TmpFile *root, const char *path) {
 	return NULL;
 }
 
-ncl_TmpFile *ncl_tmpAllocFile(nn_Context *ctx, const char *name, bool isFile) {
+ncl_TmpFile *ncl_tmpAllocFile(ncl_TmpFS *fs, const char *name, bool isFile) {
+	nn_Context *ctx = fs->ctx;
 	ncl_TmpFile *f = nn_alloc(ctx, sizeof(*f));
 	if(f == NULL) return NULL;
 	f->name = nn_strdup(ctx, name);
@@ -1146,10 +1696,13 @@ ncl_TmpFile *ncl_tmpAllocFile(nn_Context *ctx, const char *name, bool isFile) {
 		nn_free(ctx, f, sizeof(*f));
 		return NULL;
 	}
+	f->inode = fs->nextInode++;
+	f->dirty = true;
 	f->isFile = isFile;
 	if(isFile) {
 		f->data = NULL;
 		f->datalen = 0;
+		f->datacap = 0;
 	} else {
 		f->files = NULL;
 	}
@@ -1161,7 +1714,7 @@ ncl_TmpFile *ncl_tmpAllocFile(nn_Context *ctx, const char *name, bool isFile) {
 
 void ncl_tmpFreeFile(nn_Context *ctx, ncl_TmpFile *f) {
 	if(f->isFile) {
-		nn_free(ctx, f->data, f->datalen);
+		nn_free(ctx, f->data, f->datacap);
 	} else {
 		ncl_TmpFile *iter = f->files;
 		while(iter) {
@@ -1218,7 +1771,7 @@ const char *ncl_tmpMkdir(ncl_TmpFS *fs, ncl_TmpFile *root, const char *path) {
 	char dirname[NN_MAX_PATH];
 	memcpy(dirname, path, l);
 	dirname[l] = '\0';
-	ncl_TmpFile *dir = ncl_tmpAllocFile(fs->ctx, dirname, false);
+	ncl_TmpFile *dir = ncl_tmpAllocFile(fs, dirname, false);
 	if(dir == NULL) return "out of memory";
 	dir->parent = root;
 	dir->next = root->files;
@@ -1326,7 +1879,9 @@ static nn_Exit ncl_tmpfsHandler(nn_FSRequest *req) {
 			nn_setError(C, "bad file descriptor");
 			return NN_EBADCALL;
 		}
-		tmpfs->fds[fd].file->openHandles--;
+		ncl_TmpFile *f = tmpfs->fds[fd].file;
+		f->openHandles--;
+		if(f->openHandles == 0) ncl_tmpTrim(ctx, f);
 		tmpfs->fds[fd].file = NULL;
 		tmpfs->fds[fd].offset = 0;
 		nn_unlock(ctx, tmpfs->lock);
@@ -1424,7 +1979,7 @@ static nn_Exit ncl_tmpfsHandler(nn_FSRequest *req) {
 				return NN_EBADCALL;
 			}
 
-			f = ncl_tmpAllocFile(ctx, name, true);
+			f = ncl_tmpAllocFile(tmpfs, name, true);
 			if(f == NULL) {
 				nn_unlock(ctx, tmpfs->lock);
 				return NN_ENOMEM;
@@ -1433,6 +1988,7 @@ static nn_Exit ncl_tmpfsHandler(nn_FSRequest *req) {
 			f->next = dir->files;
 			f->parent = dir;
 			dir->files = f;
+			tmpfs->spaceUsed += tmpfs->fileCost;
 		}
 		if(!f->isFile) {
 			nn_unlock(ctx, tmpfs->lock);
@@ -1441,9 +1997,11 @@ static nn_Exit ncl_tmpfsHandler(nn_FSRequest *req) {
 		}
 		if(mode[0] == 'w') {
 			tmpfs->spaceUsed -= f->datalen;
-			nn_free(ctx, f->data, f->datalen);
+			nn_free(ctx, f->data, f->datacap);
 			f->data = NULL;
 			f->datalen = 0;
+			f->datacap = 0;
+			f->dirty = true;
 		}
 		if(mode[0] != 'r') {
 			// modify mtime here ig
@@ -1475,19 +2033,21 @@ static nn_Exit ncl_tmpfsHandler(nn_FSRequest *req) {
 			nn_setError(C, "bad file descriptor");
 			return NN_EBADCALL;
 		}
-		size_t capNeeded = fildes->offset + req->write.len;
-		if(capNeeded > fildes->file->datalen) {
-			char *data = nn_realloc(ctx, fildes->file->data, fildes->file->datalen, capNeeded);
-			if(data == NULL) {
-				nn_unlock(ctx, tmpfs->lock);
-				return NN_ENOMEM;
-			}
-			fildes->file->data = data;
-			fildes->file->datalen = capNeeded;
+		ncl_TmpFile *f = fildes->file;
+		size_t end = fildes->offset + req->write.len;
+		if(!ncl_tmpReserve(ctx, f, end, tmpfs->conf.spaceTotal)) {
+			nn_unlock(ctx, tmpfs->lock);
+			return NN_ENOMEM;
 		}
 		// ubsan is acting weird
-		if(fildes->file->data != NULL) memcpy(fildes->file->data + fildes->offset, req->write.buf, req->write.len);
+		if(f->data != NULL) memcpy(f->data + fildes->offset, req->write.buf, req->write.len);
+		if(end > f->datalen) {
+			// only the size counts, not the spare capacity
+			if(tmpfs->spaceUsed != 0) tmpfs->spaceUsed += end - f->datalen;
+			f->datalen = end;
+		}
 		fildes->offset += req->write.len;
+		fildes->file->dirty = true;
 		nn_unlock(ctx, tmpfs->lock);
 		return NN_OK;
 	}
@@ -1520,7 +2080,6 @@ static nn_Exit ncl_tmpfsHandler(nn_FSRequest *req) {
 			req->read.len = read;
 			fildes->offset += read;
 		}
-		tmpfs->spaceUsed = 0;
 		nn_unlock(ctx, tmpfs->lock);
 		return NN_OK;
 	}
@@ -1674,7 +2233,8 @@ nn_Component *ncl_createTmpFS(nn_Universe *universe, const char *address, const
 		nn_free(ctx, state, sizeof(*state));
 		return NULL;
 	}
-	state->root = ncl_tmpAllocFile(ctx, "", false);
+	state->nextInode = 1;
+	state->root = ncl_tmpAllocFile(state, "", false);
 	if(state->root == NULL) {
 		nn_destroyLock(ctx, state->lock);
 		nn_free(ctx, state, sizeof(*state));
@@ -1703,6 +2263,128 @@ nn_Component *ncl_createTmpFS(nn_Universe *universe, const char *address, const
 	return c;
 }
 
+ncl_DiskImage *ncl_createDiskImage(nn_Universe *universe, const char *data, size_t len) {
+	nn_Context *ctx = nn_getUniverseContext(universe);
+	ncl_DiskImage *image = nn_alloc(ctx, sizeof(*image) + len);
+	if(image == NULL) return NULL;
+	image->lock = nn_createLock(ctx);
+	if(image->lock == NULL) {
+		nn_free(ctx, image, sizeof(*image) + len);
+		return NULL;
+	}
+	image->ctx = ctx;
+	image->refs = 1;
+	image->len = len;
+	if(len > 0) memcpy(image->data, data, len);
+	return image;
+}
+
+void ncl_retainDiskImage(ncl_DiskImage *image) {
+	nn_lock(image->ctx, image->lock);
+	image->refs++;
+	nn_unlock(image->ctx, image->lock);
+}
+
+void ncl_releaseDiskImage(ncl_DiskImage *image) {
+	nn_lock(image->ctx, image->lock);
+	size_t refs = --image->refs;
+	nn_unlock(image->ctx, image->lock);
+	if(refs > 0) return;
+	nn_destroyLock(image->ctx, image->lock);
+	nn_free(image->ctx, image, sizeof(*image) + image->len);
+}
+
+// where the sector is on its platter, which is what the head moves across
+static size_t ncl_driveAngle(ncl_DriveState *drv, size_t sector) {
+	size_t sectorsPerPlatter = drv->conf.capacity / drv->conf.sectorSize / drv->conf.platterCount;
+	return sector % sectorsPerPlatter;
+}
+
+// SCAN: the closest request ahead of the head, in the direction it sweeps.
+// Once there are none, it turns around, or wraps back if it can only spin forwards.
+static ncl_DriveIO *ncl_drivePickNext(ncl_DriveState *drv, double t) {
+	size_t head = ncl_driveAngle(drv, drv->lastSector);
+	for(int pass = 0; pass < 2; pass++) {
+		ncl_DriveIO *best = NULL;
+		size_t bestDist = 0;
+		for(size_t i = 0; i < drv->queueLen; i++) {
+			ncl_DriveIO *io = &drv->queue[i];
+			if(io->scheduled || io->submitted > t) continue;
+			size_t angle = ncl_driveAngle(drv, io->sector);
+			size_t dist;
+			if(drv->sweepingUp) {
+				if(angle < head) continue;
+				dist = angle - head;
+			} else {
+				if(angle > head) continue;
+				dist = head - angle;
+			}
+			// ties go to the oldest, which comes first
+			if(best == NULL || dist < bestDist) {
+				best = io;
+				bestDist = dist;
+			}
+		}
+		if(best != NULL) return best;
+		if(drv->conf.onlySpinForwards) {
+			head = 0;
+		} else {
+			drv->sweepingUp = !drv->sweepingUp;
+		}
+	}
+	return NULL;
+}
+
+// sends the head to the queued requests, one after the other, until it is busy past now
+static void ncl_driveAdvance(ncl_DriveState *drv, double now) {
+	while(drv->busyUntil <= now) {
+		double t = drv->busyUntil;
+		// if it idled, it starts with the first request to come in
+		bool waiting = false;
+		double first = now;
+		for(size_t i = 0; i < drv->queueLen; i++) {
+			ncl_DriveIO *io = &drv->queue[i];
+			if(io->scheduled) continue;
+			waiting = true;
+			if(io->submitted < first) first = io->submitted;
+		}
+		if(!waiting) return;
+		if(first > t) t = first;
+		ncl_DriveIO *io = ncl_drivePickNext(drv, t);
+		if(io == NULL) return;
+		io->scheduled = true;
+		io->done = t + nn_getDriveSeekTime(&drv->conf, drv->lastSector, io->sector);
+		drv->lastSector = io->sector;
+		drv->busyUntil = io->done;
+	}
+}
+
+// when the computer should poll next, in context time, or a negative number if it has nothing queued
+static double ncl_driveNextPoll(ncl_DriveState *drv, nn_Computer *C) {
+	double next = -1;
+	for(size_t i = 0; i < drv->queueLen; i++) {
+		ncl_DriveIO *io = &drv->queue[i];
+		if(io->computer != C) continue;
+		// an unscheduled one is looked at again once the head is free
+		double t = io->scheduled ? io->done : drv->busyUntil;
+		if(next < 0 || t < next) next = t;
+	}
+	return next;
+}
+
+static double ncl_driveToUptime(nn_Computer *C, double t, double now) {
+	if(t < 0) return t;
+	if(t < now) t = now;
+	return nn_getUptime(C) + (t - now);
+}
+
+static void ncl_driveRemoveIO(ncl_DriveState *drv, size_t i) {
+	nn_free(drv->ctx, drv->queue[i].data, drv->conf.sectorSize);
+	drv->queueLen--;
+	// shifted, so the queue stays oldest first
+	for(; i < drv->queueLen; i++) drv->queue[i] = drv->queue[i + 1];
+}
+
 static nn_Exit ncl_drvHandler(nn_DriveRequest *request) {
 	nn_Context *ctx = request->ctx;
 	nn_Computer *C = request->computer;
@@ -1710,8 +2392,10 @@ static nn_Exit ncl_drvHandler(nn_DriveRequest *request) {
 	size_t ss = drv->conf.sectorSize;
 
 	if(request->action == NN_DRIVE_DROP) {
+		// first, as the flusher may be using the lock
+		ncl_deinitDisk(ctx, &drv->disk);
+		while(drv->queueLen > 0) ncl_driveRemoveIO(drv, drv->queueLen - 1);
 		nn_destroyLock(ctx, drv->lock);
-		nn_free(ctx, drv->data, drv->conf.capacity);
 		nn_free(ctx, drv, sizeof(*drv));
 		return NN_OK;
 	}
@@ -1727,6 +2411,109 @@ static nn_Exit ncl_drvHandler(nn_DriveRequest *request) {
 		nn_unlock(ctx, drv->lock);
 		return NN_OK;
 	}
+	if(request->action == NN_DRIVE_ISASYNC) {
+		nn_lock(ctx, drv->lock);
+		request->async = drv->async;
+		nn_unlock(ctx, drv->lock);
+		return NN_OK;
+	}
+	if(request->action == NN_DRIVE_SUBMIT) {
+		double now = nn_currentTime(ctx);
+		nn_lock(ctx, drv->lock);
+		if(request->submit.buf != NULL && drv->isReadonly) {
+			nn_unlock(ctx, drv->lock);
+			nn_setError(C, "drive is readonly");
+			return NN_EBADCALL;
+		}
+		if(drv->queueLen == NCL_MAX_DRIVEQUEUE) {
+			nn_unlock(ctx, drv->lock);
+			nn_setError(C, "drive queue is full");
+			return NN_EBADCALL;
+		}
+		char *data = NULL;
+		if(request->submit.buf != NULL) {
+			data = nn_alloc(ctx, ss);
+			if(data == NULL) {
+				nn_unlock(ctx, drv->lock);
+				return NN_ENOMEM;
+			}
+			memcpy(data, request->submit.buf, ss);
+		}
+		// whatever was done before it came in stays done
+		ncl_driveAdvance(drv, now);
+		ncl_DriveIO *io = &drv->queue[drv->queueLen++];
+		io->computer = C;
+		io->id = ++drv->nextID;
+		io->sector = request->submit.sector;
+		io->data = data;
+		io->submitted = now;
+		io->scheduled = false;
+		io->done = 0;
+		io->performed = false;
+		io->err = NN_OK;
+		ncl_driveAdvance(drv, now);
+		request->submit.id = io->id;
+		request->submit.pollAt = ncl_driveToUptime(C, ncl_driveNextPoll(drv, C), now);
+		nn_unlock(ctx, drv->lock);
+		return NN_OK;
+	}
+	if(request->action == NN_DRIVE_POLL) {
+		double now = nn_currentTime(ctx);
+		nn_lock(ctx, drv->lock);
+		ncl_driveAdvance(drv, now);
+		size_t found = drv->queueLen;
+		for(size_t i = 0; i < drv->queueLen; i++) {
+			ncl_DriveIO *io = &drv->queue[i];
+			if(io->computer != C || !io->scheduled || io->done > now) continue;
+			if(found == drv->queueLen || io->done < drv->queue[found].done) found = i;
+		}
+		// it stays queued until its signal made it, so a full signal queue does not lose it
+		if(found < drv->queueLen) {
+			ncl_DriveIO *io = &drv->queue[found];
+			size_t off = (io->sector - 1) * ss;
+			request->poll.done = true;
+			request->poll.id = io->id;
+			request->poll.read = io->data == NULL;
+			if(io->data == NULL) {
+				ncl_diskRead(&drv->disk, off, request->poll.buf, ss);
+			} else if(!io->performed) {
+				io->err = ncl_diskWrite(ctx, &drv->disk, off, io->data, ss);
+			}
+			if(!io->performed) drv->usage++;
+			io->performed = true;
+			request->poll.err = io->err;
+		}
+		request->poll.pollAt = ncl_driveToUptime(C, ncl_driveNextPoll(drv, C), now);
+		nn_unlock(ctx, drv->lock);
+		return NN_OK;
+	}
+	if(request->action == NN_DRIVE_RETIRE) {
+		nn_lock(ctx, drv->lock);
+		for(size_t i = 0; i < drv->queueLen; i++) {
+			ncl_DriveIO *io = &drv->queue[i];
+			if(io->computer != C || io->id != request->poll.id) continue;
+			ncl_driveRemoveIO(drv, i);
+			break;
+		}
+		nn_unlock(ctx, drv->lock);
+		return NN_OK;
+	}
+	if(request->action == NN_DRIVE_FORGET) {
+		nn_lock(ctx, drv->lock);
+		size_t i = 0;
+		while(i < drv->queueLen) {
+			ncl_DriveIO *io = &drv->queue[i];
+			if(io->computer != C) {
+				i++;
+				continue;
+			}
+			// the writes were accepted, so they still land, once
+			if(io->data != NULL && !io->performed) ncl_diskWrite(ctx, &drv->disk, (io->sector - 1) * ss, io->data, ss);
+			ncl_driveRemoveIO(drv, i);
+		}
+		nn_unlock(ctx, drv->lock);
+		return NN_OK;
+	}
 	if(request->action == NN_DRIVE_GETLABEL) {
 		nn_lock(ctx, drv->lock);
 		drv->usage++;
@@ -1739,21 +2526,49 @@ static nn_Exit ncl_drvHandler(nn_DriveRequest *request) {
 		nn_lock(ctx, drv->lock);
 		drv->usage++;
 		size_t off = (request->readSector.sector - 1) * ss;
-		memcpy(request->readSector.buf, drv->data + off, ss);
+		ncl_diskRead(&drv->disk, off, request->readSector.buf, ss);
 		drv->lastSector = request->readSector.sector;
 		nn_unlock(ctx, drv->lock);
 		return NN_OK;
 	}
+	if(request->action == NN_DRIVE_READSECTORS) {
+		nn_lock(ctx, drv->lock);
+		drv->usage++;
+		size_t off = (request->readSectors.sector - 1) * ss;
+		ncl_diskRead(&drv->disk, off, request->readSectors.buf, ss * request->readSectors.count);
+		drv->lastSector = request->readSectors.sector + request->readSectors.count - 1;
+		nn_unlock(ctx, drv->lock);
+		return NN_OK;
+	}
+	if(request->action == NN_DRIVE_WRITESECTOR || request->action == NN_DRIVE_WRITESECTORS) {
+		bool many = request->action == NN_DRIVE_WRITESECTORS;
+		size_t sector = many ? request->writeSectors.sector : request->writeSector.sector;
+		size_t count = many ? request->writeSectors.count : 1;
+		const char *buf = many ? request->writeSectors.buf : request->writeSector.buf;
+		nn_lock(ctx, drv->lock);
+		if(drv->isReadonly) {
+			nn_unlock(ctx, drv->lock);
+			if(C) nn_setError(C, "drive is readonly");
+			return NN_EBADCALL;
+		}
+		drv->usage++;
+		if(ncl_diskWrite(ctx, &drv->disk, (sector - 1) * ss, buf, ss * count)) {
+			nn_unlock(ctx, drv->lock);
+			return NN_ENOMEM;
+		}
+		drv->lastSector = sector + count - 1;
+		nn_unlock(ctx, drv->lock);
+		return NN_OK;
+	}
 	
 	if(C) nn_setError(C, "ncl-drive: not implemented yet");
 	return NN_EBADCALL;
 }
 
-nn_Component *ncl_createDrive(nn_Universe *universe, const char *address, const nn_Drive *drive, const char *data, size_t len, bool isReadonly) {
+nn_Component *ncl_createDriveFromImage(nn_Universe *universe, const char *address, const nn_Drive *drive, ncl_DiskImage *image, bool isReadonly) {
 	nn_Context *ctx = nn_getUniverseContext(universe);
 	nn_Component *c = NULL;
 	nn_Lock *lock = NULL;
-	char *databuf = NULL;
 	ncl_DriveState *state = NULL;
 
 	state = nn_alloc(ctx, sizeof(*state));
@@ -1762,11 +2577,7 @@ nn_Component *ncl_createDrive(nn_Universe *universe, const char *address, const
 	lock = nn_createLock(ctx);
 	if(lock == NULL) goto fail;
 
-	databuf = nn_alloc(ctx, drive->capacity);
-	if(databuf == NULL) goto fail;
-	if(len > drive->capacity) len = drive->capacity;
-	memcpy(databuf, data, len);
-	memset(databuf + len, 0, drive->capacity - len);
+	if(ncl_initDisk(ctx, &state->disk, drive->capacity, drive->sectorSize, image)) goto fail;
 
 	state->ctx = ctx;
 	state->lock = lock;
@@ -1774,12 +2585,64 @@ nn_Component *ncl_createDrive(nn_Universe *universe, const char *address, const
 	state->usage = 0;
 	state->labellen = 0;
 	state->lastSector = 1;
-	state->data = databuf;
 	state->isReadonly = isReadonly;
+	state->async = false;
+	state->sweepingUp = true;
+	state->busyUntil = 0;
+	state->nextID = 0;
+	state->queueLen = 0;
 
 	c = nn_createDrive(universe, address, drive, state, ncl_drvHandler);
-	if(c == NULL) goto fail;
+	if(c == NULL) {
+		ncl_deinitDisk(ctx, &state->disk);
+		goto fail;
+	}
+	if(nn_setComponentTypeID(c, NCL_DRIVE)) goto fail;
+	return c;
+fail:
+	if(c != NULL) {
+		nn_dropComponent(c);
+		return NULL;
+	}
+	if(lock != NULL) nn_destroyLock(ctx, lock);
+	nn_free(ctx, state, sizeof(*state));
+	return NULL;
+}
+
+nn_Component *ncl_createDriveFromFile(nn_Universe *universe, const char *address, const nn_Drive *drive, const char *path, ncl_DiskFlusher *flusher, bool isReadonly) {
+	nn_Context *ctx = nn_getUniverseContext(universe);
+	nn_Component *c = NULL;
+	nn_Lock *lock = NULL;
+	ncl_DriveState *state = NULL;
+
+	state = nn_alloc(ctx, sizeof(*state));
+	if(state == NULL) goto fail;
+
+	lock = nn_createLock(ctx);
+	if(lock == NULL) goto fail;
+
+	if(ncl_mapDisk(ctx, &state->disk, drive->capacity, drive->sectorSize, path, lock, isReadonly)) goto fail;
+
+	state->ctx = ctx;
+	state->lock = lock;
+	state->conf = *drive;
+	state->usage = 0;
+	state->labellen = 0;
+	state->lastSector = 1;
+	state->isReadonly = isReadonly;
+	state->async = false;
+	state->sweepingUp = true;
+	state->busyUntil = 0;
+	state->nextID = 0;
+	state->queueLen = 0;
+
+	c = nn_createDrive(universe, address, drive, state, ncl_drvHandler);
+	if(c == NULL) {
+		ncl_deinitDisk(ctx, &state->disk);
+		goto fail;
+	}
 	if(nn_setComponentTypeID(c, NCL_DRIVE)) goto fail;
+	ncl_attachDisk(&state->disk, flusher);
 	return c;
 fail:
 	if(c != NULL) {
@@ -1787,11 +2650,22 @@ fail:
 		return NULL;
 	}
 	if(lock != NULL) nn_destroyLock(ctx, lock);
-	nn_free(ctx, databuf, drive->capacity);
 	nn_free(ctx, state, sizeof(*state));
 	return NULL;
 }
 
+nn_Component *ncl_createDrive(nn_Universe *universe, const char *address, const nn_Drive *drive, const char *data, size_t len, bool isReadonly) {
+	if(len > drive->capacity) len = drive->capacity;
+	ncl_DiskImage *image = NULL;
+	if(len > 0) {
+		image = ncl_createDiskImage(universe, data, len);
+		if(image == NULL) return NULL;
+	}
+	nn_Component *c = ncl_createDriveFromImage(universe, address, drive, image, isReadonly);
+	if(image != NULL) ncl_releaseDiskImage(image);
+	return c;
+}
+
 static nn_Exit ncl_flashHandler(nn_FlashRequest *request) {
 	nn_Context *ctx = request->ctx;
 	nn_Computer *C = request->computer;
@@ -1799,8 +2673,9 @@ static nn_Exit ncl_flashHandler(nn_FlashRequest *request) {
 	size_t ss = drv->conf.sectorSize;
 
 	if(request->action == NN_FLASH_DROP) {
+		// first, as the flusher may be using the lock
+		ncl_deinitDisk(ctx, &drv->disk);
 		nn_destroyLock(ctx, drv->lock);
-		nn_free(ctx, drv->data, drv->conf.capacity);
 		nn_free(ctx, drv, sizeof(*drv));
 		return NN_OK;
 	}
@@ -1828,7 +2703,32 @@ static nn_Exit ncl_flashHandler(nn_FlashRequest *request) {
 		nn_lock(ctx, drv->lock);
 		drv->usage++;
 		size_t off = (request->readsector.sec - 1) * ss;
-		memcpy(request->readsector.buf, drv->data + off, ss);
+		ncl_diskRead(&drv->disk, off, request->readsector.buf, ss);
+		nn_unlock(ctx, drv->lock);
+		return NN_OK;
+	}
+	if(request->action == NN_FLASH_READSECTORS) {
+		nn_lock(ctx, drv->lock);
+		drv->usage++;
+		size_t off = (request->readsectors.sec - 1) * ss;
+		ncl_diskRead(&drv->disk, off, request->readsectors.buf, ss * request->readsectors.count);
+		nn_unlock(ctx, drv->lock);
+		return NN_OK;
+	}
+	if(request->action == NN_FLASH_WRITESECTORS) {
+		nn_lock(ctx, drv->lock);
+		if(drv->isReadonly) {
+			nn_unlock(ctx, drv->lock);
+			if(C) nn_setError(C, "flash is readonly");
+			return NN_EBADCALL;
+		}
+		drv->usage++;
+		size_t off = (request->writesectors.sec - 1) * ss;
+		if(ncl_diskWrite(ctx, &drv->disk, off, request->writesectors.buf, ss * request->writesectors.count)) {
+			nn_unlock(ctx, drv->lock);
+			return NN_ENOMEM;
+		}
+		drv->writeCount += request->writesectors.writesAdded;
 		nn_unlock(ctx, drv->lock);
 		return NN_OK;
 	}
@@ -1836,21 +2736,62 @@ static nn_Exit ncl_flashHandler(nn_FlashRequest *request) {
 		nn_lock(ctx, drv->lock);
 		drv->usage++;
 		size_t off = (request->writesector.sec - 1) * ss;
-		memcpy(drv->data + off, request->writesector.buf, ss);
+		if(ncl_diskWrite(ctx, &drv->disk, off, request->writesector.buf, ss)) {
+			nn_unlock(ctx, drv->lock);
+			return NN_ENOMEM;
+		}
 		drv->writeCount += request->writesector.writesAdded;
 		nn_unlock(ctx, drv->lock);
 		return NN_OK;
 	}
-	
-	if(C) nn_setError(C, "ncl-flash: not implemented yet");
-	return NN_EBADCALL;
+	
+	if(C) nn_setError(C, "ncl-flash: not implemented yet");
+	return NN_EBADCALL;
+}
+
+nn_Component *ncl_createFlashFromImage(nn_Universe *universe, const char *address, const nn_NandFlash *flash, ncl_DiskImage *image, bool isReadonly) {
+	nn_Context *ctx = nn_getUniverseContext(universe);
+	nn_Component *c = NULL;
+	nn_Lock *lock = NULL;
+	ncl_FlashState *state = NULL;
+
+	state = nn_alloc(ctx, sizeof(*state));
+	if(state == NULL) goto fail;
+
+	lock = nn_createLock(ctx);
+	if(lock == NULL) goto fail;
+
+	if(ncl_initDisk(ctx, &state->disk, flash->capacity, flash->sectorSize, image)) goto fail;
+
+	state->ctx = ctx;
+	state->lock = lock;
+	state->conf = *flash;
+	state->usage = 0;
+	state->labellen = 0;
+	state->writeCount = 0;
+	state->isReadonly = isReadonly;
+
+	c = nn_createFlash(universe, address, flash, state, ncl_flashHandler);
+	if(c == NULL) {
+		ncl_deinitDisk(ctx, &state->disk);
+		goto fail;
+	}
+	if(nn_setComponentTypeID(c, NCL_FLASH)) goto fail;
+	return c;
+fail:
+	if(c != NULL) {
+		nn_dropComponent(c);
+		return NULL;
+	}
+	if(lock != NULL) nn_destroyLock(ctx, lock);
+	nn_free(ctx, state, sizeof(*state));
+	return NULL;
 }
 
-nn_Component *ncl_createFlash(nn_Universe *universe, const char *address, const nn_NandFlash *flash, const char *data, size_t len, bool isReadonly) {
+nn_Component *ncl_createFlashFromFile(nn_Universe *universe, const char *address, const nn_NandFlash *flash, const char *path, ncl_DiskFlusher *flusher, bool isReadonly) {
 	nn_Context *ctx = nn_getUniverseContext(universe);
 	nn_Component *c = NULL;
 	nn_Lock *lock = NULL;
-	char *databuf = NULL;
 	ncl_FlashState *state = NULL;
 
 	state = nn_alloc(ctx, sizeof(*state));
@@ -1859,11 +2800,7 @@ nn_Component *ncl_createFlash(nn_Universe *universe, const char *address, const
 	lock = nn_createLock(ctx);
 	if(lock == NULL) goto fail;
 
-	databuf = nn_alloc(ctx, flash->capacity);
-	if(databuf == NULL) goto fail;
-	if(len > flash->capacity) len = flash->capacity;
-	memcpy(databuf, data, len);
-	memset(databuf + len, 0, flash->capacity - len);
+	if(ncl_mapDisk(ctx, &state->disk, flash->capacity, flash->sectorSize, path, lock, isReadonly)) goto fail;
 
 	state->ctx = ctx;
 	state->lock = lock;
@@ -1871,12 +2808,15 @@ nn_Component *ncl_createFlash(nn_Universe *universe, const char *address, const
 	state->usage = 0;
 	state->labellen = 0;
 	state->writeCount = 0;
-	state->data = databuf;
 	state->isReadonly = isReadonly;
 
 	c = nn_createFlash(universe, address, flash, state, ncl_flashHandler);
-	if(c == NULL) goto fail;
+	if(c == NULL) {
+		ncl_deinitDisk(ctx, &state->disk);
+		goto fail;
+	}
 	if(nn_setComponentTypeID(c, NCL_FLASH)) goto fail;
+	ncl_attachDisk(&state->disk, flusher);
 	return c;
 fail:
 	if(c != NULL) {
@@ -1884,11 +2824,22 @@ fail:
 		return NULL;
 	}
 	if(lock != NULL) nn_destroyLock(ctx, lock);
-	nn_free(ctx, databuf, flash->capacity);
 	nn_free(ctx, state, sizeof(*state));
 	return NULL;
 }
 
+nn_Component *ncl_createFlash(nn_Universe *universe, const char *address, const nn_NandFlash *flash, const char *data, size_t len, bool isReadonly) {
+	if(len > flash->capacity) len = flash->capacity;
+	ncl_DiskImage *image = NULL;
+	if(len > 0) {
+		image = ncl_createDiskImage(universe, data, len);
+		if(image == NULL) return NULL;
+	}
+	nn_Component *c = ncl_createFlashFromImage(universe, address, flash, image, isReadonly);
+	if(image != NULL) ncl_releaseDiskImage(image);
+	return c;
+}
+
 static nn_Exit ncl_eepromHandler(nn_EEPROMRequest *req) {
 	nn_Context *ctx = req->ctx;
 	nn_Computer *C = req->computer;
@@ -2017,6 +2968,7 @@ nn_Component *ncl_createEEPROM(nn_Universe *universe, const char *address, const
 
 	state->ctx = ctx;
 	state->lock = lock;
+	state->conf = *eeprom;
 	state->usage = 0;
 	state->isReadonly = false;
 	state->code = codebuf;
@@ -2102,7 +3054,7 @@ size_t ncl_readDrive(nn_Component *component, size_t offset, char *buf, size_t l
 		size_t remaining = drv->conf.capacity - offset;
 		if(remaining < len) len = remaining;
 		nn_lock(drv->ctx, drv->lock);
-		memcpy(buf, drv->data + offset, len);
+		ncl_diskRead(&drv->disk, offset, buf, len);
 		nn_unlock(drv->ctx, drv->lock);
 		return len;
 	}
@@ -2112,51 +3064,57 @@ size_t ncl_readDrive(nn_Component *component, size_t offset, char *buf, size_t l
 		size_t remaining = drv->conf.capacity - offset;
 		if(remaining < len) len = remaining;
 		nn_lock(drv->ctx, drv->lock);
-		memcpy(buf, drv->data + offset, len);
+		ncl_diskRead(&drv->disk, offset, buf, len);
 		nn_unlock(drv->ctx, drv->lock);
 		return len;
 	}
 	return 0;
 }
 
-void ncl_writeDrive(nn_Component *component, size_t offset, const char *buf, size_t len) {
+nn_Exit ncl_writeDrive(nn_Component *component, size_t offset, const char *buf, size_t len) {
 	const char *typeid = nn_getComponentTypeID(component);
+	nn_Exit e = NN_EBADCALL;
 	if(strcmp(typeid, NCL_DRIVE) == 0) {
 		ncl_DriveState *drv = nn_getComponentState(component);
-		if(offset > drv->conf.capacity) return;
+		if(offset > drv->conf.capacity) return NN_EBADCALL;
 		size_t remaining = drv->conf.capacity - offset;
 		if(remaining < len) len = remaining;
 		nn_lock(drv->ctx, drv->lock);
-		memcpy(drv->data + offset, buf, len);
+		e = ncl_diskWrite(drv->ctx, &drv->disk, offset, buf, len);
 		nn_unlock(drv->ctx, drv->lock);
-		return;
 	}
 	if(strcmp(typeid, NCL_FLASH) == 0) {
 		ncl_FlashState *drv = nn_getComponentState(component);
-		if(offset > drv->conf.capacity) return;
+		if(offset > drv->conf.capacity) return NN_EBADCALL;
 		size_t remaining = drv->conf.capacity - offset;
 		if(remaining < len) len = remaining;
 		nn_lock(drv->ctx, drv->lock);
-		memcpy(drv->data + offset, buf, len);
+		e = ncl_diskWrite(drv->ctx, &drv->disk, offset, buf, len);
 		nn_unlock(drv->ctx, drv->lock);
-		return;
 	}
+	return e;
 }
 
-char *ncl_getDriveBuffer(nn_Component *component, size_t *len) {
+bool ncl_syncDrive(nn_Component *component) {
 	const char *typeid = nn_getComponentTypeID(component);
+	bool ok = true;
 	if(strcmp(typeid, NCL_DRIVE) == 0) {
 		ncl_DriveState *drv = nn_getComponentState(component);
-		*len = drv->conf.capacity;
-		return drv->data;
+		ok = ncl_syncDisk(&drv->disk);
 	}
 	if(strcmp(typeid, NCL_FLASH) == 0) {
 		ncl_FlashState *drv = nn_getComponentState(component);
-		*len = drv->conf.capacity;
-		return drv->data;
+		ok = ncl_syncDisk(&drv->disk);
 	}
-	if(len != NULL) *len = 0;
-	return NULL;
+	return ok;
+}
+
+void ncl_setDriveAsync(nn_Component *component, bool async) {
+	if(strcmp(nn_getComponentTypeID(component), NCL_DRIVE) != 0) return;
+	ncl_DriveState *drv = nn_getComponentState(component);
+	nn_lock(drv->ctx, drv->lock);
+	drv->async = async;
+	nn_unlock(drv->ctx, drv->lock);
 }
 
 ncl_VFS ncl_getVFS(nn_Component *component) {
@@ -2220,6 +3178,7 @@ static void ncl_setRealScreenPixel(ncl_ScreenState *state, int x, int y, ncl_Scr
 	y--;
 
 	state->pixels[x + y * state->conf.maxWidth] = pixel;
+	ncl_setDirty(state->dirtyRows, y);
 	state->usage++;
 }
 
@@ -2255,6 +3214,8 @@ static nn_Exit ncl_screenHandler(nn_ScreenRequest *req) {
         nn_free(ctx, st->pixels,
             sizeof(ncl_ScreenPixel)
             * st->conf.maxWidth * st->conf.maxHeight);
+        nn_free(ctx, st->dirtyRows,
+            ncl_dirtySize(st->conf.maxHeight));
         nn_free(ctx, st->palette,
             sizeof(int) * st->conf.paletteColors);
         nn_free(ctx, st->resolvedPalette,
@@ -2358,6 +3319,7 @@ nn_Component *ncl_createScreen(nn_Universe *universe, const char *address, const
 	nn_Context *ctx = nn_getUniverseContext(universe);
 	ncl_ScreenState *screen = NULL;
 	ncl_ScreenPixel *pixels = NULL;
+	unsigned char *dirtyRows = NULL;
 	int *palette = NULL;
 	int *resolvedPalette = NULL;
 	nn_Component *c = NULL;
@@ -2372,6 +3334,9 @@ nn_Component *ncl_createScreen(nn_Universe *universe, const char *address, const
 	pixels = nn_alloc(ctx, sizeof(ncl_ScreenPixel) * config->maxWidth * config->maxHeight);
 	if(pixels == NULL) goto fail;
 
+	dirtyRows = nn_alloc(ctx, ncl_dirtySize(config->maxHeight));
+	if(dirtyRows == NULL) goto fail;
+
 	palette = nn_alloc(ctx, sizeof(int) * config->paletteColors);
 	if(palette == NULL) goto fail;
 	memcpy(palette, config->defaultPalette, sizeof(int) * config->paletteColors);
@@ -2387,6 +3352,7 @@ nn_Component *ncl_createScreen(nn_Universe *universe, const char *address, const
 	screen->palette = palette;
 	screen->resolvedPalette = resolvedPalette;
 	screen->pixels = pixels;
+	screen->dirtyRows = dirtyRows;
 	screen->flags = NCL_SCREEN_ON;
 	screen->depth = config->maxDepth;
 	screen->viewportWidth = screen->width;
@@ -2396,6 +3362,7 @@ nn_Component *ncl_createScreen(nn_Universe *universe, const char *address, const
 	screen->usage = 0;
 
 	ncl_resetScreen(screen);
+	memset(dirtyRows, 0, ncl_dirtySize(config->maxHeight));
 
 	c = nn_createScreen(universe, address, config, screen, ncl_screenHandler);
 	if(c == NULL) goto fail;
@@ -2414,12 +3381,13 @@ fail:;
 	nn_free(ctx, palette, sizeof(int) * config->paletteColors);
 	nn_free(ctx, resolvedPalette, sizeof(int) * config->paletteColors);
 	nn_free(ctx, pixels, sizeof(ncl_ScreenPixel) * config->maxWidth * config->maxHeight);
+	nn_free(ctx, dirtyRows, ncl_dirtySize(config->maxHeight));
 	return NULL;
 }
 
 static ncl_ScreenState *ncl_getBoundScreen(ncl_GPUState *gpu, nn_Computer *C) {
 	if(gpu->screenAddress == NULL) return NULL;
-	nn_Component *c = nn_getComponent(C, gpu->screenAddress);
+	nn_Component *c = nn_getComponentHashed(C, gpu->screenAddress, gpu->screenHash);
 	if(c == NULL) return NULL;
 	return nn_getComponentState(c);
 }
@@ -2515,6 +3483,7 @@ static nn_Exit ncl_gpuHandler(nn_GPURequest *req) {
             nn_strfree(ctx, st->screenAddress);
         st->screenAddress =
             nn_strdup(ctx, req->bind.address);
+        st->screenHash = nn_strhash(req->bind.address);
 	// actually set limits
 	    ncl_ScreenState *scr =
 		nn_getComponentState(sc);
@@ -3364,6 +4333,13 @@ void ncl_getScreenMaxResolution(const ncl_ScreenState *state, size_t *width, siz
 nn_Exit ncl_setScreenMaxResolution(ncl_ScreenState *state, size_t width, size_t height) {
 	ncl_ScreenPixel *pixels = nn_alloc(state->ctx, sizeof(ncl_ScreenPixel) * width * height);
 	if(pixels == NULL) return NN_ENOMEM;
+	unsigned char *dirtyRows = nn_alloc(state->ctx, ncl_dirtySize(height));
+	if(dirtyRows == NULL) {
+		nn_free(state->ctx, pixels, sizeof(ncl_ScreenPixel) * width * height);
+		return NN_ENOMEM;
+	}
+	// the layout changed, so every row must be encoded again
+	memset(dirtyRows, 0xFF, ncl_dirtySize(height));
 
 	for(size_t i = 0; i < width*height; i++) {
 		pixels[i].codepoint = ' ';
@@ -3386,9 +4362,11 @@ nn_Exit ncl_setScreenMaxResolution(ncl_ScreenState *state, size_t width, size_t
 	}
 
 	nn_free(state->ctx, state->pixels, sizeof(ncl_ScreenPixel) * state->conf.maxWidth * state->conf.maxHeight);
+	nn_free(state->ctx, state->dirtyRows, ncl_dirtySize(state->conf.maxHeight));
 	state->conf.maxWidth = width;
 	state->conf.maxHeight = height;
 	state->pixels = pixels;
+	state->dirtyRows = dirtyRows;
 	ncl_recomputeScreen(state);
 	return NN_OK;
 }
@@ -3563,6 +4541,8 @@ void ncl_statComponent(nn_Component *component, ncl_ComponentStat *stat) {
 		stat->labellen = drv->labellen;
 		memcpy(stat->label, drv->label, stat->labellen);
 		stat->drive.lastSector = drv->lastSector;
+		stat->drive.residentSize = drv->disk.resident * drv->disk.sectorSize;
+		stat->drive.logicalSize = drv->disk.capacity;
 		nn_unlock(drv->ctx, drv->lock);
 		return;
 	}
@@ -3579,6 +4559,8 @@ void ncl_statComponent(nn_Component *component, ncl_ComponentStat *stat) {
 		size_t sectorCount = drv->conf.capacity / drv->conf.sectorSize;
 		if(maxWrite > 0 && sectorCount > 0) wearlevel = drv->writeCount * 100.0 / sectorCount / maxWrite;
 		stat->flash.wearlevel = wearlevel;
+		stat->flash.residentSize = drv->disk.resident * drv->disk.sectorSize;
+		stat->flash.logicalSize = drv->disk.capacity;
 		nn_unlock(drv->ctx, drv->lock);
 		return;
 	}
@@ -3651,9 +4633,946 @@ bool ncl_makeReadonly(nn_Component *component) {
 
 // all of these are encoding states
 
-nn_Exit ncl_encodeComponentState(nn_Universe *universe, nn_Component *comp, ncl_EncodedState *state);
-void ncl_freeEncodedState(nn_Universe *universe, ncl_EncodedState *state);
-nn_Exit ncl_loadComponentState(nn_Component *comp, const ncl_EncodedState *state);
+#define NCL_STATE_MAGIC "NCLS"
+#define NCL_STATE_ENDIAN 0x01020304
+#define NCL_STATE_NULL SIZE_MAX
+// how deeply nested an encoded tmpfs tree can be
+#define NCL_STATE_DEPTH NN_MAX_PATH
+
+typedef struct ncl_StateWriter {
+	nn_Context *ctx;
+	char *buf;
+	size_t len;
+	size_t cap;
+	nn_Exit err;
+} ncl_StateWriter;
+
+// reserves [len] bytes, returning NULL if it ran out of memory
+static char *ncl_stateReserve(ncl_StateWriter *w, size_t len) {
+	if(w->err) return NULL;
+	if(w->len + len > w->cap) {
+		size_t newCap = w->cap == 0 ? 256 : w->cap;
+		while(newCap < w->len + len) newCap *= 2;
+		char *newBuf = nn_realloc(w->ctx, w->buf, w->cap, newCap);
+		if(newBuf == NULL) {
+			w->err = NN_ENOMEM;
+			return NULL;
+		}
+		w->buf = newBuf;
+		w->cap = newCap;
+	}
+	char *p = w->buf + w->len;
+	w->len += len;
+	return p;
+}
+
+static void ncl_stateBytes(ncl_StateWriter *w, const void *data, size_t len) {
+	if(len == 0) return;
+	char *p = ncl_stateReserve(w, len);
+	if(p != NULL) memcpy(p, data, len);
+}
+
+static void ncl_stateSize(ncl_StateWriter *w, size_t n) {
+	ncl_stateBytes(w, &n, sizeof(n));
+}
+
+static void ncl_stateNumber(ncl_StateWriter *w, double n) {
+	ncl_stateBytes(w, &n, sizeof(n));
+}
+
+static void ncl_stateLString(ncl_StateWriter *w, const char *s, size_t len) {
+	if(s == NULL) {
+		ncl_stateSize(w, NCL_STATE_NULL);
+		return;
+	}
+	ncl_stateSize(w, len);
+	ncl_stateBytes(w, s, len);
+}
+
+// shrinks the buffer and hands it over
+static nn_Exit ncl_stateFinish(ncl_StateWriter *w, ncl_EncodedState *state) {
+	if(w->err == NN_OK && w->len < w->cap) {
+		char *buf = nn_realloc(w->ctx, w->buf, w->cap, w->len);
+		if(buf == NULL) w->err = NN_ENOMEM;
+		else w->buf = buf;
+	}
+	if(w->err) {
+		nn_free(w->ctx, w->buf, w->cap);
+		return w->err;
+	}
+	state->buf = w->buf;
+	state->len = w->len;
+	return NN_OK;
+}
+
+typedef struct ncl_StateReader {
+	const char *buf;
+	size_t len;
+	size_t off;
+	bool bad;
+} ncl_StateReader;
+
+// returns NULL if there are not [len] bytes left
+static const char *ncl_stateRead(ncl_StateReader *r, size_t len) {
+	if(r->bad || r->len - r->off < len) {
+		r->bad = true;
+		return NULL;
+	}
+	const char *p = r->buf + r->off;
+	r->off += len;
+	return p;
+}
+
+static size_t ncl_stateReadSize(ncl_StateReader *r) {
+	size_t n = 0;
+	const char *p = ncl_stateRead(r, sizeof(n));
+	if(p != NULL) memcpy(&n, p, sizeof(n));
+	return n;
+}
+
+static double ncl_stateReadNumber(ncl_StateReader *r) {
+	double n = 0;
+	const char *p = ncl_stateRead(r, sizeof(n));
+	if(p != NULL) memcpy(&n, p, sizeof(n));
+	return n;
+}
+
+// the strings are not terminated, *len is set to NCL_STATE_NULL for NULL
+static const char *ncl_stateReadString(ncl_StateReader *r, size_t *len) {
+	*len = ncl_stateReadSize(r);
+	if(*len == NCL_STATE_NULL) return NULL;
+	return ncl_stateRead(r, *len);
+}
+
+// NN_OK if everything was read, and nothing more
+static nn_Exit ncl_stateCheck(ncl_StateReader *r) {
+	if(r->bad || r->off != r->len) return NN_EBADCALL;
+	return NN_OK;
+}
+
+static bool ncl_wantUnit(const char *data, size_t size, size_t unit, const unsigned char *dirty, bool skipZero, size_t i) {
+	if(dirty != NULL && !ncl_isDirty(dirty, i)) return false;
+	if(!skipZero) return true;
+	size_t off = i * unit;
+	size_t len = size - off < unit ? size - off : unit;
+	return !ncl_isZero(data + off, len);
+}
+
+// Writes data as runs of (first unit, unit count, bytes), ended by an empty run.
+// If dirty is NULL, every unit is written, otherwise only the dirty ones.
+// skipZero leaves out the units which are entirely 0.
+static void ncl_stateRuns(ncl_StateWriter *w, const char *data, size_t size, size_t unit, const unsigned char *dirty, bool skipZero) {
+	size_t count = ncl_sectorCount(size, unit);
+	size_t i = 0;
+	while(i < count) {
+		if(!ncl_wantUnit(data, size, unit, dirty, skipZero, i)) {
+			i++;
+			continue;
+		}
+		size_t start = i;
+		while(i < count && ncl_wantUnit(data, size, unit, dirty, skipZero, i)) i++;
+		size_t off = start * unit;
+		size_t end = i * unit;
+		if(end > size) end = size;
+		ncl_stateSize(w, start);
+		ncl_stateSize(w, i - start);
+		ncl_stateBytes(w, data + off, end - off);
+	}
+	ncl_stateSize(w, 0);
+	ncl_stateSize(w, 0);
+}
+
+// data is only written to if apply is set, so the runs can be validated first.
+// Returns how many units were loaded. Runs are written in order, so overlapping ones are rejected.
+static size_t ncl_loadRuns(ncl_StateReader *r, char *data, size_t size, size_t unit, bool apply) {
+	size_t count = ncl_sectorCount(size, unit);
+	size_t next = 0;
+	size_t loaded = 0;
+	while(!r->bad) {
+		size_t start = ncl_stateReadSize(r);
+		size_t n = ncl_stateReadSize(r);
+		if(n == 0) return loaded;
+		if(start < next || start >= count || n > count - start) {
+			r->bad = true;
+			return loaded;
+		}
+		next = start + n;
+		loaded += n;
+		size_t off = start * unit;
+		size_t end = (start + n) * unit;
+		if(end > size) end = size;
+		const char *bytes = ncl_stateRead(r, end - off);
+		if(bytes != NULL && apply) memcpy(data + off, bytes, end - off);
+	}
+	return loaded;
+}
+
+static bool ncl_wantSector(const ncl_Disk *disk, bool delta, size_t i) {
+	if(delta) return ncl_isDirty(disk->dirty, i);
+	return !ncl_diskIsZero(disk, i);
+}
+
+// Like ncl_stateRuns, but over the sectors of a disk.
+// Full encodings skip the zero sectors, deltas only have the dirty ones.
+static void ncl_stateDiskRuns(ncl_StateWriter *w, const ncl_Disk *disk, bool delta) {
+	size_t count = disk->sectorCount;
+	size_t i = 0;
+	while(i < count) {
+		if(!ncl_wantSector(disk, delta, i)) {
+			i++;
+			continue;
+		}
+		size_t start = i;
+		while(i < count && ncl_wantSector(disk, delta, i)) i++;
+		size_t off = start * disk->sectorSize;
+		size_t end = i * disk->sectorSize;
+		if(end > disk->capacity) end = disk->capacity;
+		ncl_stateSize(w, start);
+		ncl_stateSize(w, i - start);
+		char *bytes = ncl_stateReserve(w, end - off);
+		if(bytes != NULL) ncl_diskRead(disk, off, bytes, end - off);
+	}
+	ncl_stateSize(w, 0);
+	ncl_stateSize(w, 0);
+}
+
+// Sets sector i to bytes, or zeros if NULL.
+// Sectors which end up matching the image drop their private copy, so loading
+// a state into a drive made from the same image keeps it shared.
+static nn_Exit ncl_diskStore(nn_Context *ctx, ncl_Disk *disk, size_t i, const char *bytes) {
+	size_t off = i * disk->sectorSize;
+	size_t len = ncl_diskSectorBytes(disk, i);
+	if(bytes == NULL || ncl_isZero(bytes, len)) {
+		ncl_diskZeroSector(ctx, disk, i);
+		return NN_OK;
+	}
+	size_t fromImage = ncl_diskImageBytes(disk, off, len);
+	if(fromImage > 0 && memcmp(disk->base + off, bytes, fromImage) == 0 && ncl_isZero(bytes + fromImage, len - fromImage)) {
+		if(ncl_diskIsPrivate(disk, i)) {
+			nn_free(ctx, disk->sectors[i], disk->sectorSize);
+			disk->resident--;
+		}
+		disk->sectors[i] = NULL;
+		return NN_OK;
+	}
+	char *sector = ncl_diskSector(ctx, disk, i);
+	if(sector == NULL) return NN_ENOMEM;
+	memcpy(sector, bytes, len);
+	return NN_OK;
+}
+
+// Reads the runs of ncl_stateDiskRuns, which must be in ascending order.
+// A full encoding zeroes the sectors it leaves out.
+// The disk is only written to if apply is set, so the runs can be validated first.
+static nn_Exit ncl_loadDiskRuns(ncl_StateReader *r, nn_Context *ctx, ncl_Disk *disk, bool delta, bool apply) {
+	size_t count = disk->sectorCount;
+	size_t next = 0;
+	while(!r->bad) {
+		size_t start = ncl_stateReadSize(r);
+		size_t n = ncl_stateReadSize(r);
+		if(n == 0) break;
+		if(start < next || start >= count || n > count - start) {
+			r->bad = true;
+			break;
+		}
+		size_t off = start * disk->sectorSize;
+		size_t end = (start + n) * disk->sectorSize;
+		if(end > disk->capacity) end = disk->capacity;
+		const char *bytes = ncl_stateRead(r, end - off);
+		if(bytes == NULL || !apply) {
+			next = start + n;
+			continue;
+		}
+		for(; !delta && next < start; next++) {
+			if(ncl_diskStore(ctx, disk, next, NULL)) return NN_ENOMEM;
+		}
+		for(size_t i = 0; i < n; i++) {
+			if(ncl_diskStore(ctx, disk, start + i, bytes + i * disk->sectorSize)) return NN_ENOMEM;
+		}
+		next = start + n;
+	}
+	if(r->bad) return NN_EBADCALL;
+	for(; apply && !delta && next < count; next++) {
+		if(ncl_diskStore(ctx, disk, next, NULL)) return NN_ENOMEM;
+	}
+	return NN_OK;
+}
+
+static void ncl_stateHeader(ncl_StateWriter *w, const char *type, bool delta) {
+	ncl_stateBytes(w, NCL_STATE_MAGIC, 4);
+	ncl_stateSize(w, NCL_STATE_VERSION);
+	ncl_stateSize(w, NCL_STATE_ENDIAN);
+	ncl_stateSize(w, delta);
+	ncl_stateLString(w, type, strlen(type));
+}
+
+static bool ncl_loadHeader(ncl_StateReader *r, const char *type, bool *delta) {
+	const char *magic = ncl_stateRead(r, 4);
+	if(magic == NULL || memcmp(magic, NCL_STATE_MAGIC, 4) != 0) return false;
+	if(ncl_stateReadSize(r) != NCL_STATE_VERSION) return false;
+	if(ncl_stateReadSize(r) != NCL_STATE_ENDIAN) return false;
+	size_t mode = ncl_stateReadSize(r);
+	size_t len;
+	const char *encodedType = ncl_stateReadString(r, &len);
+	if(r->bad || mode > 1 || encodedType == NULL) return false;
+	if(len != strlen(type) || memcmp(encodedType, type, len) != 0) return false;
+	*delta = mode;
+	return true;
+}
+
+static void ncl_encodeEEPROM(ncl_StateWriter *w, ncl_EEState *ee) {
+	ncl_stateSize(w, ee->isReadonly);
+	ncl_stateLString(w, ee->code, ee->codelen);
+	ncl_stateLString(w, ee->data, ee->datalen);
+	ncl_stateLString(w, ee->label, ee->labellen);
+	ncl_stateLString(w, ee->archname, ee->archlen);
+}
+
+static nn_Exit ncl_loadEEPROM(ncl_StateReader *r, ncl_EEState *ee, bool apply) {
+	bool isReadonly = ncl_stateReadSize(r);
+	size_t codelen, datalen, labellen, archlen;
+	const char *code = ncl_stateReadString(r, &codelen);
+	const char *data = ncl_stateReadString(r, &datalen);
+	const char *label = ncl_stateReadString(r, &labellen);
+	const char *arch = ncl_stateReadString(r, &archlen);
+	if(codelen > ee->conf.size || datalen > ee->conf.dataSize) r->bad = true;
+	if(labellen > NN_MAX_LABEL || archlen > NN_MAX_ARCHNAME) r->bad = true;
+	if(ncl_stateCheck(r)) return NN_EBADCALL;
+	if(!apply) return NN_OK;
+	ee->isReadonly = isReadonly;
+	memcpy(ee->code, code, codelen);
+	ee->codelen = codelen;
+	memcpy(ee->data, data, datalen);
+	ee->datalen = datalen;
+	memcpy(ee->label, label, labellen);
+	ee->labellen = labellen;
+	memcpy(ee->archname, arch, archlen);
+	ee->archlen = archlen;
+	return NN_OK;
+}
+
+// the files themselves live in the VFS
+static void ncl_encodeFS(ncl_StateWriter *w, ncl_FSState *fs) {
+	ncl_stateSize(w, fs->isReadonly);
+	ncl_stateLString(w, fs->label, fs->labellen);
+}
+
+static nn_Exit ncl_loadFS(ncl_StateReader *r, ncl_FSState *fs, bool apply) {
+	bool isReadonly = ncl_stateReadSize(r);
+	size_t labellen;
+	const char *label = ncl_stateReadString(r, &labellen);
+	if(labellen > NN_MAX_LABEL) r->bad = true;
+	if(ncl_stateCheck(r)) return NN_EBADCALL;
+	if(!apply) return NN_OK;
+	fs->isReadonly = isReadonly;
+	memcpy(fs->label, label, labellen);
+	fs->labellen = labellen;
+	fs->spaceUsed = 0;
+	fs->realSpaceUsed = 0;
+	return NN_OK;
+}
+
+static void ncl_encodeDrive(ncl_StateWriter *w, ncl_DriveState *drv, bool delta) {
+	ncl_stateSize(w, drv->conf.capacity);
+	ncl_stateSize(w, drv->conf.sectorSize);
+	ncl_stateSize(w, drv->isReadonly);
+	ncl_stateLString(w, drv->label, drv->labellen);
+	ncl_stateSize(w, drv->lastSector);
+	ncl_stateDiskRuns(w, &drv->disk, delta);
+}
+
+static nn_Exit ncl_loadDrive(ncl_StateReader *r, ncl_DriveState *drv, bool delta, bool apply) {
+	size_t capacity = ncl_stateReadSize(r);
+	size_t sectorSize = ncl_stateReadSize(r);
+	bool isReadonly = ncl_stateReadSize(r);
+	size_t labellen;
+	const char *label = ncl_stateReadString(r, &labellen);
+	size_t lastSector = ncl_stateReadSize(r);
+	if(capacity != drv->conf.capacity || sectorSize != drv->conf.sectorSize) r->bad = true;
+	if(labellen > NN_MAX_LABEL) r->bad = true;
+	if(lastSector < 1 || lastSector > ncl_sectorCount(capacity, sectorSize)) r->bad = true;
+	if(r->bad) return NN_EBADCALL;
+	nn_Exit e = ncl_loadDiskRuns(r, drv->ctx, &drv->disk, delta, apply);
+	if(e) return e;
+	if(ncl_stateCheck(r)) return NN_EBADCALL;
+	if(!apply) return NN_OK;
+	drv->isReadonly = isReadonly;
+	memcpy(drv->label, label, labellen);
+	drv->labellen = labellen;
+	drv->lastSector = lastSector;
+	return NN_OK;
+}
+
+static void ncl_encodeFlash(ncl_StateWriter *w, ncl_FlashState *drv, bool delta) {
+	ncl_stateSize(w, drv->conf.capacity);
+	ncl_stateSize(w, drv->conf.sectorSize);
+	ncl_stateSize(w, drv->isReadonly);
+	ncl_stateLString(w, drv->label, drv->labellen);
+	ncl_stateSize(w, drv->writeCount);
+	ncl_stateDiskRuns(w, &drv->disk, delta);
+}
+
+static nn_Exit ncl_loadFlash(ncl_StateReader *r, ncl_FlashState *drv, bool delta, bool apply) {
+	size_t capacity = ncl_stateReadSize(r);
+	size_t sectorSize = ncl_stateReadSize(r);
+	bool isReadonly = ncl_stateReadSize(r);
+	size_t labellen;
+	const char *label = ncl_stateReadString(r, &labellen);
+	size_t writeCount = ncl_stateReadSize(r);
+	if(capacity != drv->conf.capacity || sectorSize != drv->conf.sectorSize) r->bad = true;
+	if(labellen > NN_MAX_LABEL) r->bad = true;
+	if(r->bad) return NN_EBADCALL;
+	nn_Exit e = ncl_loadDiskRuns(r, drv->ctx, &drv->disk, delta, apply);
+	if(e) return e;
+	if(ncl_stateCheck(r)) return NN_EBADCALL;
+	if(!apply) return NN_OK;
+	drv->isReadonly = isReadonly;
+	memcpy(drv->label, label, labellen);
+	drv->labellen = labellen;
+	drv->writeCount = writeCount;
+	return NN_OK;
+}
+
+static void ncl_encodeScreen(ncl_StateWriter *w, ncl_ScreenState *scr, bool delta) {
+	size_t rowSize = sizeof(ncl_ScreenPixel) * scr->conf.maxWidth;
+	ncl_stateSize(w, scr->conf.maxWidth);
+	ncl_stateSize(w, scr->conf.maxHeight);
+	ncl_stateSize(w, scr->conf.paletteColors);
+	ncl_stateSize(w, scr->width);
+	ncl_stateSize(w, scr->height);
+	ncl_stateSize(w, scr->viewportWidth);
+	ncl_stateSize(w, scr->viewportHeight);
+	ncl_stateSize(w, scr->depth);
+	ncl_stateSize(w, scr->flags);
+	ncl_stateNumber(w, scr->brightness);
+	ncl_stateBytes(w, scr->palette, sizeof(int) * scr->conf.paletteColors);
+	ncl_stateRuns(w, (const char *)scr->pixels, rowSize * scr->conf.maxHeight, rowSize, delta ? scr->dirtyRows : NULL, false);
+}
+
+// palette indexes are not trusted
+static void ncl_sanitizeScreen(ncl_ScreenState *scr) {
+	size_t count = (size_t)scr->conf.maxWidth * scr->conf.maxHeight;
+	for(size_t i = 0; i < count; i++) {
+		ncl_ScreenPixel *p = &scr->pixels[i];
+		if(p->realFg < 0 && (p->storedFg < 0 || p->storedFg >= scr->conf.paletteColors)) {
+			p->storedFg = 0xFFFFFF;
+			p->realFg = 0xFFFFFF;
+		}
+		if(p->realBg < 0 && (p->storedBg < 0 || p->storedBg >= scr->conf.paletteColors)) {
+			p->storedBg = 0x000000;
+			p->realBg = 0x000000;
+		}
+	}
+}
+
+static nn_Exit ncl_loadScreen(ncl_StateReader *r, ncl_ScreenState *scr, bool delta, bool apply) {
+	size_t maxWidth = ncl_stateReadSize(r);
+	size_t maxHeight = ncl_stateReadSize(r);
+	size_t paletteColors = ncl_stateReadSize(r);
+	size_t width = ncl_stateReadSize(r);
+	size_t height = ncl_stateReadSize(r);
+	size_t viewportWidth = ncl_stateReadSize(r);
+	size_t viewportHeight = ncl_stateReadSize(r);
+	size_t depth = ncl_stateReadSize(r);
+	size_t flags = ncl_stateReadSize(r);
+	double brightness = ncl_stateReadNumber(r);
+	if(r->bad || paletteColors != (size_t)scr->conf.paletteColors) return NN_EBADCALL;
+	const char *palette = ncl_stateRead(r, sizeof(int) * paletteColors);
+	if(r->bad) return NN_EBADCALL;
+
+	// resizing marks every row dirty, so the delta after it has all of them, checked below
+	bool resized = maxWidth != (size_t)scr->conf.maxWidth || maxHeight != (size_t)scr->conf.maxHeight;
+	if(maxWidth == 0 || maxHeight == 0 || maxWidth > INT_MAX || maxHeight > INT_MAX) return NN_EBADCALL;
+	size_t rowSize = sizeof(ncl_ScreenPixel) * maxWidth;
+	if(maxWidth > SIZE_MAX / sizeof(ncl_ScreenPixel)) return NN_EBADCALL;
+	// a full encoding, or a resized delta, has every row, so this stops absurd allocations
+	if(resized && maxHeight > (r->len - r->off) / rowSize) return NN_EBADCALL;
+	if(width > maxWidth || height > maxHeight) return NN_EBADCALL;
+	if(viewportWidth > maxWidth || viewportHeight > maxHeight) return NN_EBADCALL;
+	if(nn_depthName(depth) == NULL || depth > (size_t)scr->conf.maxDepth) return NN_EBADCALL;
+	if(flags & ~(size_t)(NCL_SCREEN_ON | NCL_SCREEN_PRECISE | NCL_SCREEN_TOUCHINVERTED)) return NN_EBADCALL;
+
+	if(apply && resized) {
+		nn_Exit e = ncl_setScreenMaxResolution(scr, maxWidth, maxHeight);
+		if(e) return e;
+	}
+	size_t rows = ncl_loadRuns(r, (char *)scr->pixels, rowSize * maxHeight, rowSize, apply);
+	// the old rows do not fit the new layout
+	if(resized && rows != maxHeight) r->bad = true;
+	if(ncl_stateCheck(r)) return NN_EBADCALL;
+	if(!apply) return NN_OK;
+	scr->width = width;
+	scr->height = height;
+	scr->viewportWidth = viewportWidth;
+	scr->viewportHeight = viewportHeight;
+	scr->depth = depth;
+	scr->flags = flags;
+	scr->brightness = brightness;
+	memcpy(scr->palette, palette, sizeof(int) * paletteColors);
+	ncl_sanitizeScreen(scr);
+	ncl_recomputeScreen(scr);
+	return NN_OK;
+}
+
+static void ncl_encodeGPU(ncl_StateWriter *w, ncl_GPUState *gpu, bool delta) {
+	ncl_stateNumber(w, gpu->currentFg);
+	ncl_stateNumber(w, gpu->currentBg);
+	ncl_stateSize(w, gpu->isFgPalette);
+	ncl_stateSize(w, gpu->isBgPalette);
+	ncl_stateSize(w, gpu->activeBuffer);
+	const char *screen = gpu->screenAddress;
+	ncl_stateLString(w, screen, screen == NULL ? 0 : strlen(screen));
+	for(size_t i = 1; i < NCL_MAX_VRAMBUF; i++) {
+		ncl_VRAMBuf *buf = gpu->vram[i];
+		if(buf == NULL) continue;
+		bool withPixels = !delta || buf->dirty;
+		ncl_stateSize(w, i);
+		ncl_stateSize(w, buf->width);
+		ncl_stateSize(w, buf->height);
+		ncl_stateSize(w, withPixels);
+		if(withPixels) ncl_stateBytes(w, buf->pixels, sizeof(ncl_ScreenPixel) * buf->width * buf->height);
+	}
+	ncl_stateSize(w, 0);
+}
+
+// builds the new set of buffers before replacing the old one, so failing leaves the GPU untouched
+static nn_Exit ncl_loadGPU(ncl_StateReader *r, ncl_GPUState *gpu, bool delta) {
+	nn_Context *ctx = gpu->ctx;
+	ncl_VRAMBuf *vram[NCL_MAX_VRAMBUF] = {NULL};
+	bool loaded[NCL_MAX_VRAMBUF] = {false};
+	char *screenAddress = NULL;
+	size_t used = 0;
+	nn_Exit e = NN_EBADCALL;
+
+	double fg = ncl_stateReadNumber(r);
+	double bg = ncl_stateReadNumber(r);
+	bool isFgPalette = ncl_stateReadSize(r);
+	bool isBgPalette = ncl_stateReadSize(r);
+	size_t activeBuffer = ncl_stateReadSize(r);
+	size_t screenlen;
+	const char *screen = ncl_stateReadString(r, &screenlen);
+	if(r->bad) goto fail;
+	if(screen != NULL && (screenlen >= NN_MAX_ADDRESS || memchr(screen, '\0', screenlen) != NULL)) goto fail;
+
+	while(true) {
+		size_t idx = ncl_stateReadSize(r);
+		if(r->bad) goto fail;
+		if(idx == 0) break;
+		size_t width = ncl_stateReadSize(r);
+		size_t height = ncl_stateReadSize(r);
+		bool withPixels = ncl_stateReadSize(r);
+		if(r->bad || idx >= NCL_MAX_VRAMBUF || vram[idx] != NULL) goto fail;
+		size_t vramLeft = gpu->conf.totalVRAM - used;
+		if(width == 0 || height == 0 || width > vramLeft || height > vramLeft / width) goto fail;
+		used += width * height;
+		if(!withPixels) {
+			ncl_VRAMBuf *old = gpu->vram[idx];
+			if(!delta || old == NULL || (size_t)old->width != width || (size_t)old->height != height) goto fail;
+			vram[idx] = old;
+			continue;
+		}
+		const char *pixels = ncl_stateRead(r, sizeof(ncl_ScreenPixel) * width * height);
+		if(pixels == NULL) goto fail;
+		vram[idx] = ncl_allocVRAM(ctx, width, height);
+		if(vram[idx] == NULL) {
+			e = NN_ENOMEM;
+			goto fail;
+		}
+		loaded[idx] = true;
+		memcpy(vram[idx]->pixels, pixels, sizeof(ncl_ScreenPixel) * width * height);
+	}
+	if(ncl_stateCheck(r)) goto fail;
+	if(activeBuffer >= NCL_MAX_VRAMBUF || (activeBuffer != 0 && vram[activeBuffer] == NULL)) goto fail;
+	if(screen != NULL) {
+		screenAddress = nn_alloc(ctx, screenlen + 1);
+		if(screenAddress == NULL) {
+			e = NN_ENOMEM;
+			goto fail;
+		}
+		memcpy(screenAddress, screen, screenlen);
+		screenAddress[screenlen] = '\0';
+	}
+
+	for(size_t i = 1; i < NCL_MAX_VRAMBUF; i++) {
+		if(gpu->vram[i] != NULL && gpu->vram[i] != vram[i]) ncl_freeVRAM(ctx, gpu->vram[i]);
+		gpu->vram[i] = vram[i];
+		if(vram[i] != NULL) vram[i]->dirty = false;
+	}
+	if(gpu->screenAddress != NULL) nn_strfree(ctx, gpu->screenAddress);
+	gpu->screenAddress = screenAddress;
+	gpu->screenHash = screenAddress == NULL ? 0 : nn_strhash(screenAddress);
+	gpu->vramFree = gpu->conf.totalVRAM - used;
+	gpu->currentFg = fg;
+	gpu->currentBg = bg;
+	gpu->isFgPalette = isFgPalette;
+	gpu->isBgPalette = isBgPalette;
+	gpu->activeBuffer = activeBuffer;
+	return NN_OK;
+fail:
+	for(size_t i = 1; i < NCL_MAX_VRAMBUF; i++) {
+		if(loaded[i]) ncl_freeVRAM(ctx, vram[i]);
+	}
+	return e;
+}
+
+static void ncl_encodeTmpFile(ncl_StateWriter *w, ncl_TmpFile *f, bool delta) {
+	ncl_stateSize(w, f->inode);
+	ncl_stateSize(w, f->isFile);
+	ncl_stateLString(w, f->name, strlen(f->name));
+	if(f->isFile) {
+		bool withData = !delta || f->dirty;
+		ncl_stateSize(w, withData);
+		if(withData) {
+			ncl_stateSize(w, f->datalen);
+			ncl_stateBytes(w, f->data, f->datalen);
+		}
+		return;
+	}
+	size_t count = 0;
+	for(ncl_TmpFile *iter = f->files; iter != NULL; iter = iter->next) count++;
+	ncl_stateSize(w, count);
+	for(ncl_TmpFile *iter = f->files; iter != NULL; iter = iter->next) {
+		ncl_encodeTmpFile(w, iter, delta);
+	}
+}
+
+static void ncl_cleanTmpFile(ncl_TmpFile *f) {
+	f->dirty = false;
+	if(f->isFile) return;
+	for(ncl_TmpFile *iter = f->files; iter != NULL; iter = iter->next) {
+		ncl_cleanTmpFile(iter);
+	}
+}
+
+static ncl_TmpFile *ncl_tmpFind(ncl_TmpFile *f, size_t inode) {
+	if(f->inode == inode) return f;
+	if(f->isFile) return NULL;
+	for(ncl_TmpFile *iter = f->files; iter != NULL; iter = iter->next) {
+		ncl_TmpFile *found = ncl_tmpFind(iter, inode);
+		if(found != NULL) return found;
+	}
+	return NULL;
+}
+
+static size_t ncl_tmpMaxInode(ncl_TmpFile *f) {
+	size_t inode = f->inode;
+	if(f->isFile) return inode;
+	for(ncl_TmpFile *iter = f->files; iter != NULL; iter = iter->next) {
+		size_t sub = ncl_tmpMaxInode(iter);
+		if(sub > inode) inode = sub;
+	}
+	return inode;
+}
+
+static void ncl_encodeTmpFS(ncl_StateWriter *w, ncl_TmpFS *fs, bool delta) {
+	ncl_stateSize(w, fs->isReadonly);
+	ncl_stateLString(w, fs->label, fs->labellen);
+	ncl_stateSize(w, fs->nextInode);
+	ncl_encodeTmpFile(w, fs->root, delta);
+	for(size_t i = 0; i < NN_MAX_OPENFILES; i++) {
+		ncl_TmpFildes *fildes = &fs->fds[i];
+		if(fildes->file == NULL) {
+			ncl_stateSize(w, 0);
+			continue;
+		}
+		ncl_stateSize(w, fildes->file->inode);
+		ncl_stateSize(w, fildes->mode);
+		if(fildes->file->isFile) {
+			ncl_stateSize(w, fildes->offset);
+		} else {
+			ncl_stateSize(w, fildes->curEnt == NULL ? 0 : fildes->curEnt->inode);
+		}
+	}
+}
+
+// Unchanged files are copied from the old tree, not moved,
+// so the old tree is left intact if the encoding turns out to be corrupted.
+static nn_Exit ncl_loadTmpFile(ncl_StateReader *r, ncl_TmpFS *fs, bool delta, size_t depth, ncl_TmpFile **out) {
+	size_t inode = ncl_stateReadSize(r);
+	bool isFile = ncl_stateReadSize(r);
+	size_t namelen;
+	const char *name = ncl_stateReadString(r, &namelen);
+	if(r->bad || name == NULL || inode == 0 || depth > NCL_STATE_DEPTH) return NN_EBADCALL;
+	if(namelen >= NN_MAX_PATH || (namelen == 0) != (depth == 0)) return NN_EBADCALL;
+	if(memchr(name, '/', namelen) != NULL || memchr(name, '\0', namelen) != NULL) return NN_EBADCALL;
+	char namebuf[NN_MAX_PATH];
+	memcpy(namebuf, name, namelen);
+	namebuf[namelen] = '\0';
+
+	ncl_TmpFile *f = ncl_tmpAllocFile(fs, namebuf, isFile);
+	if(f == NULL) return NN_ENOMEM;
+	f->inode = inode;
+	f->dirty = false;
+	nn_Exit e = NN_EBADCALL;
+	if(isFile) {
+		const char *data = NULL;
+		size_t datalen = 0;
+		if(ncl_stateReadSize(r)) {
+			datalen = ncl_stateReadSize(r);
+			data = ncl_stateRead(r, datalen);
+		} else {
+			ncl_TmpFile *old = ncl_tmpFind(fs->root, inode);
+			if(!delta || old == NULL || !old->isFile) goto fail;
+			data = old->data;
+			datalen = old->datalen;
+		}
+		if(r->bad) goto fail;
+		if(datalen > 0) {
+			f->data = nn_alloc(fs->ctx, datalen);
+			if(f->data == NULL) {
+				e = NN_ENOMEM;
+				goto fail;
+			}
+			memcpy(f->data, data, datalen);
+			f->datalen = datalen;
+			f->datacap = datalen;
+		}
+		*out = f;
+		return NN_OK;
+	}
+	size_t count = ncl_stateReadSize(r);
+	ncl_TmpFile **tail = &f->files;
+	for(size_t i = 0; i < count && !r->bad; i++) {
+		ncl_TmpFile *child;
+		e = ncl_loadTmpFile(r, fs, delta, depth + 1, &child);
+		if(e) goto fail;
+		child->parent = f;
+		*tail = child;
+		tail = &child->next;
+	}
+	if(r->bad) goto fail;
+	*out = f;
+	return NN_OK;
+fail:
+	ncl_tmpFreeFile(fs->ctx, f);
+	return e;
+}
+
+static nn_Exit ncl_loadTmpFS(ncl_StateReader *r, ncl_TmpFS *fs, bool delta) {
+	bool isReadonly = ncl_stateReadSize(r);
+	size_t labellen;
+	const char *label = ncl_stateReadString(r, &labellen);
+	size_t nextInode = ncl_stateReadSize(r);
+	if(r->bad || labellen > NN_MAX_LABEL) return NN_EBADCALL;
+
+	ncl_TmpFile *root;
+	nn_Exit e = ncl_loadTmpFile(r, fs, delta, 0, &root);
+	if(e) return e;
+	e = NN_EBADCALL;
+	if(root->isFile) goto fail;
+
+	ncl_TmpFildes fds[NN_MAX_OPENFILES];
+	for(size_t i = 0; i < NN_MAX_OPENFILES; i++) {
+		fds[i].file = NULL;
+		size_t inode = ncl_stateReadSize(r);
+		if(inode == 0) continue;
+		size_t mode = ncl_stateReadSize(r);
+		size_t pos = ncl_stateReadSize(r);
+		ncl_TmpFile *f = ncl_tmpFind(root, inode);
+		if(r->bad || f == NULL) goto fail;
+		if(f->isFile) {
+			if(mode != 'r' && mode != 'w' && mode != 'a') goto fail;
+			fds[i].offset = pos > f->datalen ? f->datalen : pos;
+		} else {
+			if(mode != 'r') goto fail;
+			fds[i].curEnt = pos == 0 ? NULL : ncl_tmpFind(f, pos);
+			if(pos != 0 && (fds[i].curEnt == NULL || fds[i].curEnt->parent != f)) goto fail;
+		}
+		fds[i].file = f;
+		fds[i].mode = mode;
+	}
+	if(ncl_stateCheck(r)) goto fail;
+
+	for(size_t i = 0; i < NN_MAX_OPENFILES; i++) {
+		if(fds[i].file != NULL) fds[i].file->openHandles++;
+		fs->fds[i] = fds[i];
+	}
+	ncl_tmpFreeFile(fs->ctx, fs->root);
+	fs->root = root;
+	size_t maxInode = ncl_tmpMaxInode(root);
+	fs->nextInode = nextInode > maxInode ? nextInode : maxInode + 1;
+	fs->isReadonly = isReadonly;
+	memcpy(fs->label, label, labellen);
+	fs->labellen = labellen;
+	fs->spaceUsed = 0;
+	return NN_OK;
+fail:
+	ncl_tmpFreeFile(fs->ctx, root);
+	return e;
+}
+
+static nn_Exit ncl_encodeState(nn_Universe *universe, nn_Component *comp, ncl_EncodedState *state, bool delta) {
+	ncl_StateWriter w = {
+		.ctx = nn_getUniverseContext(universe),
+		.buf = NULL,
+		.len = 0,
+		.cap = 0,
+		.err = NN_OK,
+	};
+	const char *ty = nn_getComponentTypeID(comp);
+	void *st = nn_getComponentState(comp);
+	nn_Exit e;
+	ncl_stateHeader(&w, ty, delta);
+	if(strcmp(ty, NCL_EEPROM) == 0) {
+		ncl_EEState *ee = st;
+		nn_lock(ee->ctx, ee->lock);
+		ncl_encodeEEPROM(&w, ee);
+		e = ncl_stateFinish(&w, state);
+		nn_unlock(ee->ctx, ee->lock);
+		return e;
+	}
+	if(strcmp(ty, NCL_FS) == 0) {
+		ncl_FSState *fs = st;
+		nn_lock(fs->ctx, fs->lock);
+		ncl_encodeFS(&w, fs);
+		e = ncl_stateFinish(&w, state);
+		nn_unlock(fs->ctx, fs->lock);
+		return e;
+	}
+	if(strcmp(ty, NCL_TMPFS) == 0) {
+		ncl_TmpFS *fs = st;
+		nn_lock(fs->ctx, fs->lock);
+		ncl_encodeTmpFS(&w, fs, delta);
+		e = ncl_stateFinish(&w, state);
+		if(e == NN_OK) ncl_cleanTmpFile(fs->root);
+		nn_unlock(fs->ctx, fs->lock);
+		return e;
+	}
+	if(strcmp(ty, NCL_DRIVE) == 0) {
+		ncl_DriveState *drv = st;
+		nn_lock(drv->ctx, drv->lock);
+		ncl_encodeDrive(&w, drv, delta);
+		e = ncl_stateFinish(&w, state);
+		if(e == NN_OK) memset(drv->disk.dirty, 0, ncl_dirtySize(drv->disk.sectorCount));
+		nn_unlock(drv->ctx, drv->lock);
+		return e;
+	}
+	if(strcmp(ty, NCL_FLASH) == 0) {
+		ncl_FlashState *drv = st;
+		nn_lock(drv->ctx, drv->lock);
+		ncl_encodeFlash(&w, drv, delta);
+		e = ncl_stateFinish(&w, state);
+		if(e == NN_OK) memset(drv->disk.dirty, 0, ncl_dirtySize(drv->disk.sectorCount));
+		nn_unlock(drv->ctx, drv->lock);
+		return e;
+	}
+	if(strcmp(ty, NCL_SCREEN) == 0) {
+		ncl_ScreenState *scr = st;
+		nn_lock(scr->ctx, scr->lock);
+		ncl_encodeScreen(&w, scr, delta);
+		e = ncl_stateFinish(&w, state);
+		if(e == NN_OK) memset(scr->dirtyRows, 0, ncl_dirtySize(scr->conf.maxHeight));
+		nn_unlock(scr->ctx, scr->lock);
+		return e;
+	}
+	if(strcmp(ty, NCL_GPU) == 0) {
+		ncl_GPUState *gpu = st;
+		nn_lock(gpu->ctx, gpu->lock);
+		ncl_encodeGPU(&w, gpu, delta);
+		e = ncl_stateFinish(&w, state);
+		for(size_t i = 1; e == NN_OK && i < NCL_MAX_VRAMBUF; i++) {
+			if(gpu->vram[i] != NULL) gpu->vram[i]->dirty = false;
+		}
+		nn_unlock(gpu->ctx, gpu->lock);
+		return e;
+	}
+	nn_free(w.ctx, w.buf, w.cap);
+	return NN_EBADSTATE;
+}
+
+nn_Exit ncl_encodeComponentState(nn_Universe *universe, nn_Component *comp, ncl_EncodedState *state) {
+	return ncl_encodeState(universe, comp, state, false);
+}
+
+nn_Exit ncl_encodeComponentDelta(nn_Universe *universe, nn_Component *comp, ncl_EncodedState *state) {
+	return ncl_encodeState(universe, comp, state, true);
+}
+
+void ncl_freeEncodedState(nn_Universe *universe, ncl_EncodedState *state) {
+	nn_free(nn_getUniverseContext(universe), state->buf, state->len);
+	state->buf = NULL;
+	state->len = 0;
+}
+
+// The simple states are read twice, once to validate them and once to apply them,
+// and the others are built on the side, so a bad encoding never changes the component.
+nn_Exit ncl_loadComponentState(nn_Component *comp, const ncl_EncodedState *state) {
+	ncl_StateReader r = {
+		.buf = state->buf,
+		.len = state->len,
+		.off = 0,
+		.bad = false,
+	};
+	const char *ty = nn_getComponentTypeID(comp);
+	void *st = nn_getComponentState(comp);
+	bool delta;
+	if(!ncl_loadHeader(&r, ty, &delta)) return NN_EBADCALL;
+	ncl_StateReader check = r;
+	nn_Exit e;
+	if(strcmp(ty, NCL_EEPROM) == 0) {
+		ncl_EEState *ee = st;
+		nn_lock(ee->ctx, ee->lock);
+		e = ncl_loadEEPROM(&check, ee, false);
+		if(e == NN_OK) e = ncl_loadEEPROM(&r, ee, true);
+		ee->usage++;
+		nn_unlock(ee->ctx, ee->lock);
+		return e;
+	}
+	if(strcmp(ty, NCL_FS) == 0) {
+		ncl_FSState *fs = st;
+		nn_lock(fs->ctx, fs->lock);
+		e = ncl_loadFS(&check, fs, false);
+		if(e == NN_OK) e = ncl_loadFS(&r, fs, true);
+		fs->usage++;
+		nn_unlock(fs->ctx, fs->lock);
+		return e;
+	}
+	if(strcmp(ty, NCL_TMPFS) == 0) {
+		ncl_TmpFS *fs = st;
+		nn_lock(fs->ctx, fs->lock);
+		e = ncl_loadTmpFS(&r, fs, delta);
+		fs->usage++;
+		nn_unlock(fs->ctx, fs->lock);
+		return e;
+	}
+	if(strcmp(ty, NCL_DRIVE) == 0) {
+		ncl_DriveState *drv = st;
+		nn_lock(drv->ctx, drv->lock);
+		e = ncl_loadDrive(&check, drv, delta, false);
+		if(e == NN_OK) e = ncl_loadDrive(&r, drv, delta, true);
+		if(e == NN_OK) memset(drv->disk.dirty, 0, ncl_dirtySize(drv->disk.sectorCount));
+		drv->usage++;
+		nn_unlock(drv->ctx, drv->lock);
+		return e;
+	}
+	if(strcmp(ty, NCL_FLASH) == 0) {
+		ncl_FlashState *drv = st;
+		nn_lock(drv->ctx, drv->lock);
+		e = ncl_loadFlash(&check, drv, delta, false);
+		if(e == NN_OK) e = ncl_loadFlash(&r, drv, delta, true);
+		if(e == NN_OK) memset(drv->disk.dirty, 0, ncl_dirtySize(drv->disk.sectorCount));
+		drv->usage++;
+		nn_unlock(drv->ctx, drv->lock);
+		return e;
+	}
+	if(strcmp(ty, NCL_SCREEN) == 0) {
+		ncl_ScreenState *scr = st;
+		nn_lock(scr->ctx, scr->lock);
+		e = ncl_loadScreen(&check, scr, delta, false);
+		if(e == NN_OK) e = ncl_loadScreen(&r, scr, delta, true);
+		if(e == NN_OK) memset(scr->dirtyRows, 0, ncl_dirtySize(scr->conf.maxHeight));
+		nn_unlock(scr->ctx, scr->lock);
+		return e;
+	}
+	if(strcmp(ty, NCL_GPU) == 0) {
+		ncl_GPUState *gpu = st;
+		nn_lock(gpu->ctx, gpu->lock);
+		e = ncl_loadGPU(&r, gpu, delta);
+		nn_unlock(gpu->ctx, gpu->lock);
+		return e;
+	}
+	return NN_EBADSTATE;
+}
 
 size_t ncl_getLabel(nn_Component *c, char buf[NN_MAX_LABEL]) {
 	const char *typeid = nn_getComponentTypeID(c);
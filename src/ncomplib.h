@@ -27,6 +27,8 @@
 
 #define NCL_MAX_VRAMBUF 128
 #define NCL_MAX_KEYBOARD 64
+// how many submitRead and submitWrite requests a drive can have queued, across all computers
+#define NCL_MAX_DRIVEQUEUE 32
 
 // very low-level actions
 // some environment have VFSes so
@@ -182,13 +184,31 @@ bool ncl_mkdirRecursive(ncl_VFS vfs, const char *path);
 
 bool ncl_copyto(ncl_VFS vfs, const char *from, const char *to);
 
+#define NCL_STATE_VERSION 1
+
+// Encoded states are versioned binary images of the data of EEPROMs, filesystems, tmpfs,
+// drives, nandflash, screens and GPUs (including their VRAM buffers), for saving worlds.
+// Like computer snapshots, they use the native sizes and endianness.
+// Keyboards attached to screens, and the files of normal filesystems, are not part of the state.
 typedef struct ncl_EncodedState {
 	char *buf;
 	size_t len;
 } ncl_EncodedState;
 
+// Encodes the whole state into a buffer allocated with the universe's context.
+// Returns NN_EBADSTATE if the component is not one of the above.
 nn_Exit ncl_encodeComponentState(nn_Universe *universe, nn_Component *comp, ncl_EncodedState *state);
+// Like ncl_encodeComponentState, but only encodes what changed since the last encode or load:
+// the sectors written to, the screen rows and VRAM buffers drawn to, and the tmpfs files written to.
+// Small properties, like labels, palettes or the tmpfs directory tree, are always included.
+nn_Exit ncl_encodeComponentDelta(nn_Universe *universe, nn_Component *comp, ncl_EncodedState *state);
 void ncl_freeEncodedState(nn_Universe *universe, ncl_EncodedState *state);
+// Loads a full state, or applies a delta on top of the state the previous encodings were loaded into.
+// Returns NN_EBADCALL, leaving the component untouched, if the state is corrupted or from another
+// kind of component or configuration.
+// A screen delta may change the max resolution, as ncl_setScreenMaxResolution() makes the next delta hold every row.
+// Drives and nandflash copy the loaded sectors which differ from their image, and if that
+// runs out of memory, NN_ENOMEM is returned with the sectors only partially loaded.
 nn_Exit ncl_loadComponentState(nn_Component *comp, const ncl_EncodedState *state);
 
 size_t ncl_getLabel(nn_Component *c, char buf[NN_MAX_LABEL]);
@@ -204,13 +224,48 @@ nn_Component *ncl_createFilesystem(nn_Universe *universe, const char *address, c
 // and tmpfs.
 nn_Component *ncl_createTmpFS(nn_Universe *universe, const char *address, const nn_Filesystem *fs, size_t fileCost, bool isReadonly);
 
+// A read-only, reference counted base image for drives and nandflash.
+// Many drives can share one image, and only the sectors written to get a private copy,
+// so making hundreds of computers from the same OS image costs little memory.
+typedef struct ncl_DiskImage ncl_DiskImage;
+
+// Copies the data into a new image, with a reference count of 1.
+ncl_DiskImage *ncl_createDiskImage(nn_Universe *universe, const char *data, size_t len);
+void ncl_retainDiskImage(ncl_DiskImage *image);
+// Frees the image once nothing references it.
+void ncl_releaseDiskImage(ncl_DiskImage *image);
+
 // this drive has its data in RAM.
-// However, the data is not encoded in its state.
-// Remember to read the entire drive and save it somewhere before dropping it.
+// It is sparse, only the sectors which are written to and not all zeros take up memory.
+// The data is part of its encoded state.
 nn_Component *ncl_createDrive(nn_Universe *universe, const char *address, const nn_Drive *drive, const char *data, size_t len, bool isReadonly);
+// Like ncl_createDrive, but the initial data is the image, which is retained and never modified.
+// The image can be NULL for an empty drive, and data past the capacity is ignored.
+nn_Component *ncl_createDriveFromImage(nn_Universe *universe, const char *address, const nn_Drive *drive, ncl_DiskImage *image, bool isReadonly);
+
+// Writes the changes to file-backed drives back to their files in the background,
+// every interval seconds, on a thread of its own.
+// It must outlive the drives using it.
+// Only supported on POSIX systems, returns NULL elsewhere.
+typedef struct ncl_DiskFlusher ncl_DiskFlusher;
+
+ncl_DiskFlusher *ncl_createDiskFlusher(nn_Universe *universe, double interval);
+void ncl_destroyDiskFlusher(ncl_DiskFlusher *flusher);
+
+// Like ncl_createDrive, but the data is the file at path, which is memory-mapped.
+// The file is created, or grown to the capacity, if needed, but never read up front.
+// Its blocks are reserved, so creation fails if the host disk does not have room for it.
+// The flusher can be NULL, in which case changes only reach the file through the OS,
+// or ncl_syncDrive.
+// If isReadonly is set, the file is opened read-only and is never created, grown or written to.
+// Past its end reads as zeros, and the host's own writes, like ncl_writeDrive, stay in memory.
+// Only supported on POSIX systems, returns NULL elsewhere or if the file cannot be mapped.
+nn_Component *ncl_createDriveFromFile(nn_Universe *universe, const char *address, const nn_Drive *drive, const char *path, ncl_DiskFlusher *flusher, bool isReadonly);
 
 // usable like a drive, but is a nandflash component
 nn_Component *ncl_createFlash(nn_Universe *universe, const char *address, const nn_NandFlash *flash, const char *data, size_t len, bool isReadonly);
+nn_Component *ncl_createFlashFromImage(nn_Universe *universe, const char *address, const nn_NandFlash *flash, ncl_DiskImage *image, bool isReadonly);
+nn_Component *ncl_createFlashFromFile(nn_Universe *universe, const char *address, const nn_NandFlash *flash, const char *path, ncl_DiskFlusher *flusher, bool isReadonly);
 
 // data is stored interally
 nn_Component *ncl_createEEPROM(nn_Universe *universe, const char *address, const nn_EEPROM *eeprom, const char *code, size_t codelen, bool isReadonly);
@@ -269,10 +324,18 @@ typedef struct ncl_ComponentStat {
 		} fs;
 		struct {
 			size_t lastSector;
+			// the memory of the sectors it has its own copy of.
+			// Shared images are not counted.
+			size_t residentSize;
+			// the capacity
+			size_t logicalSize;
 		} drive;
 		struct {
 			size_t currentWriteCount;
 			double wearlevel;
+			// same as for drives
+			size_t residentSize;
+			size_t logicalSize;
 		} flash;
 		struct {
 			size_t vramFree;
@@ -316,11 +379,17 @@ void ncl_setEEPROMArch(nn_Component *component, const char *arch, size_t len);
 size_t ncl_readDrive(nn_Component *component, size_t offset, char *buf, size_t len);
 // Writes to part of a drive.
 // Off is 0-indexed.
-void ncl_writeDrive(nn_Component *component, size_t offset, const char *buf, size_t len);
-// Returns the internal memory buffer with the drive data,
-// and if len is not NULL, will also write the capacity.
-// This is in case you do not want to risk OOM while saving the state.
-char *ncl_getDriveBuffer(nn_Component *component, size_t *len);
+// Returns NN_ENOMEM if a shared sector could not be copied,
+// in which case part of the data may have been written.
+nn_Exit ncl_writeDrive(nn_Component *component, size_t offset, const char *buf, size_t len);
+// Waits until the changes to a file-backed drive are on the host's disk.
+// Does nothing for drives in RAM.
+// Returns whether it was successful or not.
+bool ncl_syncDrive(nn_Component *component);
+// Enables or disables submitRead and submitWrite on a drive, which are disabled by default.
+// Queued requests are served in elevator order, sweeping the head across the platter,
+// and each completes once the drive has seeked to it. Disabling it does not cancel queued requests.
+void ncl_setDriveAsync(nn_Component *component, bool async);
 
 void ncl_lockScreen(ncl_ScreenState *state);
 void ncl_unlockScreen(ncl_ScreenState *state);
@@ -26,6 +26,25 @@ bool nn_decRef(nn_refc_t *refc, size_t n) {
 	(*refc) -= n;
 	return (*refc) == 0;
 }
+
+typedef size_t nn_atomic_t;
+
+static size_t nn_atomicLoad(nn_atomic_t *v) {
+	return *v;
+}
+
+static void nn_atomicStore(nn_atomic_t *v, size_t n) {
+	*v = n;
+}
+
+static bool nn_atomicCAS(nn_atomic_t *v, size_t *expected, size_t desired) {
+	if(*v != *expected) {
+		*expected = *v;
+		return false;
+	}
+	*v = desired;
+	return true;
+}
 #elif defined(NN_ATOMIC_MSVC)
 // MSVC lacks C11 <stdatomic.h> in C mode, but has interlocked intrinsics.
 // _InterlockedExchangeAdd operates on long (32-bit),
@@ -52,6 +71,34 @@ bool nn_decRef(nn_refc_t *refc, size_t n) {
     return (size_t)old == n;
 #endif
 }
+
+typedef volatile size_t nn_atomic_t;
+
+static bool nn_atomicCAS(nn_atomic_t *v, size_t *expected, size_t desired) {
+#if defined(_WIN64)
+    size_t old = (size_t)_InterlockedCompareExchange64((__int64 volatile *)v, (__int64)desired, (__int64)*expected);
+#else
+    size_t old = (size_t)_InterlockedCompareExchange((long volatile *)v, (long)desired, (long)*expected);
+#endif
+    if(old == *expected) return true;
+    *expected = old;
+    return false;
+}
+
+static size_t nn_atomicLoad(nn_atomic_t *v) {
+    // a CAS which never succeeds, but is a full barrier
+    size_t n = 0;
+    nn_atomicCAS(v, &n, 0);
+    return n;
+}
+
+static void nn_atomicStore(nn_atomic_t *v, size_t n) {
+#if defined(_WIN64)
+    _InterlockedExchange64((__int64 volatile *)v, (__int64)n);
+#else
+    _InterlockedExchange((long volatile *)v, (long)n);
+#endif
+}
 #else
 // we need atomics for thread-safe reference counting that will be used
 // for managing the lifetimes of various resources
@@ -68,6 +115,20 @@ bool nn_decRef(nn_refc_t *refc, size_t n) {
 	nn_refc_t old = atomic_fetch_sub(refc, n);
 	return old == n;
 }
+
+typedef atomic_size_t nn_atomic_t;
+
+static size_t nn_atomicLoad(nn_atomic_t *v) {
+	return atomic_load(v);
+}
+
+static void nn_atomicStore(nn_atomic_t *v, size_t n) {
+	atomic_store(v, n);
+}
+
+static bool nn_atomicCAS(nn_atomic_t *v, size_t *expected, size_t desired) {
+	return atomic_compare_exchange_strong(v, expected, desired);
+}
 #endif
 
 // the special includes
@@ -202,6 +263,11 @@ void *nn_aralloc(nn_Arena *arena, size_t size) {
 	return newBlock->memory;
 }
 
+// frees everything allocated from the arena at once, but keeps the blocks around
+void nn_arreset(nn_Arena *arena) {
+	for(nn_ArenaBlock *b = arena->block; b != NULL; b = b->next) b->used = 0;
+}
+
 size_t nn_strlen(const char *s) {
 	size_t l = 0;
 	while(*(s++) != '\0') l++;
@@ -728,25 +794,17 @@ typedef enum nn_HashEntryState {
 	NN_HASH_EQUAL,
 	// different, ignore
 	NN_HASH_DIFFERENT,
-	// The slot was removed.
-	NN_HASH_REMOVED,
-	// Free but not equal.
-	NN_HASH_FREE,
 } nn_HashEntryState;
 
 typedef enum nn_HashAction {
-	// init to free
-	NN_HASH_INIT,
 	NN_HASH_HASH,
-	NN_HASH_REMOVE,
 	// checks if slot is equal to entry
 	NN_HASH_CMP,
 } nn_HashAction;
 
 // slot is the memory in the hashmap.
-// for NN_HASH_CMP, entry is the key, and may be NULL if we are only trying to get the state of a slot for iteration.
-// if entry is NULL, NN_HASH_EQUAL is invalid and NN_HASH_DIFFERENT means it is used up.
-// for NN_HASH_CMP, a HashEntryState should be returned.
+// for NN_HASH_HASH, the hash of the key in slot should be returned.
+// for NN_HASH_CMP, entry is the key, and a HashEntryState should be returned.
 typedef size_t (nn_HashHandler)(nn_HashAction action, void *slot, void *entry);
 
 typedef struct nn_HashContext {
@@ -754,104 +812,209 @@ typedef struct nn_HashContext {
 	nn_HashHandler *handler;
 } nn_HashContext;
 
-// not a dynamic hashmap, has a fixed capacity.
-// This is because every hashmap we care about has a known maximum capacity that is equal to the length
-// and thus we literally do not care
+// control bytes, anything else is the low 7 bits of the hash of a used slot
+#define NN_HASH_CTRL_EMPTY 0x80
+#define NN_HASH_CTRL_DELETED 0xFE
+// capacities are powers of 2, and never go below this
+#define NN_HASH_MINCAP 8
+
+// Open-addressing hashmap with linear probing, which grows and shrinks as needed.
+// Each slot has a control byte and the full hash stored out of line,
+// so probing only calls the handler on likely matches.
+// It will never hold more than limit entries.
+// Entry pointers are invalidated by puts and removes.
 typedef struct nn_HashMap {
+	// hashes, then entries, then control bytes, all in one allocation
 	void *buf;
+	size_t *hashes;
+	unsigned char *ctrl;
+	// always 0 or a power of 2
 	size_t bufsize;
+	size_t len;
+	size_t tombstones;
+	size_t limit;
 	nn_Context *ctx;
 	const nn_HashContext *hash;
 } nn_HashMap;
 
-nn_Exit nn_hashInit(nn_HashMap *map, size_t capacity, nn_Context *ctx, const nn_HashContext *hash) {
-	void *buf = nn_alloc(ctx, hash->entSize * capacity);
-	if(buf == NULL) return NN_ENOMEM;
-	map->buf = buf;
-	map->bufsize = capacity;
+static size_t nn_hashAllocSize(const nn_HashContext *hash, size_t cap) {
+	return (sizeof(size_t) + hash->entSize + 1) * cap;
+}
+
+// does not allocate
+nn_Exit nn_hashInit(nn_HashMap *map, size_t limit, nn_Context *ctx, const nn_HashContext *hash) {
+	map->buf = NULL;
+	map->hashes = NULL;
+	map->ctrl = NULL;
+	map->bufsize = 0;
+	map->len = 0;
+	map->tombstones = 0;
+	map->limit = limit;
 	map->ctx = ctx;
 	map->hash = hash;
-	for(size_t i = 0; i < map->bufsize; i++) {
-		hash->handler(NN_HASH_INIT, NN_PTROFF(map->buf, i, hash->entSize), NULL);
-	}
 	return NN_OK;
 }
 
 // note: does not free entries
 void nn_hashDeinit(nn_HashMap *map) {
-	nn_free(map->ctx, map->buf, map->hash->entSize * map->bufsize);
+	nn_free(map->ctx, map->buf, nn_hashAllocSize(map->hash, map->bufsize));
+	map->buf = NULL;
+	map->bufsize = 0;
+	map->len = 0;
+	map->tombstones = 0;
 }
 
 void nn_hashClear(nn_HashMap *map) {
-	for(size_t i = 0; i < map->bufsize; i++) {
-		void *ent = NN_PTROFF(map->buf, i, map->hash->entSize);
-		if(map->hash->handler(NN_HASH_CMP, ent, NULL) == NN_HASH_DIFFERENT) {
-			map->hash->handler(NN_HASH_REMOVE, ent, NULL);
-		}
-	}
+	for(size_t i = 0; i < map->bufsize; i++) map->ctrl[i] = NN_HASH_CTRL_EMPTY;
+	map->len = 0;
+	map->tombstones = 0;
+}
+
+static unsigned char nn_hashCtrlOf(size_t hash) {
+	return hash & 0x7F;
 }
 
 size_t nn_hashGetHash(nn_HashMap *map, void *entry) {
 	return map->hash->handler(NN_HASH_HASH, entry, NULL);
 }
+
 void *nn_hashGetAt(nn_HashMap *map, size_t idx) {
-	return NN_PTROFF(map->buf, idx, map->hash->entSize);
+	return NN_PTROFF(map->buf, map->bufsize * sizeof(size_t) + idx * map->hash->entSize, 1);
+}
+
+// finds the index of entry, or returns bufsize if there is none.
+static size_t nn_hashFind(nn_HashMap *map, void *entry, size_t hash) {
+	size_t mask = map->bufsize - 1;
+	unsigned char ctrl = nn_hashCtrlOf(hash);
+	size_t j = hash & mask;
+	for(size_t i = 0; i < map->bufsize; i++, j = (j + 1) & mask) {
+		unsigned char c = map->ctrl[j];
+		if(c == NN_HASH_CTRL_EMPTY) break;
+		if(c != ctrl || map->hashes[j] != hash) continue;
+		if(map->hash->handler(NN_HASH_CMP, nn_hashGetAt(map, j), entry) == NN_HASH_EQUAL) return j;
+	}
+	return map->bufsize;
 }
 
-// get by entry by key. It is assumed that the entry is NULL.
+// rebuilds the map with a new capacity, dropping all tombstones.
+static nn_Exit nn_hashRehash(nn_HashMap *map, size_t newCap) {
+	size_t entSize = map->hash->entSize;
+	void *buf = nn_alloc(map->ctx, nn_hashAllocSize(map->hash, newCap));
+	if(buf == NULL) return NN_ENOMEM;
+	size_t *hashes = buf;
+	unsigned char *ctrl = NN_PTROFF(buf, (sizeof(size_t) + entSize) * newCap, 1);
+	for(size_t i = 0; i < newCap; i++) ctrl[i] = NN_HASH_CTRL_EMPTY;
+
+	size_t mask = newCap - 1;
+	for(size_t i = 0; i < map->bufsize; i++) {
+		unsigned char c = map->ctrl[i];
+		if(c == NN_HASH_CTRL_EMPTY || c == NN_HASH_CTRL_DELETED) continue;
+		size_t hash = map->hashes[i];
+		size_t j = hash & mask;
+		// there is always a free slot, as newCap is above the length
+		while(ctrl[j] != NN_HASH_CTRL_EMPTY) j = (j + 1) & mask;
+		ctrl[j] = c;
+		hashes[j] = hash;
+		nn_memcpy(NN_PTROFF(buf, newCap * sizeof(size_t) + j * entSize, 1), nn_hashGetAt(map, i), entSize);
+	}
+
+	nn_free(map->ctx, map->buf, nn_hashAllocSize(map->hash, map->bufsize));
+	map->buf = buf;
+	map->hashes = hashes;
+	map->ctrl = ctrl;
+	map->bufsize = newCap;
+	map->tombstones = 0;
+	return NN_OK;
+}
+
+// the smallest capacity which keeps len entries at most 3/4 full
+static size_t nn_hashCapFor(size_t len) {
+	size_t cap = NN_HASH_MINCAP;
+	while(cap / 4 * 3 < len) cap *= 2;
+	return cap;
+}
+
+// preallocates space for len entries
+nn_Exit nn_hashReserve(nn_HashMap *map, size_t len) {
+	if(len > map->limit) len = map->limit;
+	size_t cap = nn_hashCapFor(len);
+	if(cap <= map->bufsize) return NN_OK;
+	return nn_hashRehash(map, cap);
+}
+
+// get by entry by key, with the hash of the key already computed.
+void *nn_hashGetH(nn_HashMap *map, void *entry, size_t hash) {
+	if(entry == NULL) return NULL;
+	if(map->len == 0) return NULL;
+	size_t j = nn_hashFind(map, entry, hash);
+	if(j == map->bufsize) return NULL;
+	return nn_hashGetAt(map, j);
+}
+
+// get by entry by key.
 void *nn_hashGet(nn_HashMap *map, void *entry) {
 	if(entry == NULL) return NULL;
-	size_t len = map->bufsize;
-	if(len == 0) return NULL;
-	size_t base = nn_hashGetHash(map, entry) % len;
-	size_t entSize = map->hash->entSize;
-	for(size_t i = 0; i < len; i++) {
-		size_t j = (base + i) % len;
-		void *slot = NN_PTROFF(map->buf, j, entSize);
-		nn_HashEntryState state = map->hash->handler(NN_HASH_CMP, slot, entry);
-		switch(state) {
-		case NN_HASH_EQUAL:
-			return slot;
-		case NN_HASH_DIFFERENT:
-		case NN_HASH_REMOVED:
-			continue;
-		case NN_HASH_FREE:
-			break;
-		}
-	}
-	return NULL;
+	return nn_hashGetH(map, entry, nn_hashGetHash(map, entry));
 }
 
 // should put the entire entry over there.
-// False on ENOSPC.
-bool nn_hashPut(nn_HashMap *map, void *entry) {
-	if(entry == NULL) return false;
-	size_t len = map->bufsize;
-	if(len == 0) return false;
-	size_t base = nn_hashGetHash(map, entry);
+// NN_ELIMIT if the map is at its limit, NN_ENOMEM if it could not grow.
+nn_Exit nn_hashPutH(nn_HashMap *map, void *entry, size_t hash) {
 	size_t entSize = map->hash->entSize;
-	for(size_t i = 0; i < len; i++) {
-		size_t j = (base + i) % len;
-		void *slot = NN_PTROFF(map->buf, j, entSize);
-		nn_HashEntryState state = map->hash->handler(NN_HASH_CMP, slot, entry);
-		switch(state) {
-		case NN_HASH_EQUAL:
-		case NN_HASH_REMOVED:
-		case NN_HASH_FREE:
-			nn_memcpy(slot, entry, entSize);
-			return true;
-		case NN_HASH_DIFFERENT:
-			break;
+	if(map->len > 0) {
+		size_t j = nn_hashFind(map, entry, hash);
+		if(j != map->bufsize) {
+			nn_memcpy(nn_hashGetAt(map, j), entry, entSize);
+			return NN_OK;
 		}
 	}
-	return false;
+	if(map->len >= map->limit) return NN_ELIMIT;
+	// tombstones count towards the load, as they lengthen probes just the same
+	if((map->len + map->tombstones + 1) > map->bufsize / 8 * 7) {
+		nn_Exit e = nn_hashRehash(map, nn_hashCapFor(map->len + 1));
+		if(e) return e;
+	}
+	size_t mask = map->bufsize - 1;
+	size_t j = hash & mask;
+	while(map->ctrl[j] != NN_HASH_CTRL_EMPTY && map->ctrl[j] != NN_HASH_CTRL_DELETED) {
+		j = (j + 1) & mask;
+	}
+	if(map->ctrl[j] == NN_HASH_CTRL_DELETED) map->tombstones--;
+	map->ctrl[j] = nn_hashCtrlOf(hash);
+	map->hashes[j] = hash;
+	nn_memcpy(nn_hashGetAt(map, j), entry, entSize);
+	map->len++;
+	return NN_OK;
+}
+
+nn_Exit nn_hashPut(nn_HashMap *map, void *entry) {
+	return nn_hashPutH(map, entry, nn_hashGetHash(map, entry));
+}
+
+// remove an entry, with the hash of the key already computed.
+void nn_hashRemoveH(nn_HashMap *map, void *entry, size_t hash) {
+	if(map->len == 0) return;
+	size_t j = nn_hashFind(map, entry, hash);
+	if(j == map->bufsize) return;
+	size_t mask = map->bufsize - 1;
+	// if the next slot is empty, no probe can go past this one
+	if(map->ctrl[(j + 1) & mask] == NN_HASH_CTRL_EMPTY) {
+		map->ctrl[j] = NN_HASH_CTRL_EMPTY;
+	} else {
+		map->ctrl[j] = NN_HASH_CTRL_DELETED;
+		map->tombstones++;
+	}
+	map->len--;
+	if(map->len == 0) {
+		nn_hashClear(map);
+	} else if(map->bufsize > NN_HASH_MINCAP && map->len < map->bufsize / 4) {
+		// failing to shrink is fine
+		nn_hashRehash(map, map->bufsize / 2);
+	}
 }
 
-// remove an entry
 void nn_hashRemove(nn_HashMap *map, void *entry) {
-	void *mem = nn_hashGet(map, entry);
-	if(mem == NULL) return;
-	map->hash->handler(NN_HASH_REMOVE, mem, NULL);
+	nn_hashRemoveH(map, entry, nn_hashGetHash(map, entry));
 }
 
 // takes in an entry and returns the next one. If entry is NULL, it will return the first one.
@@ -859,30 +1022,83 @@ void nn_hashRemove(nn_HashMap *map, void *entry) {
 // entry must be either NULL or a pointer to the map's buffer.
 void *nn_hashIterate(nn_HashMap *map, void *entry) {
 	size_t entSize = map->hash->entSize;
-	void *bufEnd = NN_PTROFF(map->buf, map->bufsize, entSize);
-	if(entry == NULL) {
-		if(map->bufsize == 0) return NULL;
-		entry = map->buf;
-	} else {
-		entry = NN_PTROFF(entry, 1, entSize);
+	size_t i = 0;
+	if(entry != NULL) {
+		i = ((size_t)entry - (size_t)nn_hashGetAt(map, 0)) / entSize + 1;
 	}
-	while(true) {
-		if(entry == bufEnd) return NULL;
-		nn_HashEntryState state = map->hash->handler(NN_HASH_CMP, entry, NULL);
-		if(state == NN_HASH_DIFFERENT) break;
-		entry = NN_PTROFF(entry, 1, entSize);
+	for(; i < map->bufsize; i++) {
+		unsigned char c = map->ctrl[i];
+		if(c != NN_HASH_CTRL_EMPTY && c != NN_HASH_CTRL_DELETED) return nn_hashGetAt(map, i);
 	}
-	return entry;
+	return NULL;
+}
+
+// word-at-a-time hash in the style of wyhash/rapidhash.
+// It is not stable across platforms, so never store it.
+
+// 64x64 multiply, folding the 128-bit result
+static uint64_t nn_hashMum(uint64_t a, uint64_t b) {
+#ifdef __SIZEOF_INT128__
+	__uint128_t r = (__uint128_t)a * b;
+	return (uint64_t)r ^ (uint64_t)(r >> 64);
+#else
+	uint64_t ha = a >> 32, la = (uint32_t)a, hb = b >> 32, lb = (uint32_t)b;
+	uint64_t hh = ha * hb, hl = ha * lb, lh = la * hb, ll = la * lb;
+	uint64_t mid = (ll >> 32) + (uint32_t)hl + (uint32_t)lh;
+	uint64_t lo = (mid << 32) | (uint32_t)ll;
+	uint64_t hi = hh + (hl >> 32) + (lh >> 32) + (mid >> 32);
+	return lo ^ hi;
+#endif
+}
+
+// constant-size builtin copies compile to a single load, nn_memcpy is a call
+#ifdef __GNUC__
+#define nn_hashRead(dest, src) __builtin_memcpy(dest, src, sizeof(*(dest)))
+#else
+#define nn_hashRead(dest, src) nn_memcpy(dest, src, sizeof(*(dest)))
+#endif
+
+static uint64_t nn_hashRead64(const char *p) {
+	uint64_t v;
+	nn_hashRead(&v, p);
+	return v;
+}
+
+static uint64_t nn_hashRead32(const char *p) {
+	uint32_t v;
+	nn_hashRead(&v, p);
+	return v;
+}
+
+// never returns 0, so 0 can mean "not hashed yet"
+size_t nn_lstrhash(const char *s, size_t len) {
+	const uint64_t k0 = 0x2d358dccaa6c78a5ull, k1 = 0x8bb84b93962eacc9ull, k2 = 0x4b33a62ed433d4a3ull;
+	uint64_t seed = k0 ^ nn_hashMum(len ^ k0, k1);
+	const char *p = s;
+	size_t left = len;
+	while(left > 16) {
+		seed = nn_hashMum(nn_hashRead64(p) ^ k1, nn_hashRead64(p + 8) ^ seed);
+		p += 16;
+		left -= 16;
+	}
+	uint64_t a = 0, b = 0;
+	if(left >= 8) {
+		// overlapping reads cover 8 to 16 bytes
+		a = nn_hashRead64(p);
+		b = nn_hashRead64(p + left - 8);
+	} else if(left >= 4) {
+		a = nn_hashRead32(p);
+		b = nn_hashRead32(p + left - 4);
+	} else if(left > 0) {
+		a = ((uint64_t)(unsigned char)p[0] << 16) | ((uint64_t)(unsigned char)p[left >> 1] << 8) | (unsigned char)p[left - 1];
+	}
+	uint64_t h = nn_hashMum(nn_hashMum(a ^ k1, b ^ seed) ^ k2, len ^ k1);
+	size_t out = (size_t)(h ^ (h >> 32));
+	return out == 0 ? 1 : out;
 }
 
-// from https://gist.github.com/MohamedTaha98/ccdf734f13299efb73ff0b12f7ce429f
-// TODO: experiment with better ones
 size_t nn_strhash(const char *s) {
-	size_t hash = 5381;
-	int c;
-	while ((c = *s++))
-		hash = ((hash << 5) + hash) + c; /* hash * 33 + c */
-	return hash;
+	return nn_lstrhash(s, nn_strlen(s));
 }
 
 // real stuff
@@ -898,6 +1114,7 @@ struct nn_Component {
 	nn_refc_t refc;
 	nn_Universe *universe;
 	char *address;
+	size_t addressHash;
 	char *type;
 	char *internalID;
 	void *state;
@@ -912,21 +1129,9 @@ static size_t nn_methodHash(nn_HashAction act, void *_slot, void *_ent) {
 	nn_MethodEntry *slot = _slot;
 	nn_MethodEntry *ent = _ent;
 	switch(act) {
-	case NN_HASH_INIT:
-		slot->name = NULL;
-		slot->flags = -1;
-		break;
 	case NN_HASH_HASH:
 		return nn_strhash(slot->name);
-	case NN_HASH_REMOVE:
-		slot->flags = -1;
-		break;
 	case NN_HASH_CMP:
-		if(slot->name == NULL) return NN_HASH_FREE;
-		if(slot->flags == -1) return NN_HASH_REMOVED;
-		if(ent == NULL) {
-			return NN_HASH_DIFFERENT;
-		}
 		return nn_strcmp(slot->name, ent->name) == 0 ? NN_HASH_EQUAL : NN_HASH_DIFFERENT;
 	}
 	return 0;
@@ -937,6 +1142,19 @@ static const nn_HashContext nn_methodHasher = {
 	.handler = (nn_HashHandler *)nn_methodHash,
 };
 
+// The idle timer wheel has NN_TIMER_LEVELS levels of NN_TIMER_SLOTS slots.
+// Level N covers deadlines NN_TIMER_SLOTS^N ticks away, and is cascaded into the level
+// below whenever that one wraps around. Deadlines past the last level are clamped,
+// and re-queued once they come up.
+#define NN_TIMER_BITS 6
+#define NN_TIMER_SLOTS (1 << NN_TIMER_BITS)
+#define NN_TIMER_LEVELS 4
+// in seconds
+#define NN_TIMER_RESOLUTION 0.001
+// the extra slot holding the computers whose deadline passed
+#define NN_TIMER_READY (NN_TIMER_LEVELS * NN_TIMER_SLOTS)
+#define NN_TIMER_NONE ((size_t)-1)
+
 struct nn_Universe {
 	nn_Context ctx;
 	void *userdata;
@@ -944,6 +1162,16 @@ struct nn_Universe {
 	size_t memoryLimit;
 	// 0 for unbounded
 	size_t storageLimit;
+	nn_Lock *timerLock;
+	double timerBase;
+	// the last tick the wheel was advanced to
+	size_t timerNow;
+	// computers in the wheel, not counting the ready ones
+	size_t timerCount;
+	nn_Computer *timerSlots[NN_TIMER_READY + 1];
+	// the computers which are not in the wheel, also protected by its lock
+	nn_Computer *activeHead;
+	size_t activeCount;
 };
 
 typedef struct nn_ComponentEntry {
@@ -956,19 +1184,9 @@ static size_t nn_componentHash(nn_HashAction act, void *_slot, void *_ent) {
 	nn_ComponentEntry *slot = _slot;
 	nn_ComponentEntry *ent = _ent;
 	switch(act) {
-	case NN_HASH_INIT:
-		slot->address = NULL;
-		slot->comp = NULL;
-		break;
 	case NN_HASH_HASH:
 		return nn_strhash(slot->address);
-	case NN_HASH_REMOVE:
-		slot->comp = NULL;
-		break;
 	case NN_HASH_CMP:
-		if(slot->address == NULL) return NN_HASH_FREE;
-		if(slot->comp == NULL) return NN_HASH_REMOVED;
-		if(ent == NULL) return NN_HASH_DIFFERENT;
 		return nn_strcmp(slot->address, ent->address) == 0 ? NN_HASH_EQUAL : NN_HASH_DIFFERENT;
 	}
 	return 0;
@@ -1004,15 +1222,29 @@ typedef struct nn_String {
 	nn_Context ctx;
 	size_t refc;
 	size_t len;
+	// 0 until it is needed
+	size_t hash;
+	// allocated from the computer's transient arena, and thus never freed
+	bool transient;
 	char data[];
 } nn_String;
 
+// strings up to this length are stored inside the nn_Value itself,
+// so most method names and small return values never allocate.
+#define NN_SHORTSTR 23
+// shortLen of a string stored in an nn_String
+#define NN_HEAPSTR 0xFF
+
 typedef struct nn_Value {
 	nn_ValueType type;
+	// for strings, the length of the inline string, or NN_HEAPSTR.
+	// It sits in what would otherwise be padding.
+	unsigned char shortLen;
 	union {
 		bool boolean;
 		double number;
 		nn_String *string;
+		char shortStr[NN_SHORTSTR + 1];
 		size_t userdataIdx;
 		struct nn_Table *table;
 	};
@@ -1022,14 +1254,30 @@ typedef struct nn_Table {
 	nn_Context ctx;
 	size_t refc;
 	size_t len;
+	// allocated from the computer's transient arena, and thus never freed
+	bool transient;
 	nn_Value vals[];
 } nn_Table;
 
+// values live in the computer's signal slab, starting at start and wrapping
+// around at NN_MAX_SIGNALVALUES.
 typedef struct nn_Signal {
+	size_t start;
 	size_t len;
-	nn_Value *values;
 } nn_Signal;
 
+typedef struct nn_InboxSlot {
+	// the position this slot is ready to be written at, or position+1 once written.
+	nn_atomic_t seq;
+	nn_EncodedNetworkContents contents;
+	// the users can change while it is queued, so the player it came from
+	// is checked by the owning thread, once drained
+	bool checkUser;
+	// longer than any user can be, so only allowed if there are no users
+	bool longUser;
+	char user[NN_MAX_USERNAME];
+} nn_InboxSlot;
+
 typedef struct nn_DeviceInfoEntry {
 	const char *address;
 	nn_Arena arena;
@@ -1067,8 +1315,16 @@ nn_Exit nn_resizeDeviceInfoArray(nn_Context *ctx, nn_DeviceInfoArray *arr, size_
 typedef struct nn_Userdata {
 	void *state;
 	char *compAddress;
+	size_t compHash;
 } nn_Userdata;
 
+// see nn_pollComponentAt()
+typedef struct nn_Poll {
+	nn_Component *component;
+	// in uptime
+	double at;
+} nn_Poll;
+
 struct nn_Computer {
 	nn_ComputerState state;
 	nn_Universe *universe;
@@ -1087,17 +1343,65 @@ struct nn_Computer {
 	nn_HashMap components;
 	nn_DeviceInfoArray deviceInfo;
 	double totalEnergy;
+	// the opt-in energy ledger, see nn_setEnergyLedger()
+	bool energyLedger;
+	double energyBalance;
+	double energyPending;
+	double energyThreshold;
+	// everything nn_removeEnergy() was asked to remove, for the profiler
+	double energySpent;
+	// how many component and userdata methods were invoked, see nn_getInvokeCount()
+	size_t invokeCount;
+	// NULL unless profiling, see nn_setProfiling()
+	struct nn_Profiler *profiler;
+	// NULL unless tracing, see nn_setTracing()
+	struct nn_Trace *trace;
 	size_t totalMemory;
 	double creationTimestamp;
 	size_t stackSize;
 	size_t archCount;
+	size_t signalHead;
 	size_t signalCount;
+	size_t signalValueHead;
+	size_t signalValueCount;
+	size_t inboxHead;
+	nn_atomic_t inboxTail;
+	size_t mountGeneration;
+	// strings and tables pushed on the call stack, reset once it is empty.
+	// Values which escape into signals are copied out of it.
+	nn_Arena transient;
+	size_t transientUsed;
+	// set during nn_invokeBatch(), as values are parked outside of the stack
+	bool batching;
 	size_t userCount;
 	double idleTimestamp;
+	// the universe's idle timer wheel, protected by its lock
+	nn_Computer *timerNext;
+	nn_Computer *timerPrev;
+	size_t timerSlot;
+	// when it wakes up, in context time
+	double timerDeadline;
+	// whether it is in the wheel. Only the ticking thread sets it.
+	nn_atomic_t timerQueued;
+	// the universe's active set, protected by the wheel's lock
+	nn_Computer *activeNext;
+	nn_Computer *activePrev;
+	bool active;
+	// set while scheduled, with its index in the scheduler
+	nn_Scheduler *scheduler;
+	size_t schedulerIndex;
+	// set by nn_waitForSignal(), cleared once a signal comes in or the computer runs again
+	nn_atomic_t signalWaiting;
+	size_t pollCount;
+	nn_Poll polls[NN_MAX_POLLS];
 	nn_Value callstack[NN_MAX_STACK];
+	// results and pending arguments of nn_invokeBatch()
+	nn_Value batchValues[NN_MAX_STACK];
 	char errorBuffer[NN_MAX_ERROR_SIZE];
 	nn_Architecture archs[NN_MAX_ARCHITECTURES];
 	nn_Signal signals[NN_MAX_SIGNALS];
+	nn_Value signalValues[NN_MAX_SIGNALVALUES];
+	nn_InboxSlot inbox[NN_MAX_INBOX];
 	char *users[NN_MAX_USERS];
 	nn_Userdata uservals[NN_MAX_USERDATA];
 };
@@ -1109,11 +1413,23 @@ nn_Universe *nn_createUniverse(nn_Context *ctx, void *userdata) {
 	u->userdata = userdata;
 	u->memoryLimit = 0;
 	u->storageLimit = 0;
+	u->timerLock = nn_createLock(ctx);
+	if(u->timerLock == NULL) {
+		nn_free(ctx, u, sizeof(nn_Universe));
+		return NULL;
+	}
+	u->timerBase = nn_currentTime(ctx);
+	u->timerNow = 0;
+	u->timerCount = 0;
+	for(size_t i = 0; i <= NN_TIMER_READY; i++) u->timerSlots[i] = NULL;
+	u->activeHead = NULL;
+	u->activeCount = 0;
 	return u;
 }
 
 void nn_destroyUniverse(nn_Universe *universe) {
 	nn_Context ctx = universe->ctx;
+	nn_destroyLock(&ctx, universe->timerLock);
 	nn_free(&ctx, universe, sizeof(nn_Universe));
 }
 
@@ -1166,6 +1482,25 @@ size_t nn_ramSizes[8] = {
 	2 * NN_MiB,
 };
 
+static void nn_activeLink(nn_Universe *u, nn_Computer *c) {
+	if(c->active) return;
+	c->active = true;
+	c->activePrev = NULL;
+	c->activeNext = u->activeHead;
+	if(c->activeNext != NULL) c->activeNext->activePrev = c;
+	u->activeHead = c;
+	u->activeCount++;
+}
+
+static void nn_activeUnlink(nn_Universe *u, nn_Computer *c) {
+	if(!c->active) return;
+	if(c->activePrev != NULL) c->activePrev->activeNext = c->activeNext;
+	else u->activeHead = c->activeNext;
+	if(c->activeNext != NULL) c->activeNext->activePrev = c->activePrev;
+	c->active = false;
+	u->activeCount--;
+}
+
 nn_Computer *nn_createComputer(nn_Universe *universe, void *userdata, const char *address, size_t totalMemory, size_t maxComponents, size_t maxDevices) {
 	nn_Context *ctx = &universe->ctx;
 
@@ -1208,30 +1543,55 @@ nn_Computer *nn_createComputer(nn_Universe *universe, void *userdata, const char
 	// OC defaults to Integer.MAX_VALUE, idk where the old number came from
 	c->directCost = 0;
 
-	if(nn_hashInit(&c->components, maxComponents, ctx, &nn_componentHasher)) {
-		nn_destroyLock(ctx, c->lock);
-		nn_strfree(ctx, c->address);
-		nn_free(ctx, c, sizeof(nn_Computer));
-		return NULL;
-	}
+	nn_hashInit(&c->components, maxComponents, ctx, &nn_componentHasher);
 
 	c->deviceInfo.entries = NULL;
 	c->deviceInfo.len = 0;
 	c->deviceInfo.cap = 0;
 	c->deviceInfo.limit = maxDevices;
+	// 0 is left for zeroed handles
+	c->mountGeneration = 1;
+	nn_arinit(&c->transient, ctx);
+	c->transientUsed = 0;
+	c->batching = false;
 	
 	c->totalEnergy = 500;
+	c->energyLedger = false;
+	c->energyBalance = 0;
+	c->energyPending = 0;
+	c->energyThreshold = 0;
+	c->energySpent = 0;
+	c->invokeCount = 0;
+	c->profiler = NULL;
+	c->trace = NULL;
 	c->env.handler = nn_default_envHandler;
 	c->totalMemory = totalMemory;
 	c->creationTimestamp = nn_currentTime(ctx);
 	c->stackSize = 0;
 	c->archCount = 0;
+	c->signalHead = 0;
 	c->signalCount = 0;
+	c->signalValueHead = 0;
+	c->signalValueCount = 0;
+	c->inboxHead = 0;
+	nn_atomicStore(&c->inboxTail, 0);
+	for(size_t i = 0; i < NN_MAX_INBOX; i++) nn_atomicStore(&c->inbox[i].seq, i);
 	c->userCount = 0;
 	c->idleTimestamp = 0;
+	c->timerSlot = NN_TIMER_NONE;
+	nn_atomicStore(&c->timerQueued, false);
+	nn_atomicStore(&c->signalWaiting, false);
+	c->active = false;
+	c->scheduler = NULL;
+	c->schedulerIndex = 0;
+	c->pollCount = 0;
 	// set to empty string
 	c->errorBuffer[0] = '\0';
 	for(size_t i = 0; i < NN_MAX_USERDATA; i++) c->uservals[i].state = NULL;
+	// it has yet to boot, so it is not idle
+	nn_lock(ctx, universe->timerLock);
+	nn_activeLink(universe, c);
+	nn_unlock(ctx, universe->timerLock);
 	return c;
 }
 
@@ -1277,8 +1637,50 @@ nn_Exit nn_startComputer(nn_Computer *computer) {
 	return NN_OK;
 }
 
+static void nn_sendPoll(nn_Computer *computer, nn_Poll *poll, nn_ComponentAction action) {
+	nn_Component *c = poll->component;
+	nn_ComponentRequest req;
+	req.ctx = &c->universe->ctx;
+	req.computer = computer;
+	req.state = c->state;
+	req.classState = c->classState;
+	req.compAddress = c->address;
+	req.action = action;
+	req.methodIdx = 0;
+	req.pollAt = -1;
+	c->handler(&req);
+	// the entry is gone by now, so asking again is not a move
+	if(action == NN_COMP_POLL && req.pollAt >= 0) nn_pollComponentAt(computer, c, req.pollAt);
+	nn_dropComponent(c);
+}
+
+// sends NN_COMP_POLL to the components whose polls are due
+static void nn_runPolls(nn_Computer *computer) {
+	if(computer->pollCount == 0) return;
+	double now = nn_getUptime(computer);
+	// taken out first, as handlers may ask for new ones
+	nn_Poll due[NN_MAX_POLLS];
+	size_t dueCount = 0;
+	size_t i = 0;
+	while(i < computer->pollCount) {
+		if(computer->polls[i].at > now) {
+			i++;
+			continue;
+		}
+		due[dueCount++] = computer->polls[i];
+		computer->polls[i] = computer->polls[--computer->pollCount];
+	}
+	for(i = 0; i < dueCount; i++) nn_sendPoll(computer, &due[i], NN_COMP_POLL);
+}
+
+static void nn_forgetPolls(nn_Computer *computer) {
+	while(computer->pollCount > 0) {
+		nn_Poll poll = computer->polls[--computer->pollCount];
+		nn_sendPoll(computer, &poll, NN_COMP_FORGET);
+	}
+}
+
 void nn_stopComputer(nn_Computer *computer) {
-	nn_Context *ctx = &computer->universe->ctx;
 	if(nn_isComputerOn(computer)) {
 		nn_ArchitectureRequest req;
 		req.computer = computer;
@@ -1295,12 +1697,17 @@ void nn_stopComputer(nn_Computer *computer) {
 		computer->env.handler(&envreq);
 	}
 	computer->state = NN_BOOTUP;
-	for(size_t i = 0; i < computer->signalCount; i++) {
-		nn_Signal s = computer->signals[i];
-		for(size_t j = 0; j < s.len; j++) nn_dropValue(s.values[j]);
-		nn_free(ctx, s.values, sizeof(nn_Value) * s.len);
+	for(size_t i = 0; i < computer->signalValueCount; i++) {
+		size_t j = (computer->signalValueHead + i) % NN_MAX_SIGNALVALUES;
+		nn_dropValue(computer->signalValues[j]);
 	}
+	computer->signalHead = 0;
 	computer->signalCount = 0;
+	computer->signalValueHead = 0;
+	computer->signalValueCount = 0;
+	// the computer is not running, so this discards them
+	nn_drainInbox(computer);
+	nn_forgetPolls(computer);
 }
 
 void nn_forceCrashComputer(nn_Computer *computer, const char *s) {
@@ -1450,6 +1857,232 @@ void nn_beepComputerMorse(nn_Computer *computer, nn_MorseBeep beep) {
 	computer->env.handler(&req);
 }
 
+// asks the environment to remove [energy], and returns the energy left
+static double nn_drawEnergy(nn_Computer *computer, double energy) {
+	nn_EnvironmentRequest req;
+	req.userdata = computer->env.userdata;
+	req.computer = computer;
+	req.action = NN_ENV_DRAWENERGY;
+	req.energy = energy;
+	computer->env.handler(&req);
+	return req.energy;
+}
+
+static size_t nn_timerTickOf(nn_Universe *u, double time) {
+	double ticks = (time - u->timerBase) / NN_TIMER_RESOLUTION;
+	if(ticks <= 0) return 0;
+	// waiting forever, which is still re-queued from the furthest slot
+	if(ticks >= (double)((size_t)-1 / 2)) return (size_t)-1 / 2;
+	// rounded up, so they never wake up early
+	size_t t = (size_t)ticks;
+	return t < ticks ? t + 1 : t;
+}
+
+static void nn_timerLink(nn_Universe *u, nn_Computer *c, size_t slot) {
+	c->timerSlot = slot;
+	c->timerPrev = NULL;
+	c->timerNext = u->timerSlots[slot];
+	if(c->timerNext != NULL) c->timerNext->timerPrev = c;
+	u->timerSlots[slot] = c;
+	if(slot != NN_TIMER_READY) u->timerCount++;
+}
+
+static void nn_timerUnlink(nn_Universe *u, nn_Computer *c) {
+	if(c->timerPrev != NULL) c->timerPrev->timerNext = c->timerNext;
+	else u->timerSlots[c->timerSlot] = c->timerNext;
+	if(c->timerNext != NULL) c->timerNext->timerPrev = c->timerPrev;
+	if(c->timerSlot != NN_TIMER_READY) u->timerCount--;
+	c->timerSlot = NN_TIMER_NONE;
+}
+
+static void nn_timerInsert(nn_Universe *u, nn_Computer *c) {
+	size_t tick = nn_timerTickOf(u, c->timerDeadline);
+	if(tick <= u->timerNow) {
+		nn_timerLink(u, c, NN_TIMER_READY);
+		return;
+	}
+	size_t delta = tick - u->timerNow;
+	for(size_t level = 0; level < NN_TIMER_LEVELS; level++) {
+		if(delta < ((size_t)1 << (NN_TIMER_BITS * (level + 1)))) {
+			size_t slot = (tick >> (NN_TIMER_BITS * level)) & (NN_TIMER_SLOTS - 1);
+			nn_timerLink(u, c, level * NN_TIMER_SLOTS + slot);
+			return;
+		}
+	}
+	// too far away, so it goes in the furthest slot, and is re-queued from there
+	size_t level = NN_TIMER_LEVELS - 1;
+	tick = u->timerNow + ((size_t)1 << (NN_TIMER_BITS * NN_TIMER_LEVELS)) - 1;
+	nn_timerLink(u, c, level * NN_TIMER_SLOTS + ((tick >> (NN_TIMER_BITS * level)) & (NN_TIMER_SLOTS - 1)));
+}
+
+// re-inserts every computer of a slot
+static void nn_timerRequeue(nn_Universe *u, size_t slot) {
+	nn_Computer *c = u->timerSlots[slot];
+	u->timerSlots[slot] = NULL;
+	while(c != NULL) {
+		nn_Computer *next = c->timerNext;
+		u->timerCount--;
+		nn_timerInsert(u, c);
+		c = next;
+	}
+}
+
+// the first tick at which a slot comes up, or -1 if the wheel is empty
+static size_t nn_timerNextTick(nn_Universe *u) {
+	if(u->timerCount == 0) return (size_t)-1;
+	// a higher level may cascade before a lower level slot which wrapped around,
+	// so it takes the earliest slot of every level
+	size_t earliest = (size_t)-1;
+	for(size_t level = 0; level < NN_TIMER_LEVELS; level++) {
+		size_t shift = NN_TIMER_BITS * level;
+		size_t cur = u->timerNow >> shift;
+		// the current slot can only hold deadlines a full turn away
+		for(size_t i = 1; i <= NN_TIMER_SLOTS; i++) {
+			if(u->timerSlots[level * NN_TIMER_SLOTS + ((cur + i) & (NN_TIMER_SLOTS - 1))] == NULL) continue;
+			// the start of the slot, which is the earliest it can wake up
+			size_t tick = (cur + i) << shift;
+			if(tick < earliest) earliest = tick;
+			break;
+		}
+	}
+	return earliest;
+}
+
+// jumps from slot to slot, as the ticks in between have nothing to do
+static void nn_timerAdvance(nn_Universe *u, size_t now) {
+	while(u->timerNow < now) {
+		size_t next = nn_timerNextTick(u);
+		if(next > now) {
+			u->timerNow = now;
+			return;
+		}
+		u->timerNow = next;
+		for(size_t level = 1; level < NN_TIMER_LEVELS; level++) {
+			size_t below = (u->timerNow >> (NN_TIMER_BITS * (level - 1))) & (NN_TIMER_SLOTS - 1);
+			if(below != 0) break;
+			size_t slot = (u->timerNow >> (NN_TIMER_BITS * level)) & (NN_TIMER_SLOTS - 1);
+			nn_timerRequeue(u, level * NN_TIMER_SLOTS + slot);
+		}
+		nn_timerRequeue(u, u->timerNow & (NN_TIMER_SLOTS - 1));
+	}
+}
+
+// called after the computer ran, to put it in the wheel if it is idle now
+static void nn_updateIdleTimer(nn_Computer *computer) {
+	nn_Universe *u = computer->universe;
+	bool idle = nn_isComputerIdle(computer);
+	if(!idle && !nn_atomicLoad(&computer->timerQueued)) return;
+	nn_lock(&u->ctx, u->timerLock);
+	if(computer->timerSlot != NN_TIMER_NONE) nn_timerUnlink(u, computer);
+	if(idle) {
+		nn_activeUnlink(u, computer);
+		computer->timerDeadline = computer->creationTimestamp + computer->idleTimestamp;
+		nn_timerInsert(u, computer);
+	} else {
+		nn_activeLink(u, computer);
+	}
+	nn_atomicStore(&computer->timerQueued, idle);
+	nn_unlock(&u->ctx, u->timerLock);
+}
+
+// takes it out of the wheel and the active set, once destroyed
+static void nn_unqueueIdleTimer(nn_Computer *computer) {
+	nn_Universe *u = computer->universe;
+	nn_lock(&u->ctx, u->timerLock);
+	if(computer->timerSlot != NN_TIMER_NONE) nn_timerUnlink(u, computer);
+	nn_activeUnlink(u, computer);
+	nn_atomicStore(&computer->timerQueued, false);
+	nn_unlock(&u->ctx, u->timerLock);
+}
+
+// moves a computer waiting on signals to the front of the wheel and tells the environment.
+// This may run on any thread.
+static void nn_wakeComputer(nn_Computer *computer) {
+	nn_Universe *u = computer->universe;
+	if(nn_atomicLoad(&computer->timerQueued)) {
+		nn_lock(&u->ctx, u->timerLock);
+		if(computer->timerSlot != NN_TIMER_NONE && computer->timerSlot != NN_TIMER_READY) {
+			nn_timerUnlink(u, computer);
+			// so polling does not put it back
+			computer->timerDeadline = u->timerBase;
+			nn_timerLink(u, computer, NN_TIMER_READY);
+		}
+		nn_unlock(&u->ctx, u->timerLock);
+	}
+	nn_EnvironmentRequest req;
+	req.userdata = computer->env.userdata;
+	req.computer = computer;
+	req.action = NN_ENV_WAKEUP;
+	computer->env.handler(&req);
+}
+
+// moves up to [max] computers whose deadline passed into the active set, writing them to [computers] if it is not NULL.
+// The lock must be held.
+static size_t nn_timerPoll(nn_Universe *universe, nn_Computer **computers, size_t max) {
+	double elapsed = (nn_currentTime(&universe->ctx) - universe->timerBase) / NN_TIMER_RESOLUTION;
+	size_t now = elapsed > 0 ? (size_t)elapsed : 0;
+	size_t n = 0;
+	nn_timerAdvance(universe, now);
+	while(n < max && universe->timerSlots[NN_TIMER_READY] != NULL) {
+		nn_Computer *c = universe->timerSlots[NN_TIMER_READY];
+		nn_timerUnlink(universe, c);
+		// clamped deadlines come up early
+		if(nn_timerTickOf(universe, c->timerDeadline) > universe->timerNow) {
+			nn_timerInsert(universe, c);
+			continue;
+		}
+		nn_atomicStore(&c->timerQueued, false);
+		nn_activeLink(universe, c);
+		if(computers != NULL) computers[n] = c;
+		n++;
+	}
+	return n;
+}
+
+size_t nn_pollIdleTimers(nn_Universe *universe, nn_Computer **computers, size_t max) {
+	nn_Context *ctx = &universe->ctx;
+	nn_lock(ctx, universe->timerLock);
+	size_t n = nn_timerPoll(universe, computers, max);
+	nn_unlock(ctx, universe->timerLock);
+	return n;
+}
+
+size_t nn_getActiveComputers(nn_Universe *universe, nn_Computer **computers, size_t max) {
+	nn_Context *ctx = &universe->ctx;
+	size_t n = 0;
+	nn_lock(ctx, universe->timerLock);
+	for(nn_Computer *c = universe->activeHead; c != NULL && n < max; c = c->activeNext) {
+		computers[n++] = c;
+	}
+	nn_unlock(ctx, universe->timerLock);
+	return n;
+}
+
+size_t nn_getActiveCount(nn_Universe *universe) {
+	nn_Context *ctx = &universe->ctx;
+	nn_lock(ctx, universe->timerLock);
+	size_t n = universe->activeCount;
+	nn_unlock(ctx, universe->timerLock);
+	return n;
+}
+
+double nn_timeUntilIdleTimer(nn_Universe *universe) {
+	nn_Context *ctx = &universe->ctx;
+	double result = -1;
+	nn_lock(ctx, universe->timerLock);
+	if(universe->timerSlots[NN_TIMER_READY] != NULL) {
+		result = 0;
+		goto done;
+	}
+	if(universe->timerCount == 0) goto done;
+	size_t earliest = nn_timerNextTick(universe);
+	result = universe->timerBase + earliest * NN_TIMER_RESOLUTION - nn_currentTime(ctx);
+	if(result < 0) result = 0;
+done:
+	nn_unlock(ctx, universe->timerLock);
+	return result;
+}
+
 void nn_destroyComputer(nn_Computer *computer) {
 	nn_destroyComputerN(computer, 1);
 }
@@ -1457,11 +2090,17 @@ void nn_destroyComputer(nn_Computer *computer) {
 void nn_destroyComputerN(nn_Computer *computer, size_t n) {
 	if(!nn_decRef(&computer->refc, n)) return;
 	nn_Context *ctx = &computer->universe->ctx;
+	// the environment still gets what was spent
+	if(computer->energyLedger && computer->energyPending > 0) nn_drawEnergy(computer, computer->energyPending);
 	nn_stopComputer(computer);
+	nn_unqueueIdleTimer(computer);
 
 	for(size_t i = 0; i < computer->stackSize; i++) {
 		nn_dropValue(computer->callstack[i]);
 	}
+	nn_ardestroy(&computer->transient);
+	nn_setProfiling(computer, false);
+	nn_setTracing(computer, 0);
 	for(size_t i = 0; i < computer->userCount; i++) {
 		nn_strfree(ctx, computer->users[i]);
 	}
@@ -1618,34 +2257,61 @@ double nn_getTotalEnergy(nn_Computer *computer) {
 }
 
 double nn_getEnergy(nn_Computer *computer) {
-	nn_EnvironmentRequest req;
-	req.userdata = computer->env.userdata;
-	req.computer = computer;
-	req.action = NN_ENV_DRAWENERGY;
-	req.energy = 0;
-	computer->env.handler(&req);
-	if(req.energy <= 0) {
-		req.energy = 0;
+	if(computer->energyLedger) {
+		// it may have been recharged since
+		if(computer->energyBalance <= 0) nn_flushEnergy(computer);
+		return computer->energyBalance;
+	}
+	double energy = nn_drawEnergy(computer, 0);
+	if(energy <= 0) {
+		energy = 0;
 		computer->state = NN_BLACKOUT;
 	}
-	return req.energy;
+	return energy;
 }
 
 bool nn_removeEnergy(nn_Computer *computer, double energy) {
-	nn_EnvironmentRequest req;
-	req.userdata = computer->env.userdata;
-	req.computer = computer;
-	req.action = NN_ENV_DRAWENERGY;
-	req.energy = energy;
-	computer->env.handler(&req);
-	if(req.energy <= 0) {
-		req.energy = 0;
+	computer->energySpent += energy;
+	if(computer->energyLedger) {
+		computer->energyBalance -= energy;
+		computer->energyPending += energy;
+		if(computer->energyBalance <= 0 || (computer->energyThreshold > 0 && computer->energyPending >= computer->energyThreshold)) {
+			nn_flushEnergy(computer);
+		}
+		return computer->energyBalance <= 0;
+	}
+	energy = nn_drawEnergy(computer, energy);
+	if(energy <= 0) {
 		computer->state = NN_BLACKOUT;
 		return true;
 	}
 	return false;
 }
 
+void nn_setEnergyLedger(nn_Computer *computer, bool enabled, double threshold) {
+	// settle what the old ledger owed
+	nn_flushEnergy(computer);
+	computer->energyLedger = enabled;
+	computer->energyThreshold = threshold;
+	// so the balance starts out right
+	nn_flushEnergy(computer);
+}
+
+bool nn_hasEnergyLedger(nn_Computer *computer) {
+	return computer->energyLedger;
+}
+
+void nn_flushEnergy(nn_Computer *computer) {
+	if(!computer->energyLedger) return;
+	double pending = computer->energyPending;
+	computer->energyPending = 0;
+	computer->energyBalance = nn_drawEnergy(computer, pending);
+	if(computer->energyBalance <= 0) {
+		computer->energyBalance = 0;
+		computer->state = NN_BLACKOUT;
+	}
+}
+
 size_t nn_getTotalMemory(nn_Computer *computer) {
 	return computer->totalMemory;
 }
@@ -1666,33 +2332,12 @@ size_t nn_getUsedMemory(nn_Computer *computer) {
 	return nn_getTotalMemory(computer) - nn_getFreeMemory(computer);
 }
 
-double nn_getUptime(nn_Computer *computer) {
-	return nn_currentTime(&computer->universe->ctx) - computer->creationTimestamp;
-}
-
-nn_Exit nn_deserializeComputer(nn_Computer *computer, const char *buf, size_t buflen) {
-	nn_ArchitectureRequest req;
-	req.computer = computer;
-	req.action = NN_ARCH_DESERIALIZE;
-	req.globalState = computer->arch.state;
-	req.localState = computer->archState;
-	req.memIn = buf;
-	req.memLen = buflen;
-	
-	return computer->arch.handler(&req);
+size_t nn_getInvokeCount(nn_Computer *computer) {
+	return computer->invokeCount;
 }
 
-nn_Exit nn_serializeComputer(nn_Computer *computer) {
-	nn_ArchitectureRequest req;
-	req.computer = computer;
-	req.action = NN_ARCH_SERIALIZE;
-	req.globalState = computer->arch.state;
-	req.localState = computer->archState;
-	
-	nn_Exit e = computer->arch.handler(&req);
-	if(e) return e;
-
-	return NN_OK;
+double nn_getUptime(nn_Computer *computer) {
+	return nn_currentTime(&computer->universe->ctx) - computer->creationTimestamp;
 }
 
 void nn_setError(nn_Computer *computer, const char *s) {
@@ -1750,6 +2395,7 @@ bool nn_isComputerIdle(nn_Computer *computer) {
 	return nn_getUptime(computer) < computer->idleTimestamp;
 }
 
+
 void nn_addIdleTime(nn_Computer *computer, double time) {
 	computer->idleTimestamp += time;
 }
@@ -1758,27 +2404,285 @@ void nn_resetIdleTime(nn_Computer *computer) {
 	computer->idleTimestamp = -1;
 }
 
-nn_Exit nn_tick(nn_Computer *computer) {
-	if(computer->state == NN_CRASHED) {
-		return NN_EBADSTATE;
+void nn_waitForSignal(nn_Computer *computer, double timeout) {
+	if(timeout < 0) timeout = 0;
+	computer->idleTimestamp = nn_getUptime(computer) + timeout;
+	// woken up early for due polls, which may push the signal
+	for(size_t i = 0; i < computer->pollCount; i++) {
+		if(computer->polls[i].at < computer->idleTimestamp) computer->idleTimestamp = computer->polls[i].at;
+	}
+	nn_atomicStore(&computer->signalWaiting, true);
+}
+
+bool nn_isWaitingForSignal(nn_Computer *computer) {
+	return nn_atomicLoad(&computer->signalWaiting);
+}
+
+typedef enum nn_TraceKind {
+	NN_TRACE_TICK,
+	NN_TRACE_SYNCTICK,
+	NN_TRACE_INVOKE,
+	NN_TRACE_PUSHSIGNAL,
+	NN_TRACE_POPSIGNAL,
+	NN_TRACE_INSTANT,
+} nn_TraceKind;
+
+typedef struct nn_TraceEvent {
+	// index + 1 once written, 0 while being written
+	nn_atomic_t seq;
+	nn_TraceKind kind;
+	double start;
+	double duration;
+	char name[NN_MAX_TRACENAME];
+	char address[NN_MAX_TRACENAME];
+} nn_TraceEvent;
+
+// Only the computer's thread writes to it, so it needs no lock.
+// Exporting from another thread checks seq to skip the events overwritten meanwhile.
+typedef struct nn_Trace {
+	size_t capacity;
+	nn_atomic_t head;
+	nn_TraceEvent events[];
+} nn_Trace;
+
+nn_Exit nn_setTracing(nn_Computer *computer, size_t capacity) {
+	nn_Context *ctx = &computer->universe->ctx;
+	if(computer->trace != NULL) {
+		nn_free(ctx, computer->trace, sizeof(nn_Trace) + sizeof(nn_TraceEvent) * computer->trace->capacity);
+		computer->trace = NULL;
 	}
-	nn_resetCallBudget(computer);
-	nn_resetComponentBudgets(computer);
-	nn_clearstack(computer);
-	nn_Exit err;
-	// idling pootr
-	if(nn_isComputerIdle(computer)) return NN_OK;
+	if(capacity == 0) return NN_OK;
+	nn_Trace *t = nn_alloc(ctx, sizeof(nn_Trace) + sizeof(nn_TraceEvent) * capacity);
+	if(t == NULL) return NN_ENOMEM;
+	t->capacity = capacity;
+	nn_atomicStore(&t->head, 0);
+	for(size_t i = 0; i < capacity; i++) nn_atomicStore(&t->events[i].seq, 0);
+	computer->trace = t;
+	return NN_OK;
+}
+
+bool nn_isTracing(nn_Computer *computer) {
+	return computer->trace != NULL;
+}
+
+// the start of a span, which is 0 if not tracing, to not even ask for the time
+static double nn_traceNow(nn_Computer *computer) {
+	if(computer->trace == NULL) return 0;
+	return nn_currentTime(&computer->universe->ctx);
+}
+
+static void nn_traceCopyName(char name[NN_MAX_TRACENAME], const char *s, size_t len) {
+	if(s == NULL) len = 0;
+	if(len > NN_MAX_TRACENAME - 1) {
+		len = NN_MAX_TRACENAME - 1;
+		// backs up over continuation bytes, so a cut character is left out instead of split
+		while(len > 0 && ((unsigned char)s[len] & 0xC0) == 0x80) len--;
+	}
+	for(size_t i = 0; i < len; i++) name[i] = s[i];
+	name[len] = '\0';
+}
+
+static void nn_traceRecord(nn_Computer *computer, nn_TraceKind kind, double start, const char *name, size_t nameLen, const char *address) {
+	nn_Trace *t = computer->trace;
+	if(t == NULL) return;
+	size_t i = nn_atomicLoad(&t->head);
+	nn_TraceEvent *ev = &t->events[i % t->capacity];
+	nn_atomicStore(&ev->seq, 0);
+	ev->kind = kind;
+	ev->start = start;
+	ev->duration = 0;
+	if(kind == NN_TRACE_TICK || kind == NN_TRACE_SYNCTICK || kind == NN_TRACE_INVOKE) {
+		ev->duration = nn_currentTime(&computer->universe->ctx) - start;
+	}
+	nn_traceCopyName(ev->name, name, nameLen);
+	nn_traceCopyName(ev->address, address, address == NULL ? 0 : nn_strlen(address));
+	nn_atomicStore(&ev->seq, i + 1);
+	nn_atomicStore(&t->head, i + 1);
+}
+
+// a span which started at [start], from nn_traceNow()
+static void nn_traceSpan(nn_Computer *computer, nn_TraceKind kind, double start, const char *name, const char *address) {
+	if(computer->trace == NULL) return;
+	nn_traceRecord(computer, kind, start, name, name == NULL ? 0 : nn_strlen(name), address);
+}
+
+void nn_traceInstant(nn_Computer *computer, const char *name) {
+	if(computer->trace == NULL) return;
+	nn_traceRecord(computer, NN_TRACE_INSTANT, nn_traceNow(computer), name, nn_strlen(name), NULL);
+}
+
+// JSON is written one event at a time, through a small buffer
+typedef struct nn_TraceBuffer {
+	char data[512];
+	size_t len;
+} nn_TraceBuffer;
+
+static void nn_traceAppend(nn_TraceBuffer *b, const char *s) {
+	for(size_t i = 0; s[i] != '\0' && b->len < sizeof(b->data); i++) b->data[b->len++] = s[i];
+}
+
+static void nn_traceAppendEscaped(nn_TraceBuffer *b, const char *s) {
+	const char *hex = "0123456789abcdef";
+	nn_traceAppend(b, "\"");
+	for(size_t i = 0; s[i] != '\0'; i++) {
+		unsigned char c = s[i];
+		char esc[7] = {c, '\0'};
+		if(c == '"' || c == '\\') {
+			esc[0] = '\\';
+			esc[1] = c;
+			esc[2] = '\0';
+		} else if(c < 0x20) {
+			esc[0] = '\\';
+			esc[1] = 'u';
+			esc[2] = '0';
+			esc[3] = '0';
+			esc[4] = hex[c >> 4];
+			esc[5] = hex[c & 15];
+			esc[6] = '\0';
+		}
+		nn_traceAppend(b, esc);
+	}
+	nn_traceAppend(b, "\"");
+}
+
+static void nn_traceAppendUint(nn_TraceBuffer *b, unsigned long long n) {
+	char digits[24];
+	size_t len = 0;
+	do {
+		digits[len++] = '0' + n % 10;
+		n /= 10;
+	} while(n != 0);
+	char s[24];
+	for(size_t i = 0; i < len; i++) s[i] = digits[len - 1 - i];
+	s[len] = '\0';
+	nn_traceAppend(b, s);
+}
+
+// trace timestamps are in microseconds, which we keep nanoseconds of
+static void nn_traceAppendMicros(nn_TraceBuffer *b, double seconds) {
+	if(seconds < 0) seconds = 0;
+	unsigned long long ns = seconds * 1e9;
+	nn_traceAppendUint(b, ns / 1000);
+	char frac[5] = {'.', '0' + ns / 100 % 10, '0' + ns / 10 % 10, '0' + ns % 10, '\0'};
+	nn_traceAppend(b, frac);
+}
+
+static void nn_traceFlush(nn_TraceBuffer *b, nn_TraceWriter *writer, void *userdata) {
+	writer(userdata, b->data, b->len);
+	b->len = 0;
+}
+
+static const char *nn_traceNames[] = {
+	[NN_TRACE_TICK] = "tick",
+	[NN_TRACE_SYNCTICK] = "tickSynchronized",
+	[NN_TRACE_INVOKE] = "invoke",
+	[NN_TRACE_PUSHSIGNAL] = "pushSignal",
+	[NN_TRACE_POPSIGNAL] = "popSignal",
+	[NN_TRACE_INSTANT] = "arch",
+};
+
+static void nn_traceAppendEvent(nn_TraceBuffer *b, const nn_TraceEvent *ev, size_t tid) {
+	bool span = ev->kind == NN_TRACE_TICK || ev->kind == NN_TRACE_SYNCTICK || ev->kind == NN_TRACE_INVOKE;
+	// invokes and instants are named after the method and event
+	bool named = ev->kind == NN_TRACE_INVOKE || ev->kind == NN_TRACE_INSTANT;
+	nn_traceAppend(b, "{\"name\":");
+	nn_traceAppendEscaped(b, named ? ev->name : nn_traceNames[ev->kind]);
+	nn_traceAppend(b, ",\"cat\":");
+	nn_traceAppendEscaped(b, nn_traceNames[ev->kind]);
+	nn_traceAppend(b, span ? ",\"ph\":\"X\"" : ",\"ph\":\"i\",\"s\":\"t\"");
+	nn_traceAppend(b, ",\"pid\":1,\"tid\":");
+	nn_traceAppendUint(b, tid);
+	nn_traceAppend(b, ",\"ts\":");
+	nn_traceAppendMicros(b, ev->start);
+	if(span) {
+		nn_traceAppend(b, ",\"dur\":");
+		nn_traceAppendMicros(b, ev->duration);
+	}
+	if(ev->kind == NN_TRACE_INVOKE) {
+		nn_traceAppend(b, ",\"args\":{\"address\":");
+		nn_traceAppendEscaped(b, ev->address);
+		nn_traceAppend(b, "}");
+	} else if(ev->kind == NN_TRACE_PUSHSIGNAL || ev->kind == NN_TRACE_POPSIGNAL) {
+		nn_traceAppend(b, ",\"args\":{\"signal\":");
+		nn_traceAppendEscaped(b, ev->name);
+		nn_traceAppend(b, "}");
+	}
+	nn_traceAppend(b, "}");
+}
+
+void nn_exportTrace(nn_Computer **computers, size_t count, nn_TraceWriter *writer, void *userdata) {
+	nn_TraceBuffer b;
+	b.len = 0;
+	bool first = true;
+	nn_traceAppend(&b, "{\"traceEvents\":[");
+	for(size_t tid = 0; tid < count; tid++) {
+		nn_Computer *computer = computers[tid];
+		nn_Trace *t = computer->trace;
+		if(t == NULL) continue;
+		// names the track after the computer
+		if(!first) nn_traceAppend(&b, ",");
+		first = false;
+		nn_traceAppend(&b, "\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":");
+		nn_traceAppendUint(&b, tid);
+		nn_traceAppend(&b, ",\"args\":{\"name\":");
+		nn_traceAppendEscaped(&b, computer->address);
+		nn_traceAppend(&b, "}}");
+		nn_traceFlush(&b, writer, userdata);
+
+		size_t head = nn_atomicLoad(&t->head);
+		size_t from = head > t->capacity ? head - t->capacity : 0;
+		for(size_t i = from; i < head; i++) {
+			nn_TraceEvent *ev = &t->events[i % t->capacity];
+			if(nn_atomicLoad(&ev->seq) != i + 1) continue;
+			nn_TraceEvent copy = *ev;
+			// overwritten while copying
+			if(nn_atomicLoad(&ev->seq) != i + 1) continue;
+			nn_traceAppend(&b, ",\n");
+			nn_traceAppendEvent(&b, &copy, tid);
+			nn_traceFlush(&b, writer, userdata);
+		}
+	}
+	nn_traceAppend(&b, "\n],\"displayTimeUnit\":\"ms\"}\n");
+	nn_traceFlush(&b, writer, userdata);
+}
+
+nn_Exit nn_tick(nn_Computer *computer) {
+	if(computer->state == NN_CRASHED) {
+		return NN_EBADSTATE;
+	}
+	nn_resetCallBudget(computer);
+	nn_resetComponentBudgets(computer);
+	nn_clearstack(computer);
+	nn_drainInbox(computer);
+	// before the idle check, as the signals they push wake up a waiting computer
+	nn_runPolls(computer);
+	// once per tick, so the balance follows the environment
+	nn_flushEnergy(computer);
+	nn_Exit err;
+	// idling pootr
+	if(nn_isComputerIdle(computer)) {
+		// the idle time may have been added outside of a tick
+		if(!nn_atomicLoad(&computer->timerQueued)) nn_updateIdleTimer(computer);
+		return NN_OK;
+	}
+	// timed out, if it was waiting
+	nn_atomicStore(&computer->signalWaiting, false);
+	double traceStart = nn_traceNow(computer);
 	computer->idleTimestamp = nn_getUptime(computer);
 	if(computer->state == NN_BOOTUP) {
 		// init state
 		err = nn_startComputer(computer);
-		if(err) return err;
+		if(err) {
+			nn_traceSpan(computer, NN_TRACE_TICK, traceStart, NULL, NULL);
+			return err;
+		}
 	} else if(computer->state != NN_RUNNING) {
 		if(computer->state == NN_BLACKOUT) {
 			nn_setError(computer, "out of energy");
 		} else if(computer->state != NN_CRASHED) {
 			nn_setErrorFromExit(computer, NN_EBADSTATE);
 		}
+		nn_traceSpan(computer, NN_TRACE_TICK, traceStart, NULL, NULL);
 		return NN_EBADSTATE;
 	}
 	computer->state = NN_RUNNING;
@@ -1789,6 +2693,7 @@ nn_Exit nn_tick(nn_Computer *computer) {
 	req.synchronized = false;
 	req.action = NN_ARCH_TICK;
 	err = computer->arch.handler(&req);
+	nn_traceSpan(computer, NN_TRACE_TICK, traceStart, NULL, NULL);
 	if(err) {
 		computer->state = NN_CRASHED;
 		nn_setErrorFromExit(computer, err);
@@ -1799,6 +2704,7 @@ nn_Exit nn_tick(nn_Computer *computer) {
 		computer->env.handler(&envreq);
 		return err;
 	}
+	nn_updateIdleTimer(computer);
 	return NN_OK;
 }
 
@@ -1806,6 +2712,7 @@ nn_Exit nn_tickSynchronized(nn_Computer *computer) {
 	if(!nn_isComputerOn(computer)) return NN_OK;
 	// idling pootr
 	if(nn_isComputerIdle(computer)) return NN_OK;
+	double traceStart = nn_traceNow(computer);
 	nn_ArchitectureRequest req;
 	req.computer = computer;
 	req.globalState = computer->arch.state;
@@ -1813,6 +2720,7 @@ nn_Exit nn_tickSynchronized(nn_Computer *computer) {
 	req.synchronized = true;
 	req.action = NN_ARCH_TICK;
 	nn_Exit err = computer->arch.handler(&req);
+	nn_traceSpan(computer, NN_TRACE_SYNCTICK, traceStart, NULL, NULL);
 	if(err) {
 		computer->state = NN_CRASHED;
 		nn_setErrorFromExit(computer, err);
@@ -1823,9 +2731,237 @@ nn_Exit nn_tickSynchronized(nn_Computer *computer) {
 		computer->env.handler(&envreq);
 		return err;
 	}
+	nn_updateIdleTimer(computer);
+	return NN_OK;
+}
+
+// a work-stealing queue. The owner pushes and pops at the tail, thieves take from the head.
+typedef struct nn_SchedulerWorker {
+	nn_Lock *lock;
+	// indexes into the computers of the scheduler
+	size_t *tasks;
+	size_t head;
+	size_t tail;
+	nn_SchedulerStats stats;
+} nn_SchedulerWorker;
+
+struct nn_Scheduler {
+	nn_Universe *universe;
+	nn_Computer **computers;
+	size_t len;
+	size_t cap;
+	// indexes of the computers ticked this round
+	size_t *round;
+	size_t roundLen;
+	nn_SchedulerWorker *workers;
+	size_t workerCount;
+	// how many tasks of the current round are not done
+	nn_atomic_t remaining;
+};
+
+nn_Scheduler *nn_createScheduler(nn_Universe *universe, size_t maxComputers, size_t workerCount) {
+	nn_Context *ctx = &universe->ctx;
+	if(workerCount == 0) return NULL;
+	nn_Scheduler *s = nn_alloc(ctx, sizeof(*s));
+	if(s == NULL) return NULL;
+	s->universe = universe;
+	s->len = 0;
+	s->cap = maxComputers;
+	s->workerCount = workerCount;
+	s->roundLen = 0;
+	nn_atomicStore(&s->remaining, 0);
+	s->computers = nn_alloc(ctx, sizeof(nn_Computer *) * maxComputers);
+	if(s->computers == NULL) goto fail_computers;
+	s->round = nn_alloc(ctx, sizeof(size_t) * maxComputers);
+	if(s->round == NULL) goto fail_round;
+	s->workers = nn_alloc(ctx, sizeof(nn_SchedulerWorker) * workerCount);
+	if(s->workers == NULL) goto fail_workers;
+
+	size_t i = 0;
+	for(; i < workerCount; i++) {
+		nn_SchedulerWorker *w = &s->workers[i];
+		w->head = 0;
+		w->tail = 0;
+		w->tasks = nn_alloc(ctx, sizeof(size_t) * maxComputers);
+		if(w->tasks == NULL) goto fail_worker;
+		w->lock = nn_createLock(ctx);
+		if(w->lock == NULL) {
+			nn_free(ctx, w->tasks, sizeof(size_t) * maxComputers);
+			goto fail_worker;
+		}
+	}
+	nn_resetSchedulerStats(s);
+	return s;
+fail_worker:
+	while(i > 0) {
+		i--;
+		nn_destroyLock(ctx, s->workers[i].lock);
+		nn_free(ctx, s->workers[i].tasks, sizeof(size_t) * maxComputers);
+	}
+	nn_free(ctx, s->workers, sizeof(nn_SchedulerWorker) * workerCount);
+fail_workers:
+	nn_free(ctx, s->round, sizeof(size_t) * maxComputers);
+fail_round:
+	nn_free(ctx, s->computers, sizeof(nn_Computer *) * maxComputers);
+fail_computers:
+	nn_free(ctx, s, sizeof(*s));
+	return NULL;
+}
+
+void nn_destroyScheduler(nn_Scheduler *scheduler) {
+	nn_Context *ctx = &scheduler->universe->ctx;
+	for(size_t i = 0; i < scheduler->len; i++) {
+		scheduler->computers[i]->scheduler = NULL;
+		nn_destroyComputer(scheduler->computers[i]);
+	}
+	for(size_t i = 0; i < scheduler->workerCount; i++) {
+		nn_destroyLock(ctx, scheduler->workers[i].lock);
+		nn_free(ctx, scheduler->workers[i].tasks, sizeof(size_t) * scheduler->cap);
+	}
+	nn_free(ctx, scheduler->workers, sizeof(nn_SchedulerWorker) * scheduler->workerCount);
+	nn_free(ctx, scheduler->round, sizeof(size_t) * scheduler->cap);
+	nn_free(ctx, scheduler->computers, sizeof(nn_Computer *) * scheduler->cap);
+	nn_free(ctx, scheduler, sizeof(*scheduler));
+}
+
+nn_Exit nn_scheduleComputer(nn_Scheduler *scheduler, nn_Computer *computer) {
+	if(computer->scheduler != NULL) return NN_EBADSTATE;
+	if(computer->universe != scheduler->universe) return NN_EBADCALL;
+	if(scheduler->len == scheduler->cap) return NN_ELIMIT;
+	nn_retainComputer(computer);
+	computer->scheduler = scheduler;
+	computer->schedulerIndex = scheduler->len;
+	scheduler->computers[scheduler->len++] = computer;
 	return NN_OK;
 }
 
+void nn_unscheduleComputer(nn_Scheduler *scheduler, nn_Computer *computer) {
+	if(computer->scheduler != scheduler) return;
+	size_t i = computer->schedulerIndex;
+	scheduler->len--;
+	scheduler->computers[i] = scheduler->computers[scheduler->len];
+	scheduler->computers[i]->schedulerIndex = i;
+	computer->scheduler = NULL;
+	nn_destroyComputer(computer);
+}
+
+size_t nn_getScheduledCount(nn_Scheduler *scheduler) {
+	return scheduler->len;
+}
+
+size_t nn_getSchedulerWorkerCount(nn_Scheduler *scheduler) {
+	return scheduler->workerCount;
+}
+
+static bool nn_schedulerTake(nn_Scheduler *scheduler, nn_SchedulerWorker *w, bool steal, size_t *task) {
+	nn_Context *ctx = &scheduler->universe->ctx;
+	nn_lock(ctx, w->lock);
+	if(w->head == w->tail) {
+		nn_unlock(ctx, w->lock);
+		return false;
+	}
+	if(steal) {
+		*task = w->tasks[w->head++];
+	} else {
+		*task = w->tasks[--w->tail];
+	}
+	nn_unlock(ctx, w->lock);
+	return true;
+}
+
+static size_t nn_schedulerWork(nn_Scheduler *scheduler, size_t worker) {
+	nn_Context *ctx = &scheduler->universe->ctx;
+	nn_SchedulerWorker *w = &scheduler->workers[worker];
+	size_t ran = 0;
+	while(true) {
+		size_t task;
+		bool stolen = false;
+		if(nn_schedulerTake(scheduler, w, false, &task)) goto found;
+		// start with the next worker, so thieves spread out
+		for(size_t i = 1; i < scheduler->workerCount; i++) {
+			nn_SchedulerWorker *victim = &scheduler->workers[(worker + i) % scheduler->workerCount];
+			if(nn_schedulerTake(scheduler, victim, true, &task)) {
+				stolen = true;
+				goto found;
+			}
+		}
+		return ran;
+	found:;
+		double start = nn_currentTime(ctx);
+		nn_tick(scheduler->computers[task]);
+		w->stats.busyTime += nn_currentTime(ctx) - start;
+		w->stats.ticks++;
+		if(stolen) w->stats.steals++;
+		ran++;
+		nn_decRef(&scheduler->remaining, 1);
+	}
+}
+
+size_t nn_runSchedulerWorker(nn_Scheduler *scheduler, size_t worker) {
+	if(worker == 0 || worker >= scheduler->workerCount) return 0;
+	return nn_schedulerWork(scheduler, worker);
+}
+
+void nn_tickScheduler(nn_Scheduler *scheduler) {
+	nn_Universe *u = scheduler->universe;
+	nn_Context *ctx = &u->ctx;
+	double start = nn_currentTime(ctx);
+
+	// the computers whose timer expired join the active set, which is all this round looks at
+	scheduler->roundLen = 0;
+	nn_lock(ctx, u->timerLock);
+	nn_timerPoll(u, NULL, (size_t)-1);
+	for(nn_Computer *c = u->activeHead; c != NULL; c = c->activeNext) {
+		if(c->scheduler != scheduler) continue;
+		if(c->state != NN_BOOTUP && c->state != NN_RUNNING) continue;
+		scheduler->round[scheduler->roundLen++] = c->schedulerIndex;
+	}
+	nn_unlock(ctx, u->timerLock);
+
+	// workers may still be looking for work from the last round, so the queues are filled while locked
+	for(size_t i = 0; i < scheduler->workerCount; i++) {
+		nn_lock(ctx, scheduler->workers[i].lock);
+		scheduler->workers[i].head = 0;
+		scheduler->workers[i].tail = 0;
+	}
+	for(size_t i = 0; i < scheduler->roundLen; i++) {
+		nn_SchedulerWorker *w = &scheduler->workers[i % scheduler->workerCount];
+		w->tasks[w->tail++] = scheduler->round[i];
+	}
+	nn_atomicStore(&scheduler->remaining, scheduler->roundLen);
+	for(size_t i = 0; i < scheduler->workerCount; i++) {
+		nn_unlock(ctx, scheduler->workers[i].lock);
+	}
+
+	// help out until the stragglers are done
+	while(nn_atomicLoad(&scheduler->remaining) > 0) {
+		nn_schedulerWork(scheduler, 0);
+	}
+
+	for(size_t i = 0; i < scheduler->roundLen; i++) {
+		nn_tickSynchronized(scheduler->computers[scheduler->round[i]]);
+	}
+
+	double elapsed = nn_currentTime(ctx) - start;
+	for(size_t i = 0; i < scheduler->workerCount; i++) {
+		scheduler->workers[i].stats.roundTime += elapsed;
+	}
+}
+
+void nn_getSchedulerStats(nn_Scheduler *scheduler, size_t worker, nn_SchedulerStats *stats) {
+	*stats = scheduler->workers[worker].stats;
+}
+
+void nn_resetSchedulerStats(nn_Scheduler *scheduler) {
+	for(size_t i = 0; i < scheduler->workerCount; i++) {
+		nn_SchedulerStats *stats = &scheduler->workers[i].stats;
+		stats->ticks = 0;
+		stats->steals = 0;
+		stats->busyTime = 0;
+		stats->roundTime = 0;
+	}
+}
+
 static nn_Exit nn_defaultComponent(nn_ComponentRequest *request) {
 	return NN_OK;
 }
@@ -1853,6 +2989,7 @@ nn_Component *nn_createComponent(nn_Universe *universe, const char *address, con
 		c->address = nn_strdup(ctx, address);
 		if(c->address == NULL) goto fail;
 	}
+	c->addressHash = nn_strhash(c->address);
 
 	c->type = nn_strdup(ctx, type);
 	if(c->type == NULL) goto fail;
@@ -1927,8 +3064,9 @@ nn_Exit nn_setComponentMethods(nn_Component *c, const nn_Method *methods) {
 
 nn_Exit nn_setComponentMethodsArray(nn_Component *c, const nn_Method *methods, size_t count) {
 	nn_Context *ctx = &c->universe->ctx;
-	nn_Exit e = nn_hashInit(&c->methodsMap, count, ctx, &nn_methodHasher);
-	if(e) return e;
+	nn_hashDeinit(&c->methodsMap);
+	nn_hashInit(&c->methodsMap, count, ctx, &nn_methodHasher);
+	if(nn_hashReserve(&c->methodsMap, count)) goto fail;
 	nn_ardestroy(&c->methodArena);
 	nn_arinit(&c->methodArena, ctx);
 	for(size_t i = 0; i < count; i++) {
@@ -1943,7 +3081,7 @@ nn_Exit nn_setComponentMethodsArray(nn_Component *c, const nn_Method *methods, s
 			.flags = methods[i].flags,
 			.idx = i,
 		};
-		if(!nn_hashPut(&c->methodsMap, &method)) goto fail;
+		if(nn_hashPut(&c->methodsMap, &method)) goto fail;
 	}
 	c->methodCount = count;
 	return NN_OK;
@@ -2023,24 +3161,24 @@ void nn_getComponentMethods(nn_Component *c, const char **methodnames, size_t *l
 	*len = enabled;
 }
 
-bool nn_hasComponentMethod(nn_Component *c,
-    const char *method)
-{
-    nn_MethodEntry *ent =
-        nn_getComponentMethodEntry(c, method);
-    if(ent == NULL) return false;
-
-    nn_ComponentRequest req;
-    req.ctx = &c->universe->ctx;
-    req.computer = NULL;
-    req.state = c->state;
-    req.classState = c->classState; // Don't remove it. It segfaults.
+static bool nn_isMethodIdxEnabled(nn_Component *c, unsigned int idx) {
+	nn_ComponentRequest req;
+	req.ctx = &c->universe->ctx;
+	req.computer = NULL;
+	req.state = c->state;
+	req.classState = c->classState; // Don't remove it. It segfaults.
 	req.compAddress = c->address;
-    req.action = NN_COMP_CHECKMETHOD;
-    req.methodIdx = ent->idx;
-    req.methodEnabled = true;
-    c->handler(&req);
-    return req.methodEnabled;
+	req.action = NN_COMP_CHECKMETHOD;
+	req.methodIdx = idx;
+	req.methodEnabled = true;
+	c->handler(&req);
+	return req.methodEnabled;
+}
+
+bool nn_hasComponentMethod(nn_Component *c, const char *method) {
+	nn_MethodEntry *ent = nn_getComponentMethodEntry(c, method);
+	if(ent == NULL) return false;
+	return nn_isMethodIdxEnabled(c, ent->idx);
 }
 
 const char *nn_getComponentDoc(nn_Component *c, const char *method) {
@@ -2088,14 +3226,15 @@ static nn_Exit nn_pushComponentRemoved(nn_Computer *c, const char *address, cons
 }
 
 nn_Exit nn_mountComponent(nn_Computer *c, nn_Component *comp, int slot, bool silent) {
-	if(nn_getComponent(c, comp->address) != NULL) return NN_EBADSTATE;
+	if(nn_getComponentHashed(c, comp->address, comp->addressHash) != NULL) return NN_EBADSTATE;
 
 	nn_ComponentEntry ent = {
 		.address = comp->address,
 		.comp = comp,
 		.slot = slot,
 	};
-	if(!nn_hashPut(&c->components, &ent)) return NN_ELIMIT;
+	nn_Exit e = nn_hashPutH(&c->components, &ent, comp->addressHash);
+	if(e) return e;
 	nn_retainComponent(comp);
 	if(c->state == NN_RUNNING && !silent) {
 		return nn_pushComponentAdded(c, comp->address, comp->type);
@@ -2104,7 +3243,8 @@ nn_Exit nn_mountComponent(nn_Computer *c, nn_Component *comp, int slot, bool sil
 }
 
 nn_Exit nn_unmountComponent(nn_Computer *c, const char *address, bool silent) {
-	nn_Component *comp = nn_getComponent(c, address);
+	size_t hash = nn_strhash(address);
+	nn_Component *comp = nn_getComponentHashed(c, address, hash);
 	if(comp == NULL) return NN_OK;
 
 	for(size_t i = 0; i < NN_MAX_USERDATA; i++) {
@@ -2115,7 +3255,8 @@ nn_Exit nn_unmountComponent(nn_Computer *c, const char *address, bool silent) {
 	}
 
 	nn_ComponentEntry lookingFor = {.address = address};
-	nn_hashRemove(&c->components, &lookingFor);
+	nn_hashRemoveH(&c->components, &lookingFor, hash);
+	c->mountGeneration++;
 
 	nn_Exit e = NN_OK;
 	if(c->state == NN_RUNNING && !silent) {
@@ -2156,6 +3297,36 @@ nn_Component *nn_getComponent(nn_Computer *c, const char *address) {
 	return ent->comp;
 }
 
+nn_Component *nn_getComponentHashed(nn_Computer *c, const char *address, size_t hash) {
+	nn_ComponentEntry ent = {
+		.address = address,
+	};
+	nn_ComponentEntry *found = nn_hashGetH(&c->components, &ent, hash);
+	if(found == NULL) return NULL;
+	return found->comp;
+}
+
+nn_Exit nn_pollComponentAt(nn_Computer *c, nn_Component *comp, double at) {
+	for(size_t i = 0; i < c->pollCount; i++) {
+		if(c->polls[i].component != comp) continue;
+		c->polls[i].at = at;
+		goto wake;
+	}
+	if(c->pollCount == NN_MAX_POLLS) return NN_ELIMIT;
+	nn_retainComponent(comp);
+	c->polls[c->pollCount].component = comp;
+	c->polls[c->pollCount].at = at;
+	c->pollCount++;
+wake:
+	// may be called while it waits, from another poll
+	if(nn_atomicLoad(&c->signalWaiting) && at < c->idleTimestamp) c->idleTimestamp = at;
+	return NN_OK;
+}
+
+size_t nn_getPendingPollCount(nn_Computer *c) {
+	return c->pollCount;
+}
+
 int nn_getComponentSlot(nn_Computer *c, const char *address) {
 	nn_ComponentEntry *ent = nn_getComponentEntry(c, address);
 	if(ent == NULL) return -1;
@@ -2176,17 +3347,216 @@ void nn_getComponents(nn_Computer *c, const char **components) {
 	}
 }
 
-nn_Exit nn_invokeComponent(nn_Computer *computer, const char *compAddress, const char *method) {
-	nn_Component *c = nn_getComponent(computer, compAddress);
+// open addressing, so twice the entries
+#define NN_PROFILE_SLOTS (NN_MAX_PROFILE * 2)
+
+typedef struct nn_Profiler {
+	nn_Profile profile;
+	// per slot, the entry index + 1, or 0 if free
+	unsigned short slots[NN_PROFILE_SLOTS];
+	size_t hashes[NN_MAX_PROFILE];
+	// component methods are keyed by index, userdata methods by name
+	unsigned int methodIdx[NN_MAX_PROFILE];
+} nn_Profiler;
+
+// what a call looked like before it ran
+typedef struct nn_ProfileScope {
+	double start;
+	double budget;
+	double energy;
+} nn_ProfileScope;
+
+nn_Exit nn_setProfiling(nn_Computer *computer, bool enabled) {
+	nn_Context *ctx = &computer->universe->ctx;
+	if(!enabled) {
+		if(computer->profiler != NULL) nn_free(ctx, computer->profiler, sizeof(*computer->profiler));
+		computer->profiler = NULL;
+		return NN_OK;
+	}
+#ifdef NN_PROFILE
+	if(computer->profiler != NULL) return NN_OK;
+	computer->profiler = nn_alloc(ctx, sizeof(*computer->profiler));
+	if(computer->profiler == NULL) return NN_ENOMEM;
+	nn_resetProfile(computer);
+	return NN_OK;
+#else
+	return NN_EBADSTATE;
+#endif
+}
+
+const nn_Profile *nn_getProfile(nn_Computer *computer) {
+	if(computer->profiler == NULL) return NULL;
+	computer->profiler->profile.windowTime = nn_currentTime(&computer->universe->ctx) - computer->profiler->profile.windowStart;
+	return &computer->profiler->profile;
+}
+
+void nn_resetProfile(nn_Computer *computer) {
+	nn_Profiler *p = computer->profiler;
+	if(p == NULL) return;
+	p->profile.windowStart = nn_currentTime(&computer->universe->ctx);
+	p->profile.windowTime = 0;
+	p->profile.len = 0;
+	p->profile.dropped = 0;
+	for(size_t i = 0; i < NN_PROFILE_SLOTS; i++) p->slots[i] = 0;
+}
+
+// The histogram has 4 buckets per power of 2, starting at 2^NN_PROFILE_MINEXP ns.
+#define NN_PROFILE_MINEXP 8
+
+// the upper bound of a bucket, in seconds
+static double nn_profileBucketLimit(size_t bucket) {
+	bucket++;
+	size_t e = NN_PROFILE_MINEXP + bucket / 4;
+	return (double)((4 + bucket % 4) * (1ull << (e - 2))) / 1e9;
+}
+
+double nn_getProfilePercentile(const nn_ProfileEntry *entry, double percentile) {
+	if(entry->calls == 0) return 0;
+	size_t want = entry->calls * percentile;
+	if(want >= entry->calls) want = entry->calls - 1;
+	size_t seen = 0;
+	for(size_t i = 0; i < NN_PROFILE_BUCKETS; i++) {
+		seen += entry->latency[i];
+		if(seen > want) {
+			// the last bucket is unbounded
+			if(i == NN_PROFILE_BUCKETS - 1) return entry->maxTime;
+			return nn_profileBucketLimit(i);
+		}
+	}
+	return entry->maxTime;
+}
+
+#ifdef NN_PROFILE
+static size_t nn_profileBucket(double seconds) {
+	double ns = seconds * 1e9;
+	if(ns < (1 << NN_PROFILE_MINEXP)) return 0;
+	if(ns >= 1e18) return NN_PROFILE_BUCKETS - 1;
+	unsigned long long v = ns;
+	size_t e = NN_PROFILE_MINEXP;
+	while((v >> (e + 1)) != 0) e++;
+	size_t bucket = (e - NN_PROFILE_MINEXP) * 4 + ((v >> (e - 2)) & 3);
+	if(bucket >= NN_PROFILE_BUCKETS) bucket = NN_PROFILE_BUCKETS - 1;
+	return bucket;
+}
+
+static void nn_profileCopyName(char name[NN_MAX_PROFILENAME], const char *s) {
+	size_t i = 0;
+	for(; s != NULL && s[i] != '\0' && i < NN_MAX_PROFILENAME - 1; i++) name[i] = s[i];
+	name[i] = '\0';
+}
+
+// finds the entry, or makes it. Returns NULL if there is no space.
+// [method] is only used for userdata, or to name new entries.
+static nn_ProfileEntry *nn_profileEntry(nn_Profiler *p, nn_Component *c, unsigned int methodIdx, const char *method, bool userdata) {
+	size_t hash = nn_strhash(c->type) ^ (userdata ? nn_strhash(method) : methodIdx * 0x9E3779B97F4A7C15ull);
+	for(size_t i = 0; i < NN_PROFILE_SLOTS; i++) {
+		size_t slot = (hash + i) % NN_PROFILE_SLOTS;
+		size_t idx = p->slots[slot];
+		if(idx == 0) {
+			if(p->profile.len == NN_MAX_PROFILE) return NULL;
+			idx = p->profile.len++;
+			p->slots[slot] = idx + 1;
+			p->hashes[idx] = hash;
+			p->methodIdx[idx] = methodIdx;
+			nn_ProfileEntry *ent = &p->profile.entries[idx];
+			if(!userdata) {
+				// only the index is known
+				method = NULL;
+				for(nn_MethodEntry *m = nn_hashIterate(&c->methodsMap, NULL); m != NULL; m = nn_hashIterate(&c->methodsMap, m)) {
+					if(m->idx == methodIdx) method = m->name;
+				}
+			}
+			nn_profileCopyName(ent->type, c->type);
+			nn_profileCopyName(ent->method, method);
+			ent->userdata = userdata;
+			ent->calls = 0;
+			ent->errors = 0;
+			ent->time = 0;
+			ent->maxTime = 0;
+			ent->budget = 0;
+			ent->energy = 0;
+			for(size_t j = 0; j < NN_PROFILE_BUCKETS; j++) ent->latency[j] = 0;
+			return ent;
+		}
+		idx--;
+		if(p->hashes[idx] != hash) continue;
+		nn_ProfileEntry *ent = &p->profile.entries[idx];
+		if(ent->userdata != userdata || nn_strcmp(ent->type, c->type) != 0) continue;
+		if(userdata ? nn_strcmp(ent->method, method) == 0 : p->methodIdx[idx] == methodIdx) return ent;
+	}
+	return NULL;
+}
+
+static void nn_profileBegin(nn_Computer *computer, nn_ProfileScope *scope) {
+	if(computer->profiler == NULL) return;
+	scope->budget = computer->callBudget;
+	scope->energy = computer->energySpent;
+	scope->start = nn_currentTime(&computer->universe->ctx);
+}
+
+static void nn_profileEnd(nn_Computer *computer, nn_ProfileScope *scope, nn_Component *c, unsigned int methodIdx, const char *method, nn_Exit e) {
+	nn_Profiler *p = computer->profiler;
+	if(p == NULL) return;
+	double time = nn_currentTime(&computer->universe->ctx) - scope->start;
+	if(time < 0) time = 0;
+	nn_ProfileEntry *ent = nn_profileEntry(p, c, methodIdx, method, method != NULL);
+	if(ent == NULL) {
+		p->profile.dropped++;
+		return;
+	}
+	ent->calls++;
+	if(e) ent->errors++;
+	ent->time += time;
+	if(time > ent->maxTime) ent->maxTime = time;
+	ent->latency[nn_profileBucket(time)]++;
+	ent->budget += scope->budget - computer->callBudget;
+	ent->energy += computer->energySpent - scope->energy;
+}
+#endif
+
+nn_Exit nn_resolveMethod(nn_Computer *computer, const char *compAddress, const char *method, nn_MethodHandle *handle) {
+	return nn_resolveMethodHashed(computer, compAddress, nn_strhash(compAddress), method, handle);
+}
+
+nn_Exit nn_resolveMethodHashed(nn_Computer *computer, const char *compAddress, size_t hash, const char *method, nn_MethodHandle *handle) {
+	nn_Component *c = nn_getComponentHashed(computer, compAddress, hash);
 	if(c == NULL) {
 		nn_setError(computer, "no such component");
 		return NN_EBADCALL;
 	}
-	if(!nn_hasComponentMethod(c, method)) {
+	nn_MethodEntry *m = nn_getComponentMethodEntry(c, method);
+	if(m == NULL) {
+		nn_setError(computer, "no such method");
+		return NN_EBADCALL;
+	}
+	handle->computer = computer;
+	handle->component = c;
+	handle->generation = computer->mountGeneration;
+	handle->methodIdx = m->idx;
+	handle->method = m->name;
+	handle->flags = m->flags;
+	return NN_OK;
+}
+
+bool nn_isMethodHandleValid(nn_Computer *computer, const nn_MethodHandle *handle) {
+	// generations are per computer, so one from another computer could match
+	return handle->component != NULL && handle->computer == computer && handle->generation == computer->mountGeneration;
+}
+
+nn_MethodFlags nn_getMethodHandleFlags(const nn_MethodHandle *handle) {
+	return handle->flags;
+}
+
+nn_Exit nn_invokeHandle(nn_Computer *computer, const nn_MethodHandle *handle) {
+	if(!nn_isMethodHandleValid(computer, handle)) {
+		nn_setError(computer, "stale method handle");
+		return NN_EBADCALL;
+	}
+	nn_Component *c = handle->component;
+	if(!nn_isMethodIdxEnabled(c, handle->methodIdx)) {
 		nn_setError(computer, "no such method");
 		return NN_EBADCALL;
 	}
-	nn_MethodEntry *m = nn_getComponentMethodEntry(c, method);
 
 	while(nn_getstacksize(computer) > 0) {
 		if(!nn_isnull(computer, nn_getstacksize(computer) - 1)) break;
@@ -2202,9 +3572,19 @@ nn_Exit nn_invokeComponent(nn_Computer *computer, const char *compAddress, const
 	req.classState = c->classState;
 	req.compAddress = c->address;
 	req.action = NN_COMP_INVOKE;
-	req.methodIdx = m->idx;
+	req.methodIdx = handle->methodIdx;
 	req.returnCount = 0;
+	computer->invokeCount++;
+	double traceStart = nn_traceNow(computer);
+#ifdef NN_PROFILE
+	nn_ProfileScope scope;
+	nn_profileBegin(computer, &scope);
+#endif
 	nn_Exit e = c->handler(&req);
+#ifdef NN_PROFILE
+	nn_profileEnd(computer, &scope, c, handle->methodIdx, NULL, e);
+#endif
+	nn_traceSpan(computer, NN_TRACE_INVOKE, traceStart, handle->method, c->address);
 	if(e) {
 		if(e != NN_EBADCALL) nn_setErrorFromExit(computer, e);
 		nn_clearstack(computer);
@@ -2228,6 +3608,76 @@ nn_Exit nn_invokeComponent(nn_Computer *computer, const char *compAddress, const
 	return NN_OK;
 }
 
+nn_Exit nn_invokeBatch(nn_Computer *computer, nn_BatchCall *calls, size_t count, size_t *done) {
+	*done = 0;
+	if(count > NN_MAX_BATCH) return NN_ELIMIT;
+	size_t argTotal = 0;
+	for(size_t i = 0; i < count; i++) argTotal += calls[i].argc;
+	if(argTotal != computer->stackSize) return NN_EBADSTATE;
+
+	// Results are stored from the start of batchValues, and the pending
+	// arguments at its end, so they only collide when the results could
+	// not fit on the stack anyway.
+	nn_Value *parked = computer->batchValues;
+	size_t argStart = NN_MAX_STACK - argTotal;
+	for(size_t i = 0; i < argTotal; i++) parked[argStart + i] = computer->callstack[i];
+	computer->stackSize = 0;
+	computer->batching = true;
+
+	nn_Exit e = NN_OK;
+	size_t resultLen = 0;
+	size_t i = 0;
+	for(; i < count; i++) {
+		size_t argc = calls[i].argc;
+		for(size_t j = 0; j < argc; j++) computer->callstack[j] = parked[argStart + j];
+		computer->stackSize = argc;
+		argStart += argc;
+		calls[i].retc = 0;
+
+		e = nn_invokeHandle(computer, calls[i].handle);
+		if(e) {
+			// a stale handle leaves its arguments
+			nn_clearstack(computer);
+			i++;
+			break;
+		}
+		size_t retc = computer->stackSize;
+		if(resultLen + retc > argStart) {
+			nn_setError(computer, "too many batch results");
+			nn_clearstack(computer);
+			e = NN_EBADCALL;
+			i++;
+			break;
+		}
+		for(size_t j = 0; j < retc; j++) parked[resultLen + j] = computer->callstack[j];
+		resultLen += retc;
+		computer->stackSize = 0;
+		calls[i].retc = retc;
+		(*done)++;
+		if(nn_componentsOverused(computer)) {
+			i++;
+			break;
+		}
+	}
+
+	// arguments of the calls which never ran
+	for(; i < count; i++) {
+		for(size_t j = 0; j < calls[i].argc; j++) nn_dropValue(parked[argStart + j]);
+		argStart += calls[i].argc;
+	}
+	for(size_t j = 0; j < resultLen; j++) computer->callstack[j] = parked[j];
+	computer->stackSize = resultLen;
+	computer->batching = false;
+	return e;
+}
+
+nn_Exit nn_invokeComponent(nn_Computer *computer, const char *compAddress, const char *method) {
+	nn_MethodHandle handle;
+	nn_Exit e = nn_resolveMethod(computer, compAddress, method, &handle);
+	if(e) return e;
+	return nn_invokeHandle(computer, &handle);
+}
+
 int nn_allocUserdata(nn_Computer *computer, void *state, const char *compAddress) {
 	for(size_t i = 0; i < NN_MAX_USERDATA; i++) {
 		if(nn_isUserdataValid(computer, i)) continue;
@@ -2235,6 +3685,7 @@ int nn_allocUserdata(nn_Computer *computer, void *state, const char *compAddress
 		if(comp == NULL) return -1;
 		computer->uservals[i].state = state;
 		computer->uservals[i].compAddress = comp;
+		computer->uservals[i].compHash = nn_strhash(comp);
 		return i;
 	}
 	return -1;
@@ -2251,7 +3702,7 @@ void nn_freeUserdata(nn_Computer *computer, size_t userdata) {
 		.action = NN_USER_DROP,
 	};
 
-	nn_Component *c = nn_getComponent(computer, user->compAddress);
+	nn_Component *c = nn_getComponentHashed(computer, user->compAddress, user->compHash);
 	// really, we should *panic*, as this is a BAD state
 	if(c == NULL) return;
 
@@ -2309,7 +3760,7 @@ bool nn_getUserdataMethod(nn_Computer *computer, size_t userdata, size_t idx, nn
 		.getmethod.idx = idx,
 	};
 
-	nn_Component *c = nn_getComponent(computer, user->compAddress);
+	nn_Component *c = nn_getComponentHashed(computer, user->compAddress, user->compHash);
 	// really, we should *panic*, as this is a BAD state
 	if(c == NULL) return true;
 
@@ -2342,7 +3793,7 @@ nn_Exit nn_invokeUserdata(nn_Computer *computer, size_t userdata, const char *me
 		.invoke.returnCount = 0,
 	};
 
-	nn_Component *c = nn_getComponent(computer, user->compAddress);
+	nn_Component *c = nn_getComponentHashed(computer, user->compAddress, user->compHash);
 	// really, we should *panic*, as this is a BAD state
 	if(c == NULL) return true;
 
@@ -2363,8 +3814,18 @@ nn_Exit nn_invokeUserdata(nn_Computer *computer, size_t userdata, const char *me
 		nn_pop(computer);
 	}
 
+	computer->invokeCount++;
+	double traceStart = nn_traceNow(computer);
+#ifdef NN_PROFILE
+	nn_ProfileScope scope;
+	nn_profileBegin(computer, &scope);
+#endif
 	// errors in here are catastrophic
 	nn_Exit e = c->handler(&creq);
+#ifdef NN_PROFILE
+	nn_profileEnd(computer, &scope, c, 0, method, e);
+#endif
+	nn_traceSpan(computer, NN_TRACE_INVOKE, traceStart, method, c->address);
 	if(e) {
 		if(e != NN_EBADCALL) nn_setErrorFromExit(computer, e);
 		nn_clearstack(computer);
@@ -2400,7 +3861,7 @@ nn_Exit nn_serializeUserdata(nn_Computer *computer, size_t userdata) {
 		.action = NN_USER_SERIALIZE,
 	};
 
-	nn_Component *c = nn_getComponent(computer, user->compAddress);
+	nn_Component *c = nn_getComponentHashed(computer, user->compAddress, user->compHash);
 	// really, we should *panic*, as this is a BAD state
 	if(c == NULL) return true;
 
@@ -2471,9 +3932,520 @@ nn_Exit nn_deserializeUserdata(nn_Computer *computer, size_t userdata, const cha
 
 	user->state = ureq.state;
 	user->compAddress = compAddr;
+	user->compHash = nn_strhash(compAddr);
+	return NN_OK;
+}
+
+// Snapshots are a header, then every section in a fixed order.
+// Like the network encoding, they use the native sizes and endianness, which the header records.
+#define NN_SNAPSHOT_MAGIC "NNSS"
+// written as a size_t, so a snapshot with another endianness is rejected
+#define NN_SNAPSHOT_ENDIAN ((size_t)0x0102)
+// a NULL string
+#define NN_SNAPSHOT_NULL ((size_t)-1)
+
+// how deeply tables in queued signals may nest
+#define NN_SNAPSHOT_DEPTH 64
+
+static size_t nn_sizeOfNetworkValue(nn_Value val);
+static size_t nn_encodeNetworkValue(nn_Value val, char *buf);
+static bool nn_checkNetworkValue(const char *buf, size_t len, size_t depth, size_t *used);
+
+typedef struct nn_SnapWriter {
+	nn_Context *ctx;
+	char *buf;
+	size_t len;
+	size_t cap;
+	nn_Exit err;
+} nn_SnapWriter;
+
+// reserves [len] bytes, returning NULL if it ran out of memory
+static char *nn_snapReserve(nn_SnapWriter *w, size_t len) {
+	if(w->err) return NULL;
+	if(w->len + len > w->cap) {
+		size_t newCap = w->cap == 0 ? 256 : w->cap;
+		while(newCap < w->len + len) newCap *= 2;
+		char *newBuf = nn_realloc(w->ctx, w->buf, w->cap, newCap);
+		if(newBuf == NULL) {
+			w->err = NN_ENOMEM;
+			return NULL;
+		}
+		w->buf = newBuf;
+		w->cap = newCap;
+	}
+	char *p = w->buf + w->len;
+	w->len += len;
+	return p;
+}
+
+static void nn_snapBytes(nn_SnapWriter *w, const void *data, size_t len) {
+	char *p = nn_snapReserve(w, len);
+	if(p != NULL) nn_memcpy(p, data, len);
+}
+
+static void nn_snapSize(nn_SnapWriter *w, size_t n) {
+	nn_snapBytes(w, &n, sizeof(n));
+}
+
+static void nn_snapNumber(nn_SnapWriter *w, double n) {
+	nn_snapBytes(w, &n, sizeof(n));
+}
+
+static void nn_snapLString(nn_SnapWriter *w, const char *s, size_t len) {
+	if(s == NULL) {
+		nn_snapSize(w, NN_SNAPSHOT_NULL);
+		return;
+	}
+	nn_snapSize(w, len);
+	nn_snapBytes(w, s, len);
+}
+
+static void nn_snapString(nn_SnapWriter *w, const char *s) {
+	nn_snapLString(w, s, s == NULL ? 0 : nn_strlen(s));
+}
+
+// writes the string a handler pushed and pops it, or NULL if it pushed nothing
+static void nn_snapPopString(nn_SnapWriter *w, nn_Computer *computer, size_t stackBase) {
+	if(nn_getstacksize(computer) <= stackBase || !nn_isstring(computer, nn_getstacksize(computer) - 1)) {
+		while(nn_getstacksize(computer) > stackBase) nn_pop(computer);
+		nn_snapString(w, NULL);
+		return;
+	}
+	size_t len;
+	const char *s = nn_tolstring(computer, nn_getstacksize(computer) - 1, &len);
+	nn_snapLString(w, s, len);
+	nn_pop(computer);
+}
+
+typedef struct nn_SnapReader {
+	const char *buf;
+	size_t len;
+	size_t off;
+	bool bad;
+} nn_SnapReader;
+
+// returns NULL if there are not [len] bytes left
+static const char *nn_snapRead(nn_SnapReader *r, size_t len) {
+	if(r->bad || r->len - r->off < len) {
+		r->bad = true;
+		return NULL;
+	}
+	const char *p = r->buf + r->off;
+	r->off += len;
+	return p;
+}
+
+static size_t nn_snapReadSize(nn_SnapReader *r) {
+	size_t n = 0;
+	const char *p = nn_snapRead(r, sizeof(n));
+	if(p != NULL) nn_memcpy(&n, p, sizeof(n));
+	return n;
+}
+
+static double nn_snapReadNumber(nn_SnapReader *r) {
+	double n = 0;
+	const char *p = nn_snapRead(r, sizeof(n));
+	if(p != NULL) nn_memcpy(&n, p, sizeof(n));
+	return n;
+}
+
+// the strings are not terminated, *len is set to NN_SNAPSHOT_NULL for NULL
+static const char *nn_snapReadString(nn_SnapReader *r, size_t *len) {
+	*len = nn_snapReadSize(r);
+	if(*len == NN_SNAPSHOT_NULL) return NULL;
+	return nn_snapRead(r, *len);
+}
+
+// copies a string of the snapshot, so it can be passed to functions which want it terminated
+static char *nn_snapReadStringCopy(nn_SnapReader *r, char *buf, size_t bufsize) {
+	size_t len;
+	const char *s = nn_snapReadString(r, &len);
+	if(len == NN_SNAPSHOT_NULL) return NULL;
+	if(s == NULL || len >= bufsize) {
+		r->bad = true;
+		return NULL;
+	}
+	nn_memcpy(buf, s, len);
+	buf[len] = '\0';
+	return buf;
+}
+
+nn_Exit nn_snapshotComputer(nn_Computer *computer, char **buf, size_t *len) {
+	nn_Context *ctx = &computer->universe->ctx;
+	// their completions would be lost
+	if(computer->pollCount > 0) return NN_EBADSTATE;
+	nn_SnapWriter w = {
+		.ctx = ctx,
+		.buf = NULL,
+		.len = 0,
+		.cap = 0,
+		.err = NN_OK,
+	};
+	// posted signals are part of the queue as well
+	nn_drainInbox(computer);
+	size_t stackBase = nn_getstacksize(computer);
+
+	nn_snapBytes(&w, NN_SNAPSHOT_MAGIC, 4);
+	nn_snapSize(&w, NN_SNAPSHOT_VERSION);
+	nn_snapSize(&w, NN_SNAPSHOT_ENDIAN);
+	nn_snapSize(&w, sizeof(double));
+
+	bool on = nn_isComputerOn(computer);
+	nn_snapSize(&w, computer->state);
+	nn_snapSize(&w, on);
+	nn_snapString(&w, computer->arch.name);
+	nn_snapNumber(&w, nn_getUptime(computer));
+	nn_snapNumber(&w, computer->idleTimestamp);
+	nn_snapSize(&w, nn_atomicLoad(&computer->signalWaiting));
+
+	nn_snapNumber(&w, computer->totalEnergy);
+	nn_snapSize(&w, computer->energyLedger);
+	nn_snapNumber(&w, computer->energyBalance);
+	nn_snapNumber(&w, computer->energyPending);
+	nn_snapNumber(&w, computer->energyThreshold);
+	nn_snapNumber(&w, computer->totalCallBudget);
+	nn_snapNumber(&w, computer->directCost);
+
+	nn_snapString(&w, computer->tmpaddress);
+	nn_snapSize(&w, computer->userCount);
+	for(size_t i = 0; i < computer->userCount; i++) nn_snapString(&w, computer->users[i]);
+
+	nn_snapSize(&w, computer->deviceInfo.len);
+	for(size_t i = 0; i < computer->deviceInfo.len; i++) {
+		nn_DeviceInfoEntry *ent = &computer->deviceInfo.entries[i];
+		nn_snapString(&w, ent->address);
+		nn_snapSize(&w, ent->len);
+		for(size_t j = 0; j < ent->len; j++) {
+			nn_snapString(&w, ent->fields[j].name);
+			nn_snapString(&w, ent->fields[j].value);
+		}
+	}
+
+	nn_snapSize(&w, computer->components.len);
+	for(nn_ComponentEntry *ent = nn_hashIterate(&computer->components, NULL); ent != NULL; ent = nn_hashIterate(&computer->components, ent)) {
+		nn_snapString(&w, ent->address);
+		nn_snapSize(&w, ent->slot);
+	}
+
+	// every signal is its value count, then its values in the network encoding
+	nn_snapSize(&w, computer->signalCount);
+	for(size_t i = 0; i < computer->signalCount; i++) {
+		nn_Signal s = computer->signals[(computer->signalHead + i) % NN_MAX_SIGNALS];
+		size_t size = 0;
+		for(size_t j = 0; j < s.len; j++) size += nn_sizeOfNetworkValue(computer->signalValues[(s.start + j) % NN_MAX_SIGNALVALUES]);
+		nn_snapSize(&w, s.len);
+		nn_snapSize(&w, size);
+		char *p = nn_snapReserve(&w, size);
+		if(p == NULL) break;
+		for(size_t j = 0; j < s.len; j++) p += nn_encodeNetworkValue(computer->signalValues[(s.start + j) % NN_MAX_SIGNALVALUES], p);
+	}
+
+	size_t userdataCount = 0;
+	for(size_t i = 0; i < NN_MAX_USERDATA; i++) userdataCount += nn_isUserdataValid(computer, i);
+	nn_snapSize(&w, userdataCount);
+	for(size_t i = 0; i < NN_MAX_USERDATA && !w.err; i++) {
+		if(!nn_isUserdataValid(computer, i)) continue;
+		nn_snapSize(&w, i);
+		nn_snapString(&w, computer->uservals[i].compAddress);
+		nn_Exit e = nn_serializeUserdata(computer, i);
+		if(e) {
+			w.err = e;
+			break;
+		}
+		nn_snapPopString(&w, computer, stackBase);
+	}
+
+	if(on && !w.err) {
+		nn_ArchitectureRequest req;
+		req.computer = computer;
+		req.action = NN_ARCH_SERIALIZE;
+		req.globalState = computer->arch.state;
+		req.localState = computer->archState;
+		nn_Exit e = computer->arch.handler(&req);
+		if(e) w.err = e;
+		else nn_snapPopString(&w, computer, stackBase);
+	}
+
+	if(w.err) {
+		while(nn_getstacksize(computer) > stackBase) nn_pop(computer);
+		nn_free(ctx, w.buf, w.cap);
+		return w.err;
+	}
+	// no need to keep the spare capacity around
+	char *exact = nn_realloc(ctx, w.buf, w.cap, w.len);
+	if(exact == NULL) {
+		nn_free(ctx, w.buf, w.cap);
+		return NN_ENOMEM;
+	}
+	*buf = exact;
+	*len = w.len;
+	return NN_OK;
+}
+
+nn_Exit nn_serializeComputer(nn_Computer *computer) {
+	char *buf;
+	size_t len;
+	nn_Exit e = nn_snapshotComputer(computer, &buf, &len);
+	if(e) return e;
+	e = nn_pushlstring(computer, buf, len);
+	nn_free(&computer->universe->ctx, buf, len);
+	return e;
+}
+
+static nn_Exit nn_badSnapshot(nn_Computer *computer, const char *why) {
+	nn_setError(computer, why);
+	return NN_EBADCALL;
+}
+
+nn_Exit nn_deserializeComputer(nn_Computer *computer, const char *buf, size_t buflen) {
+	nn_SnapReader r = {
+		.buf = buf,
+		.len = buflen,
+		.off = 0,
+		.bad = false,
+	};
+	const char *magic = nn_snapRead(&r, 4);
+	if(magic == NULL || nn_memcmp(magic, NN_SNAPSHOT_MAGIC, 4) != 0) return nn_badSnapshot(computer, "not a snapshot");
+	if(nn_snapReadSize(&r) != NN_SNAPSHOT_VERSION) return nn_badSnapshot(computer, "unsupported snapshot version");
+	if(nn_snapReadSize(&r) != NN_SNAPSHOT_ENDIAN || nn_snapReadSize(&r) != sizeof(double)) {
+		return nn_badSnapshot(computer, "snapshot from an incompatible machine");
+	}
+
+	size_t state = nn_snapReadSize(&r);
+	if(state > NN_CHARCH) return nn_badSnapshot(computer, "corrupted snapshot");
+	bool on = nn_snapReadSize(&r);
+	char name[NN_MAX_ARCHNAME];
+	if(nn_snapReadStringCopy(&r, name, sizeof(name)) == NULL) return nn_badSnapshot(computer, "corrupted snapshot");
+	nn_Architecture arch = nn_findSupportedArchitecture(computer, name);
+	if(arch.name == NULL) {
+		if(computer->arch.name == NULL || nn_strcmp(computer->arch.name, name) != 0) return nn_badSnapshot(computer, "unsupported architecture");
+		arch = computer->arch;
+	}
+
+	// the old state goes away, even if the snapshot turns out to be corrupted
+	nn_stopComputer(computer);
+	for(size_t i = 0; i < NN_MAX_USERDATA; i++) nn_freeUserdata(computer, i);
+	computer->arch = arch;
+
+	double uptime = nn_snapReadNumber(&r);
+	computer->creationTimestamp = nn_currentTime(&computer->universe->ctx) - uptime;
+	computer->idleTimestamp = nn_snapReadNumber(&r);
+	bool waiting = nn_snapReadSize(&r);
+
+	computer->totalEnergy = nn_snapReadNumber(&r);
+	computer->energyLedger = nn_snapReadSize(&r);
+	computer->energyBalance = nn_snapReadNumber(&r);
+	computer->energyPending = nn_snapReadNumber(&r);
+	computer->energyThreshold = nn_snapReadNumber(&r);
+	computer->totalCallBudget = nn_snapReadNumber(&r);
+	computer->directCost = nn_snapReadNumber(&r);
+
+	char str[NN_MAX_PATH];
+	nn_Exit e = nn_setTmpAddress(computer, nn_snapReadStringCopy(&r, str, sizeof(str)));
+	if(e) return e;
+
+	for(size_t i = 0; i < computer->userCount; i++) nn_strfree(&computer->universe->ctx, computer->users[i]);
+	computer->userCount = 0;
+	size_t userCount = nn_snapReadSize(&r);
+	for(size_t i = 0; i < userCount && !r.bad; i++) {
+		char user[NN_MAX_USERNAME];
+		if(nn_snapReadStringCopy(&r, user, sizeof(user)) == NULL) break;
+		e = nn_addUser(computer, user);
+		if(e) return e;
+	}
+
+	size_t infoCount = nn_snapReadSize(&r);
+	for(size_t i = 0; i < infoCount && !r.bad; i++) {
+		char addr[NN_MAX_PATH];
+		if(nn_snapReadStringCopy(&r, addr, sizeof(addr)) == NULL) break;
+		size_t fieldCount = nn_snapReadSize(&r);
+		if(fieldCount > (r.len - r.off) / (sizeof(size_t) * 2)) {
+			r.bad = true;
+			break;
+		}
+		// nn_addDeviceInfoL() copies the fields, so they are terminated in a scratch buffer until then.
+		// Every string is shorter than its encoding, terminator included.
+		size_t start = r.off;
+		for(size_t j = 0; j < fieldCount * 2; j++) {
+			size_t len;
+			nn_snapReadString(&r, &len);
+		}
+		if(r.bad) break;
+		size_t scratchLen = r.off - start + 1;
+		r.off = start;
+		nn_DeviceField *fields = nn_alloc(&computer->universe->ctx, sizeof(nn_DeviceField) * fieldCount + scratchLen);
+		if(fields == NULL) return NN_ENOMEM;
+		char *scratch = (char *)(fields + fieldCount);
+		char *p = scratch;
+		for(size_t j = 0; j < fieldCount; j++) {
+			fields[j].name = nn_snapReadStringCopy(&r, p, scratchLen - (p - scratch));
+			if(fields[j].name != NULL) p += nn_strlen(p) + 1;
+			fields[j].value = nn_snapReadStringCopy(&r, p, scratchLen - (p - scratch));
+			if(fields[j].value != NULL) p += nn_strlen(p) + 1;
+		}
+		nn_removeDeviceInfo(computer, addr);
+		e = nn_addDeviceInfoL(computer, addr, fields, fieldCount);
+		nn_free(&computer->universe->ctx, fields, sizeof(nn_DeviceField) * fieldCount + scratchLen);
+		if(e) return e;
+	}
+
+	// components belong to the host, which must have mounted them again
+	size_t componentCount = nn_snapReadSize(&r);
+	for(size_t i = 0; i < componentCount && !r.bad; i++) {
+		char addr[NN_MAX_PATH];
+		if(nn_snapReadStringCopy(&r, addr, sizeof(addr)) == NULL) break;
+		int slot = nn_snapReadSize(&r);
+		nn_ComponentEntry *ent = nn_getComponentEntry(computer, addr);
+		if(ent == NULL) return nn_badSnapshot(computer, "snapshot component is not mounted");
+		ent->slot = slot;
+	}
+	if(r.bad) return nn_badSnapshot(computer, "corrupted snapshot");
+
+	if(on) {
+		e = nn_startComputer(computer);
+		if(e) return e;
+	}
+	computer->state = state;
+
+	size_t signalCount = nn_snapReadSize(&r);
+	for(size_t i = 0; i < signalCount && !r.bad; i++) {
+		nn_EncodedNetworkContents contents;
+		contents.ctx = &computer->universe->ctx;
+		contents.valueCount = nn_snapReadSize(&r);
+		contents.buflen = nn_snapReadSize(&r);
+		contents.buf = (char *)nn_snapRead(&r, contents.buflen);
+		if(contents.buf == NULL) break;
+		size_t off = 0;
+		for(size_t j = 0; j < contents.valueCount && !r.bad; j++) {
+			size_t used;
+			if(nn_checkNetworkValue(contents.buf + off, contents.buflen - off, NN_SNAPSHOT_DEPTH, &used)) off += used;
+			else r.bad = true;
+		}
+		if(r.bad || off != contents.buflen) {
+			r.bad = true;
+			break;
+		}
+		size_t stackBase = nn_getstacksize(computer);
+		e = nn_pushNetworkContents(computer, &contents);
+		if(!e) e = nn_pushSignal(computer, contents.valueCount);
+		if(e) {
+			while(nn_getstacksize(computer) > stackBase) nn_pop(computer);
+			return e;
+		}
+	}
+
+	size_t userdataCount = nn_snapReadSize(&r);
+	for(size_t i = 0; i < userdataCount && !r.bad; i++) {
+		size_t idx = nn_snapReadSize(&r);
+		char addr[NN_MAX_PATH];
+		if(nn_snapReadStringCopy(&r, addr, sizeof(addr)) == NULL) break;
+		size_t len;
+		const char *data = nn_snapReadString(&r, &len);
+		if(len == NN_SNAPSHOT_NULL) continue;
+		if(data == NULL) break;
+		e = nn_deserializeUserdata(computer, idx, addr, data, len);
+		if(e) return e;
+	}
+
+	if(on && !r.bad) {
+		size_t len;
+		const char *data = nn_snapReadString(&r, &len);
+		if(data != NULL) {
+			nn_ArchitectureRequest req;
+			req.computer = computer;
+			req.action = NN_ARCH_DESERIALIZE;
+			req.globalState = computer->arch.state;
+			req.localState = computer->archState;
+			req.memIn = data;
+			req.memLen = len;
+			e = computer->arch.handler(&req);
+			if(e) return e;
+		}
+	}
+	if(r.bad) return nn_badSnapshot(computer, "corrupted snapshot");
+
+	nn_atomicStore(&computer->signalWaiting, waiting);
+	// hosts only tick idle computers once the wheel says so
+	nn_updateIdleTimer(computer);
 	return NN_OK;
 }
 
+// returns NULL if the transient arena is over budget, in which case the heap should be used
+static void *nn_transientAlloc(nn_Computer *computer, size_t size) {
+	if(computer->transientUsed + size > NN_MAX_TRANSIENT) return NULL;
+	void *mem = nn_aralloc(&computer->transient, size);
+	if(mem == NULL) return NULL;
+	computer->transientUsed += size;
+	return mem;
+}
+
+static void nn_initString(nn_Value *val, nn_String *s, nn_Context *ctx, const char *str, size_t len, bool transient) {
+	s->ctx = *ctx;
+	s->refc = 1;
+	s->len = len;
+	s->hash = 0;
+	s->transient = transient;
+	nn_memcpy(s->data, str, sizeof(char) * len);
+	s->data[len] = '\0';
+	val->type = NN_VAL_STR;
+	val->shortLen = NN_HEAPSTR;
+	val->string = s;
+}
+
+// makes a string value, inline if it is short enough.
+// If [computer] is not NULL, long strings come from its transient arena when possible.
+static nn_Exit nn_makeString(nn_Context *ctx, nn_Computer *computer, const char *str, size_t len, nn_Value *val) {
+	if(len <= NN_SHORTSTR) {
+		val->type = NN_VAL_STR;
+		val->shortLen = len;
+		nn_memcpy(val->shortStr, str, sizeof(char) * len);
+		val->shortStr[len] = '\0';
+		return NN_OK;
+	}
+	size_t size = sizeof(nn_String) + sizeof(char) * (len + 1);
+	nn_String *s = NULL;
+	if(computer != NULL) {
+		s = nn_transientAlloc(computer, size);
+		if(s != NULL) {
+			nn_initString(val, s, ctx, str, len, true);
+			return NN_OK;
+		}
+	}
+	s = nn_alloc(ctx, size);
+	if(s == NULL) return NN_ENOMEM;
+	nn_initString(val, s, ctx, str, len, false);
+	return NN_OK;
+}
+
+// allocates a table of [len] pairs, see nn_makeString() for [computer]
+static nn_Table *nn_allocTable(nn_Context *ctx, nn_Computer *computer, size_t len) {
+	size_t size = sizeof(nn_Table) + sizeof(nn_Value) * len * 2;
+	nn_Table *t = NULL;
+	bool transient = false;
+	if(computer != NULL) {
+		t = nn_transientAlloc(computer, size);
+		transient = t != NULL;
+	}
+	if(t == NULL) t = nn_alloc(ctx, size);
+	if(t == NULL) return NULL;
+	t->ctx = *ctx;
+	t->refc = 1;
+	t->len = len;
+	t->transient = transient;
+	return t;
+}
+
+static size_t nn_valueStrlen(const nn_Value *val) {
+	if(val->shortLen != NN_HEAPSTR) return val->shortLen;
+	return val->string->len;
+}
+
+// the pointer is only valid as long as [val] does not move
+static const char *nn_valueStr(const nn_Value *val) {
+	if(val->shortLen != NN_HEAPSTR) return val->shortStr;
+	return val->string->data;
+}
+
 static void nn_retainValue(nn_Value val) {
 	switch(val.type) {
 	case NN_VAL_NULL:
@@ -2482,6 +4454,7 @@ static void nn_retainValue(nn_Value val) {
 	case NN_VAL_USERDATA:
 		return;
 	case NN_VAL_STR:
+		if(val.shortLen != NN_HEAPSTR) return;
 		val.string->refc++;
 		return;
 	case NN_VAL_TABLE:
@@ -2500,8 +4473,10 @@ static void nn_dropValue(nn_Value val) {
 	case NN_VAL_USERDATA:
 		return;
 	case NN_VAL_STR:
+		if(val.shortLen != NN_HEAPSTR) return;
 		val.string->refc--;
 		if(val.string->refc != 0) return;
+		if(val.string->transient) return;
 		ctx = val.string->ctx;
 		size = val.string->len + 1;
 		nn_free(&ctx, val.string, sizeof(nn_String) + sizeof(char) * size);
@@ -2511,11 +4486,49 @@ static void nn_dropValue(nn_Value val) {
 		if(val.table->refc != 0) return;
 		ctx = val.table->ctx;
 		size = val.table->len;
+		// the table owns its keys and values
+		for(size_t i = 0; i < size * 2; i++) nn_dropValue(val.table->vals[i]);
+		if(val.table->transient) return;
 		nn_free(&ctx, val.table, sizeof(nn_Table) + sizeof(nn_Value) * size * 2);
 		return;
 	}
 }
 
+static bool nn_isTransient(nn_Value val) {
+	if(val.type == NN_VAL_STR) return val.shortLen == NN_HEAPSTR && val.string->transient;
+	if(val.type != NN_VAL_TABLE) return false;
+	if(val.table->transient) return true;
+	for(size_t i = 0; i < val.table->len * 2; i++) {
+		if(nn_isTransient(val.table->vals[i])) return true;
+	}
+	return false;
+}
+
+// Gives a new reference to [val] which does not live in the transient arena, copying it if needed.
+static nn_Exit nn_promoteValue(nn_Context *ctx, nn_Value val, nn_Value *out) {
+	if(!nn_isTransient(val)) {
+		nn_retainValue(val);
+		*out = val;
+		return NN_OK;
+	}
+	if(val.type == NN_VAL_STR) {
+		return nn_makeString(ctx, NULL, val.string->data, val.string->len, out);
+	}
+	nn_Table *t = nn_allocTable(ctx, NULL, val.table->len);
+	if(t == NULL) return NN_ENOMEM;
+	for(size_t i = 0; i < t->len * 2; i++) {
+		nn_Exit e = nn_promoteValue(ctx, val.table->vals[i], &t->vals[i]);
+		if(e) {
+			for(size_t j = 0; j < i; j++) nn_dropValue(t->vals[j]);
+			nn_free(ctx, t, sizeof(nn_Table) + sizeof(nn_Value) * t->len * 2);
+			return e;
+		}
+	}
+	out->type = NN_VAL_TABLE;
+	out->table = t;
+	return NN_OK;
+}
+
 double nn_defaultCallBudgets[4] = { 0.5, 1, 1.5, 2 };
 double nn_unlimitedCallBudget = 0;
 size_t nn_defaultComponentLimits[4] = { 8, 12, 16, 20 };
@@ -2593,15 +4606,77 @@ nn_Exit nn_pushstring(nn_Computer *computer, const char *str) {
 }
 
 nn_Exit nn_pushlstring(nn_Computer *computer, const char *str, size_t len) {
-	nn_Context ctx = computer->universe->ctx;
-	nn_String *s = nn_alloc(&ctx, sizeof(nn_String) + sizeof(char) * (len + 1));
+	if(!nn_checkstack(computer, 1)) return NN_ENOSTACK;
+	nn_Value val;
+	nn_Exit e = nn_makeString(&computer->universe->ctx, computer, str, len, &val);
+	if(e) return e;
+	return nn_pushvalue(computer, val);
+}
+
+nn_Exit nn_pushlstringBuffer(nn_Computer *computer, size_t capacity, char **buf) {
+	if(!nn_checkstack(computer, 1)) return NN_ENOSTACK;
+	nn_Value *val = &computer->callstack[computer->stackSize];
+	if(capacity <= NN_SHORTSTR) {
+		val->type = NN_VAL_STR;
+		val->shortLen = capacity;
+		val->shortStr[capacity] = '\0';
+		*buf = val->shortStr;
+		computer->stackSize++;
+		return NN_OK;
+	}
+	nn_Context *ctx = &computer->universe->ctx;
+	size_t size = sizeof(nn_String) + sizeof(char) * (capacity + 1);
+	nn_String *s = nn_transientAlloc(computer, size);
+	bool transient = s != NULL;
+	if(s == NULL) s = nn_alloc(ctx, size);
 	if(s == NULL) return NN_ENOMEM;
-	s->ctx = ctx;
+	s->ctx = *ctx;
 	s->refc = 1;
+	// the capacity, until it is committed
+	s->len = capacity;
+	s->hash = 0;
+	s->transient = transient;
+	s->data[capacity] = '\0';
+	val->type = NN_VAL_STR;
+	val->shortLen = NN_HEAPSTR;
+	val->string = s;
+	*buf = s->data;
+	computer->stackSize++;
+	return NN_OK;
+}
+
+nn_Exit nn_commitlstring(nn_Computer *computer, size_t len) {
+	if(computer->stackSize == 0) return NN_EBELOWSTACK;
+	nn_Value *val = &computer->callstack[computer->stackSize - 1];
+	if(val->shortLen != NN_HEAPSTR) {
+		if(len > val->shortLen) return NN_EBADSTATE;
+		val->shortLen = len;
+		val->shortStr[len] = '\0';
+		return NN_OK;
+	}
+	nn_String *s = val->string;
+	if(len > s->len) return NN_EBADSTATE;
+	if(len <= NN_SHORTSTR) {
+		// not worth keeping the allocation
+		nn_Value small;
+		nn_makeString(&s->ctx, NULL, s->data, len, &small);
+		nn_dropValue(*val);
+		*val = small;
+		return NN_OK;
+	}
+	if(len != s->len && !s->transient) {
+		// the size is needed to free it
+		nn_String *shrunk = nn_realloc(&s->ctx, s, sizeof(nn_String) + sizeof(char) * (s->len + 1), sizeof(nn_String) + sizeof(char) * (len + 1));
+		if(shrunk == NULL) {
+			nn_pop(computer);
+			return NN_ENOMEM;
+		}
+		s = shrunk;
+		val->string = s;
+	}
 	s->len = len;
-	nn_memcpy(s->data, str, sizeof(char) * len);
 	s->data[len] = '\0';
-	return nn_pushvalue(computer, (nn_Value) {.type = NN_VAL_STR, .string = s});
+	return NN_OK;
 }
 
 nn_Exit nn_pushuserdata(nn_Computer *computer, size_t userdataIdx) {
@@ -2610,12 +4685,8 @@ nn_Exit nn_pushuserdata(nn_Computer *computer, size_t userdataIdx) {
 
 nn_Exit nn_pusharraytable(nn_Computer *computer, size_t len) {
 	if(computer->stackSize < len) return NN_EBELOWSTACK;
-	nn_Context ctx = computer->universe->ctx;
-	nn_Table *t = nn_alloc(&ctx, sizeof(nn_Table) + sizeof(nn_Value) * len * 2);
+	nn_Table *t = nn_allocTable(&computer->universe->ctx, computer, len);
 	if(t == NULL) return NN_ENOMEM;
-	t->ctx = ctx;
-	t->refc = 1;
-	t->len = len;
 	for(size_t i = 0; i < len; i++) {
 		t->vals[i*2].type = NN_VAL_NUM;
 		t->vals[i*2].number = (double)i+1;
@@ -2628,12 +4699,8 @@ nn_Exit nn_pusharraytable(nn_Computer *computer, size_t len) {
 nn_Exit nn_pushtable(nn_Computer *computer, size_t len) {
 	size_t size = len * 2;
 	if(computer->stackSize < size) return NN_EBELOWSTACK;
-	nn_Context ctx = computer->universe->ctx;
-	nn_Table *t = nn_alloc(&ctx, sizeof(nn_Table) + sizeof(nn_Value) * size);
+	nn_Table *t = nn_allocTable(&computer->universe->ctx, computer, len);
 	if(t == NULL) return NN_ENOMEM;
-	t->ctx = ctx;
-	t->refc = 1;
-	t->len = len;
 	for(size_t i = 0; i < len*2; i++) {
 		t->vals[i] = computer->callstack[computer->stackSize - size + i];
 	}
@@ -2651,6 +4718,11 @@ nn_Exit nn_popn(nn_Computer *computer, size_t n) {
 		nn_dropValue(computer->callstack[i]);
 	}
 	computer->stackSize -= n;
+	if(computer->stackSize == 0 && !computer->batching) {
+		// nothing can reference transient values anymore
+		nn_arreset(&computer->transient);
+		computer->transientUsed = 0;
+	}
 	return NN_OK;
 }
 
@@ -2826,9 +4898,19 @@ const char *nn_tostring(nn_Computer *computer, size_t idx) {
 }
 
 const char *nn_tolstring(nn_Computer *computer, size_t idx, size_t *len) {
-	nn_String *s = computer->callstack[idx].string;
-	if(len != NULL) *len = s->len;
-	return s->data;
+	nn_Value *val = &computer->callstack[idx];
+	if(len != NULL) *len = nn_valueStrlen(val);
+	return nn_valueStr(val);
+}
+
+nn_Component *nn_tocomponent(nn_Computer *computer, size_t idx) {
+	nn_Value *val = &computer->callstack[idx];
+	if(val->shortLen != NN_HEAPSTR) {
+		return nn_getComponentHashed(computer, val->shortStr, nn_lstrhash(val->shortStr, val->shortLen));
+	}
+	nn_String *s = val->string;
+	if(s->hash == 0) s->hash = nn_lstrhash(s->data, s->len);
+	return nn_getComponentHashed(computer, s->data, s->hash);
 }
 
 size_t nn_touserdata(nn_Computer *computer, size_t idx) {
@@ -2841,6 +4923,7 @@ nn_Exit nn_dumptable(nn_Computer *computer, size_t idx, size_t *len) {
 
 	if(len != NULL) *len = t->len;
 	for(size_t i = 0; i < t->len * 2; i++) {
+		nn_retainValue(t->vals[i]);
 		computer->callstack[computer->stackSize + i] = t->vals[i];
 	}
 	computer->stackSize += t->len * 2;
@@ -2862,8 +4945,8 @@ int nn_countValueCost(nn_Computer *computer, size_t values) {
 			total += 8;
 			continue;
 		case NN_VAL_STR:
-			total += val.string->len;
-			if(val.string->len == 0) total++;
+			total += nn_valueStrlen(&val);
+			if(nn_valueStrlen(&val) == 0) total++;
 			continue;
 		case NN_VAL_TABLE:
 		case NN_VAL_USERDATA:
@@ -2886,8 +4969,8 @@ size_t nn_countSignalCostValue(nn_Value value) {
 		break;
 	case NN_VAL_STR:
 		// 2+1
-		if(value.string->len == 0) total++;
-		else total += value.string->len;
+		if(nn_valueStrlen(&value) == 0) total++;
+		else total += nn_valueStrlen(&value);
 		break;
 	case NN_VAL_TABLE:
 		total += 2;
@@ -2912,6 +4995,16 @@ size_t nn_countSignals(nn_Computer *computer) {
 	return computer->signalCount;
 }
 
+// records the signal, named after its first value
+static void nn_traceSignal(nn_Computer *computer, nn_TraceKind kind, const nn_Signal *s) {
+	const nn_Value *name = &computer->signalValues[s->start];
+	if(s->len == 0 || name->type != NN_VAL_STR) {
+		nn_traceRecord(computer, kind, nn_traceNow(computer), NULL, 0, NULL);
+		return;
+	}
+	nn_traceRecord(computer, kind, nn_traceNow(computer), nn_valueStr(name), nn_valueStrlen(name), NULL);
+}
+
 nn_Exit nn_pushSignal(nn_Computer *computer, size_t valueCount) {
 	if(computer->state != NN_RUNNING) return nn_popn(computer, valueCount);
 	if(computer->signalCount == NN_MAX_SIGNALS) return NN_ELIMIT;
@@ -2919,37 +5012,57 @@ nn_Exit nn_pushSignal(nn_Computer *computer, size_t valueCount) {
 	
 	size_t cost = nn_countSignalCost(computer, valueCount);
 	if(cost > NN_MAX_SIGNALSIZE) return NN_ELIMIT;
+	if(computer->signalValueCount + valueCount > NN_MAX_SIGNALVALUES) return NN_ELIMIT;
+
+	// signals outlive the stack, and thus the transient arena
+	for(size_t i = computer->stackSize - valueCount; i < computer->stackSize; i++) {
+		nn_Value promoted;
+		nn_Exit e = nn_promoteValue(&computer->universe->ctx, computer->callstack[i], &promoted);
+		if(e) return e;
+		nn_dropValue(computer->callstack[i]);
+		computer->callstack[i] = promoted;
+	}
 
-	nn_Context ctx = computer->universe->ctx;
 	nn_Signal s;
+	s.start = (computer->signalValueHead + computer->signalValueCount) % NN_MAX_SIGNALVALUES;
 	s.len = valueCount;
-	s.values = nn_alloc(&ctx, sizeof(nn_Value) * valueCount);
-	if(s.values == NULL) return NN_ENOMEM;
 	for(size_t i = 0; i < valueCount; i++) {
-		s.values[i] = computer->callstack[computer->stackSize - valueCount + i];
+		size_t j = (s.start + i) % NN_MAX_SIGNALVALUES;
+		computer->signalValues[j] = computer->callstack[computer->stackSize - valueCount + i];
 	}
 	computer->stackSize -= valueCount;
-	computer->signals[computer->signalCount++] = s;
+	computer->signalValueCount += valueCount;
+	size_t tail = (computer->signalHead + computer->signalCount) % NN_MAX_SIGNALS;
+	computer->signals[tail] = s;
+	computer->signalCount++;
+	if(computer->trace != NULL) nn_traceSignal(computer, NN_TRACE_PUSHSIGNAL, &s);
+	// the signal it was waiting on
+	if(nn_atomicLoad(&computer->signalWaiting)) {
+		nn_atomicStore(&computer->signalWaiting, false);
+		nn_resetIdleTime(computer);
+		nn_wakeComputer(computer);
+	}
 	return NN_OK;
 }
 
 nn_Exit nn_popSignal(nn_Computer *computer, size_t *valueCount) {
 	if(computer->signalCount == 0) return NN_EBADSTATE;
 
-	nn_Context ctx = computer->universe->ctx;
-	nn_Signal s = computer->signals[0];
+	nn_Signal s = computer->signals[computer->signalHead];
 	if(!nn_checkstack(computer, s.len)) return NN_ENOSTACK;
+	if(computer->trace != NULL) nn_traceSignal(computer, NN_TRACE_POPSIGNAL, &s);
 
 	if(valueCount != NULL) *valueCount = s.len;
 	for(size_t i = 0; i < s.len; i++) {
-		computer->callstack[computer->stackSize + i] = s.values[i];
+		size_t j = (s.start + i) % NN_MAX_SIGNALVALUES;
+		computer->callstack[computer->stackSize + i] = computer->signalValues[j];
 	}
 	computer->stackSize += s.len;
-	for(size_t i = 1; i < computer->signalCount; i++) {
-		computer->signals[i-1] = computer->signals[i];
-	}
+	computer->signalHead = (computer->signalHead + 1) % NN_MAX_SIGNALS;
 	computer->signalCount--;
-	nn_free(&ctx, s.values, sizeof(nn_Value) * s.len);
+	// signals are FIFO, so the oldest values are always at the slab head
+	computer->signalValueHead = (computer->signalValueHead + s.len) % NN_MAX_SIGNALVALUES;
+	computer->signalValueCount -= s.len;
 	return NN_OK;
 }
 
@@ -3961,7 +6074,7 @@ nn_Exit nn_pushRedstoneChanged(nn_Computer *computer, const char *redstoneAddres
 	if(err) return err;
 	err = nn_pushinteger(computer, newValue);
 	if(err) return err;
-	err = color < 0 ? nn_pushnull(computer) : nn_pushinteger(computer, newValue);
+	err = color < 0 ? nn_pushnull(computer) : nn_pushinteger(computer, color);
 	if(err) return err;
 	return nn_pushSignal(computer, 6);
 }
@@ -3989,6 +6102,29 @@ nn_Exit nn_pushInternetReady(nn_Computer *computer, const char *id, size_t idlen
 	return nn_pushSignal(computer, 2);
 }
 
+nn_Exit nn_pushDriveDone(nn_Computer *computer, const char *driveAddress, size_t id, const char *data, size_t len, const char *error) {
+	nn_Exit err = nn_pushstring(computer, "drive_done");
+	if(err) return err;
+	err = nn_pushstring(computer, driveAddress);
+	if(err) return err;
+	err = nn_pushinteger(computer, id);
+	if(err) return err;
+	if(error != NULL) {
+		err = nn_pushnull(computer);
+		if(err) return err;
+		err = nn_pushstring(computer, error);
+		if(err) return err;
+		return nn_pushSignal(computer, 5);
+	}
+	if(data == NULL) {
+		err = nn_pushbool(computer, true);
+	} else {
+		err = nn_pushlstring(computer, data, len);
+	}
+	if(err) return err;
+	return nn_pushSignal(computer, 4);
+}
+
 typedef enum nn_NetworkValueTag {
 	NN_NETVAL_NULL = 0x00,
 	NN_NETVAL_TRUE = 0x01,
@@ -4018,13 +6154,14 @@ static size_t nn_sizeOfNetworkValue(nn_Value val) {
 		n += sizeof(double);
 		break;
 	case NN_VAL_STR:
-		n += sizeof(size_t) + val.string->len;
+		n += sizeof(size_t) + nn_valueStrlen(&val);
 		break;
 	case NN_VAL_USERDATA:
 		n += sizeof(size_t);
 		break;
 	case NN_VAL_TABLE:
-		n += sizeof(size_t) + nn_sizeOfNetworkContents(val.table->vals, val.table->len);
+		// keys and values
+		n += sizeof(size_t) + nn_sizeOfNetworkContents(val.table->vals, val.table->len * 2);
 		break;
 	}
 	return n;
@@ -4045,9 +6182,10 @@ static size_t nn_encodeNetworkValue(nn_Value val, char *buf) {
 		return 1 + sizeof(double);
 	case NN_VAL_STR:
 		*buf = NN_NETVAL_STR;
-		nn_memcpy(buf + 1, &val.string->len, sizeof(size_t));
-		nn_memcpy(buf + 1 + sizeof(size_t), val.string->data, val.string->len);
-		return 1 + sizeof(size_t) + val.string->len;
+		n = nn_valueStrlen(&val);
+		nn_memcpy(buf + 1, &n, sizeof(size_t));
+		nn_memcpy(buf + 1 + sizeof(size_t), nn_valueStr(&val), n);
+		return 1 + sizeof(size_t) + n;
 	case NN_VAL_USERDATA:
 		*buf = NN_NETVAL_RESOURCE;
 		nn_memcpy(buf + 1, &val.userdataIdx, sizeof(size_t));
@@ -4057,7 +6195,7 @@ static size_t nn_encodeNetworkValue(nn_Value val, char *buf) {
 		n = 1;
 		nn_memcpy(buf + n, &val.table->len, sizeof(size_t));
 		n += sizeof(size_t);
-		for(size_t i = 0; i < val.table->len; i++) {
+		for(size_t i = 0; i < val.table->len * 2; i++) {
 			n += nn_encodeNetworkValue(val.table->vals[i], buf + n);
 		}
 		return n;
@@ -4100,6 +6238,46 @@ void nn_dropNetworkContents(nn_EncodedNetworkContents *contents) {
 	nn_free(contents->ctx, contents->buf, contents->buflen);
 }
 
+// checks that an encoded value fits in [len] bytes, setting *used to its size, so untrusted buffers can be decoded.
+// [depth] limits how deeply tables may nest.
+static bool nn_checkNetworkValue(const char *buf, size_t len, size_t depth, size_t *used) {
+	if(len == 0) return false;
+	size_t n = 0;
+	switch((nn_NetworkValueTag)buf[0]) {
+	case NN_NETVAL_NULL:
+	case NN_NETVAL_TRUE:
+	case NN_NETVAL_FALSE:
+		*used = 1;
+		return true;
+	case NN_NETVAL_NUM:
+		*used = 1 + sizeof(double);
+		return len >= *used;
+	case NN_NETVAL_STR:
+		if(len < 1 + sizeof(size_t)) return false;
+		nn_memcpy(&n, buf + 1, sizeof(size_t));
+		if(n > len - 1 - sizeof(size_t)) return false;
+		*used = 1 + sizeof(size_t) + n;
+		return true;
+	case NN_NETVAL_RESOURCE:
+		*used = 1 + sizeof(size_t);
+		return len >= *used;
+	case NN_NETVAL_TABLE:
+		if(depth == 0 || len < 1 + sizeof(size_t)) return false;
+		nn_memcpy(&n, buf + 1, sizeof(size_t));
+		size_t off = 1 + sizeof(size_t);
+		// every value is at least a byte
+		if(n > (len - off) / 2) return false;
+		for(size_t i = 0; i < n * 2; i++) {
+			size_t sub;
+			if(!nn_checkNetworkValue(buf + off, len - off, depth - 1, &sub)) return false;
+			off += sub;
+		}
+		*used = off;
+		return true;
+	}
+	return false;
+}
+
 static nn_Exit nn_decodeNetworkValue(nn_Value *val, nn_Context *ctx, const char *buf, size_t *len) {
 	size_t decodedLen = 0, off = 0;
 	nn_Value tmpval;
@@ -4121,14 +6299,7 @@ static nn_Exit nn_decodeNetworkValue(nn_Value *val, nn_Context *ctx, const char
 		return NN_OK;
 	case NN_NETVAL_STR:
 		nn_memcpy(&decodedLen, buf + 1, sizeof(size_t));
-		val->type = NN_VAL_STR;
-		val->string = nn_alloc(ctx, sizeof(nn_String) + decodedLen + 1);
-		if(val->string == NULL) return NN_ENOMEM;
-		val->string->ctx = *ctx;
-		val->string->refc = 1;
-		val->string->len = decodedLen;
-		nn_memcpy(val->string->data, buf + 1 + sizeof(size_t), decodedLen);
-		val->string->data[decodedLen] = '\0';
+		if(nn_makeString(ctx, NULL, buf + 1 + sizeof(size_t), decodedLen, val)) return NN_ENOMEM;
 		*len = 1 + sizeof(size_t) + decodedLen;
 		return NN_OK;
 	case NN_NETVAL_RESOURCE:
@@ -4139,17 +6310,15 @@ static nn_Exit nn_decodeNetworkValue(nn_Value *val, nn_Context *ctx, const char
 	case NN_NETVAL_TABLE:
 		val->type = NN_VAL_TABLE;
 		nn_memcpy(&decodedLen, buf + 1, sizeof(size_t));
-		val->table = nn_alloc(ctx, sizeof(nn_Table) + sizeof(nn_Value) * decodedLen * 2);
+		val->table = nn_allocTable(ctx, NULL, decodedLen);
 		if(val->table == NULL) return NN_ENOMEM;
-		val->table->ctx = *ctx;
-		val->table->refc = 1;
-		val->table->len = decodedLen;
 		off = 1 + sizeof(size_t);
 		for(size_t i = 0; i < decodedLen*2; i++) {
 			size_t tmplen = 0;
 			nn_Exit e = nn_decodeNetworkValue(&tmpval, ctx, buf + off, &tmplen);
 			if(e) {
 				for(size_t j = 0; j < i; j++) nn_dropValue(val->table->vals[j]);
+				nn_free(ctx, val->table, sizeof(nn_Table) + sizeof(nn_Value) * decodedLen * 2);
 				return e;
 			}
 			val->table->vals[i] = tmpval;
@@ -4197,6 +6366,205 @@ nn_Exit nn_pushModemMessage(nn_Computer *C, const char *modemAddress, const char
 	return nn_pushSignal(C, signalVals);
 }
 
+void nn_initNetworkContents(nn_Context *ctx, nn_EncodedNetworkContents *contents) {
+	contents->ctx = ctx;
+	contents->buf = NULL;
+	contents->buflen = 0;
+	contents->valueCount = 0;
+}
+
+static nn_Exit nn_appendNetworkBytes(nn_EncodedNetworkContents *contents, const void *buf, size_t len, size_t valueCount) {
+	size_t newlen = contents->buflen + len;
+	char *newbuf = nn_realloc(contents->ctx, contents->buf, contents->buflen, newlen);
+	if(newbuf == NULL) return NN_ENOMEM;
+	nn_memcpy(newbuf + contents->buflen, buf, len);
+	contents->buf = newbuf;
+	contents->buflen = newlen;
+	contents->valueCount += valueCount;
+	return NN_OK;
+}
+
+nn_Exit nn_appendnull(nn_EncodedNetworkContents *contents) {
+	char tag = NN_NETVAL_NULL;
+	return nn_appendNetworkBytes(contents, &tag, 1, 1);
+}
+
+nn_Exit nn_appendbool(nn_EncodedNetworkContents *contents, bool truthy) {
+	char tag = truthy ? NN_NETVAL_TRUE : NN_NETVAL_FALSE;
+	return nn_appendNetworkBytes(contents, &tag, 1, 1);
+}
+
+nn_Exit nn_appendnumber(nn_EncodedNetworkContents *contents, double num) {
+	char buf[1 + sizeof(double)];
+	buf[0] = NN_NETVAL_NUM;
+	nn_memcpy(buf + 1, &num, sizeof(double));
+	return nn_appendNetworkBytes(contents, buf, sizeof(buf), 1);
+}
+
+nn_Exit nn_appendinteger(nn_EncodedNetworkContents *contents, intptr_t num) {
+	return nn_appendnumber(contents, num);
+}
+
+nn_Exit nn_appendstring(nn_EncodedNetworkContents *contents, const char *str) {
+	if(str == NULL) return nn_appendnull(contents);
+	return nn_appendlstring(contents, str, nn_strlen(str));
+}
+
+nn_Exit nn_appendlstring(nn_EncodedNetworkContents *contents, const char *str, size_t len) {
+	size_t off = contents->buflen;
+	size_t newlen = off + 1 + sizeof(size_t) + len;
+	char *newbuf = nn_realloc(contents->ctx, contents->buf, contents->buflen, newlen);
+	if(newbuf == NULL) return NN_ENOMEM;
+	newbuf[off] = NN_NETVAL_STR;
+	nn_memcpy(newbuf + off + 1, &len, sizeof(size_t));
+	nn_memcpy(newbuf + off + 1 + sizeof(size_t), str, len);
+	contents->buf = newbuf;
+	contents->buflen = newlen;
+	contents->valueCount++;
+	return NN_OK;
+}
+
+nn_Exit nn_appendNetworkContents(nn_EncodedNetworkContents *contents, const nn_EncodedNetworkContents *other) {
+	return nn_appendNetworkBytes(contents, other->buf, other->buflen, other->valueCount);
+}
+
+// how many times a producer retries claiming a slot before giving up.
+// Each failed attempt means another producer made progress.
+#define NN_INBOX_RETRIES 4096
+
+// user is the player the signal came from, or NULL if any user can see it
+static nn_Exit nn_postSignalFrom(nn_Computer *computer, nn_EncodedNetworkContents *contents, const char *user) {
+	size_t pos = nn_atomicLoad(&computer->inboxTail);
+	for(size_t attempt = 0; attempt < NN_INBOX_RETRIES; attempt++) {
+		nn_InboxSlot *slot = &computer->inbox[pos % NN_MAX_INBOX];
+		size_t seq = nn_atomicLoad(&slot->seq);
+		intptr_t diff = (intptr_t)(seq - pos);
+		if(diff == 0) {
+			// on failure, pos is updated to the current tail
+			if(!nn_atomicCAS(&computer->inboxTail, &pos, pos + 1)) continue;
+			slot->contents = *contents;
+			slot->checkUser = user != NULL;
+			slot->longUser = false;
+			if(user != NULL) {
+				size_t len = nn_strlen(user);
+				slot->longUser = len >= NN_MAX_USERNAME;
+				if(slot->longUser) len = 0;
+				nn_memcpy(slot->user, user, len);
+				slot->user[len] = '\0';
+			}
+			nn_atomicStore(&slot->seq, pos + 1);
+			// the owner thread resets the idle time once it drains the inbox
+			if(nn_atomicLoad(&computer->signalWaiting)) nn_wakeComputer(computer);
+			return NN_OK;
+		}
+		// the consumer has not freed this slot yet
+		if(diff < 0) return NN_ELIMIT;
+		pos = nn_atomicLoad(&computer->inboxTail);
+	}
+	return NN_ELIMIT;
+}
+
+nn_Exit nn_postSignal(nn_Computer *computer, nn_EncodedNetworkContents *contents) {
+	return nn_postSignalFrom(computer, contents, NULL);
+}
+
+static bool nn_inboxUserAllowed(nn_Computer *computer, nn_InboxSlot *slot) {
+	if(!slot->checkUser || computer->userCount == 0) return true;
+	if(slot->longUser) return false;
+	return nn_hasUser(computer, slot->user);
+}
+
+void nn_drainInbox(nn_Computer *computer) {
+	for(size_t i = 0; i < NN_MAX_INBOX; i++) {
+		size_t head = computer->inboxHead;
+		nn_InboxSlot *slot = &computer->inbox[head % NN_MAX_INBOX];
+		if(nn_atomicLoad(&slot->seq) != head + 1) return;
+		nn_EncodedNetworkContents *contents = &slot->contents;
+
+		// not from one of its users, so it is dropped
+		if(computer->state == NN_RUNNING && nn_inboxUserAllowed(computer, slot)) {
+			// no space yet, keep it for later
+			if(computer->signalCount == NN_MAX_SIGNALS) return;
+			size_t valueCount = contents->valueCount;
+			if(valueCount <= NN_MAX_SIGNALVALUES && computer->signalValueCount + valueCount > NN_MAX_SIGNALVALUES) return;
+
+			size_t stackSize = computer->stackSize;
+			nn_Exit e = nn_pushNetworkContents(computer, contents);
+			if(!e) e = nn_pushSignal(computer, valueCount);
+			if(e) nn_popn(computer, computer->stackSize - stackSize);
+			// retry next time
+			if(e == NN_ENOMEM) return;
+			// anything else means it could never fit, so it is dropped
+		}
+
+		nn_dropNetworkContents(contents);
+		computer->inboxHead = head + 1;
+		nn_atomicStore(&slot->seq, head + NN_MAX_INBOX);
+	}
+}
+
+static nn_Exit nn_postBuiltSignal(nn_Computer *computer, nn_EncodedNetworkContents *contents, nn_Exit err, const char *user) {
+	if(!err) err = nn_postSignalFrom(computer, contents, user);
+	if(err) nn_dropNetworkContents(contents);
+	return err;
+}
+
+nn_Exit nn_postTouch(nn_Computer *computer, const char *screenAddress, double x, double y, int button, const char *player) {
+	nn_EncodedNetworkContents contents;
+	nn_initNetworkContents(&computer->universe->ctx, &contents);
+	nn_Exit err = nn_appendstring(&contents, "touch");
+	if(!err) err = nn_appendstring(&contents, screenAddress);
+	if(!err) err = nn_appendnumber(&contents, x);
+	if(!err) err = nn_appendnumber(&contents, y);
+	if(!err) err = nn_appendinteger(&contents, button);
+	if(!err) err = nn_appendstring(&contents, player);
+	return nn_postBuiltSignal(computer, &contents, err, player);
+}
+
+nn_Exit nn_postKeyDown(nn_Computer *computer, const char *keyboardAddress, nn_codepoint charcode, int keycode, const char *player) {
+	nn_EncodedNetworkContents contents;
+	nn_initNetworkContents(&computer->universe->ctx, &contents);
+	nn_Exit err = nn_appendstring(&contents, "key_down");
+	if(!err) err = nn_appendstring(&contents, keyboardAddress);
+	if(!err) err = nn_appendinteger(&contents, charcode);
+	if(!err) err = nn_appendinteger(&contents, keycode);
+	return nn_postBuiltSignal(computer, &contents, err, player);
+}
+
+nn_Exit nn_postKeyUp(nn_Computer *computer, const char *keyboardAddress, nn_codepoint charcode, int keycode, const char *player) {
+	nn_EncodedNetworkContents contents;
+	nn_initNetworkContents(&computer->universe->ctx, &contents);
+	nn_Exit err = nn_appendstring(&contents, "key_up");
+	if(!err) err = nn_appendstring(&contents, keyboardAddress);
+	if(!err) err = nn_appendinteger(&contents, charcode);
+	if(!err) err = nn_appendinteger(&contents, keycode);
+	return nn_postBuiltSignal(computer, &contents, err, player);
+}
+
+nn_Exit nn_postRedstoneChanged(nn_Computer *computer, const char *redstoneAddress, int side, int oldValue, int newValue, int color) {
+	nn_EncodedNetworkContents contents;
+	nn_initNetworkContents(&computer->universe->ctx, &contents);
+	nn_Exit err = nn_appendstring(&contents, "redstone_changed");
+	if(!err) err = nn_appendstring(&contents, redstoneAddress);
+	if(!err) err = nn_appendinteger(&contents, side);
+	if(!err) err = nn_appendinteger(&contents, oldValue);
+	if(!err) err = nn_appendinteger(&contents, newValue);
+	if(!err) err = color < 0 ? nn_appendnull(&contents) : nn_appendinteger(&contents, color);
+	return nn_postBuiltSignal(computer, &contents, err, NULL);
+}
+
+nn_Exit nn_postModemMessage(nn_Computer *computer, const char *modemAddress, const char *sender, int port, double distance, const nn_EncodedNetworkContents *msg) {
+	nn_EncodedNetworkContents contents;
+	nn_initNetworkContents(&computer->universe->ctx, &contents);
+	nn_Exit err = nn_appendstring(&contents, "modem_message");
+	if(!err) err = nn_appendstring(&contents, modemAddress);
+	if(!err) err = nn_appendstring(&contents, sender);
+	if(!err) err = nn_appendinteger(&contents, port);
+	if(!err) err = nn_appendnumber(&contents, distance);
+	if(!err) err = nn_appendNetworkContents(&contents, msg);
+	return nn_postBuiltSignal(computer, &contents, err, NULL);
+}
+
 nn_Exit nn_transferErrorFrom(nn_Exit exit, nn_Computer *from, nn_Computer *to) {
 	const char *err = nn_getError(from);
 	if(err != NULL) nn_setError(to, err);
@@ -4257,24 +6625,24 @@ static nn_Exit nn_eepromHandler(nn_ComponentRequest *req) {
 	if(method == NN_EENUM_GET) {
 		nn_removeEnergy(C, eeprom.readEnergyCost);
 		ereq.action = NN_EEPROM_GET;
-		NN_VLA(char, buf, eeprom.size);
-		ereq.buf = buf;
+		e = nn_pushlstringBuffer(C, eeprom.size, &ereq.buf);
+		if(e) return e;
 		ereq.buflen = eeprom.size;
 		e = state->handler(&ereq);
 		if(e) return e;
 		req->returnCount = 1;
-		return nn_pushlstring(C, ereq.buf, ereq.buflen);
+		return nn_commitlstring(C, ereq.buflen);
 	}
 	if(method == NN_EENUM_GETDATA) {
 		nn_removeEnergy(C, eeprom.readDataEnergyCost);
 		ereq.action = NN_EEPROM_GETDATA;
-		NN_VLA(char, buf, eeprom.size);
-		ereq.buf = buf;
-		ereq.buflen = eeprom.size;
+		e = nn_pushlstringBuffer(C, eeprom.dataSize, &ereq.buf);
+		if(e) return e;
+		ereq.buflen = eeprom.dataSize;
 		e = state->handler(&ereq);
 		if(e) return e;
 		req->returnCount = 1;
-		return nn_pushlstring(C, ereq.buf, ereq.buflen);
+		return nn_commitlstring(C, ereq.buflen);
 	}
 	if(method == NN_EENUM_GETLABEL) {
 		ereq.action = NN_EEPROM_GETLABEL;
@@ -4582,28 +6950,28 @@ static nn_Exit nn_fsHandler(nn_ComponentRequest *req) {
 		if(e) return e;
 		if(nn_checknumber(C, 1, "bad argument #2 (number expected)")) return NN_EBADCALL;
 		double requested = nn_tonumber(C, 1);
+		// NaN gets past both clamps, while math.huge is a common way to ask for everything
+		if(requested != requested) {
+			nn_setError(C, "bad argument #2 (number expected)");
+			return NN_EBADCALL;
+		}
 		if(requested > state->fs.maxReadSize) requested = state->fs.maxReadSize;
+		if(requested < 0) requested = 0;
 		freq.action = NN_FS_READ;
 		freq.fd = nn_tointeger(C, 0);
-		char *buf = nn_alloc(ctx, state->fs.maxReadSize);
-		if(buf == NULL) return NN_ENOMEM;
+		// read straight into the returned string
+		char *buf;
+		e = nn_pushlstringBuffer(C, requested, &buf);
+		if(e) return e;
 		freq.read.buf = buf;
 		freq.read.len = requested;
 		e = state->handler(&freq);
-		if(e) {
-			nn_free(ctx, buf, state->fs.maxReadSize);
-			return e;
-		}
-		if(freq.read.buf == NULL) {
-			nn_free(ctx, buf, state->fs.maxReadSize);
-			return NN_OK;
-		}
+		if(e) return e;
+		if(freq.read.buf == NULL) return nn_pop(C);
 		nn_costComponent(C, state->fs.readsPerTick);
 		nn_removeEnergy(C, state->fs.dataEnergyCost * freq.read.len);
 		req->returnCount = 1;
-		e = nn_pushlstring(C, buf, freq.read.len);
-		nn_free(ctx, buf, state->fs.maxReadSize);
-		return e;
+		return nn_commitlstring(C, freq.read.len);
 	}
 	if(method == NN_FSNUM_WRITE) {
 		if(nn_checkinteger(C, 0, "bad argument #1 (fd expected)")) return NN_EBADCALL;
@@ -4856,9 +7224,9 @@ bool nn_mergeFilesystems(nn_Filesystem *merged, const nn_Filesystem *fs, size_t
 	return true;
 }
 
-static void nn_drive_seekPenalty(nn_Computer *C, size_t lastSector, size_t newSector, const nn_Drive *drive) {
+double nn_getDriveSeekTime(const nn_Drive *drive, size_t lastSector, size_t newSector) {
 	// Check if SSD
-	if(drive->rpm == 0) return;
+	if(drive->rpm == 0) return 0;
 
 	size_t maxSectors = drive->capacity / drive->sectorSize;
 	size_t sectorsPerPlatter = maxSectors / drive->platterCount;
@@ -4877,8 +7245,42 @@ static void nn_drive_seekPenalty(nn_Computer *C, size_t lastSector, size_t newSe
 	}
 
 	// RPM over the number of sectors, over 60 seconds.
-	double latency = (double)sectorDelta * 60 / ((double)drive->rpm * maxSectors);
-	nn_addIdleTime(C, latency);
+	return (double)sectorDelta * 60 / ((double)drive->rpm * maxSectors);
+}
+
+static void nn_drive_seekPenalty(nn_Computer *C, size_t lastSector, size_t newSector, const nn_Drive *drive) {
+	nn_addIdleTime(C, nn_getDriveSeekTime(drive, lastSector, newSector));
+}
+
+// the penalty of seeking to each of count sectors in turn, as if they were accessed one by one
+static void nn_drive_seekSectors(nn_Computer *C, size_t lastSector, size_t sector, size_t count, const nn_Drive *drive) {
+	for(size_t i = 0; i < count; i++) {
+		nn_drive_seekPenalty(C, lastSector, sector + i, drive);
+		lastSector = sector + i;
+	}
+}
+
+// checks that count sectors, starting at sec, are all on the device
+static bool nn_checkSectorRange(nn_Computer *C, size_t sectorCount, intptr_t sec, size_t count) {
+	if(sec < 1 || sec > sectorCount || count < 1 || count > sectorCount - sec + 1) {
+		nn_setError(C, "sector out of bounds");
+		return false;
+	}
+	return true;
+}
+
+// How many of count sectors the call budget still pays for, at perTick each.
+// Vectored calls stop short there, so they cost what single sector calls would.
+// It is at least 1, so every call makes progress, and at most NN_MAX_SECTORS.
+static size_t nn_sectorsAffordable(nn_Computer *C, size_t count, size_t perTick) {
+	if(count > NN_MAX_SECTORS) count = NN_MAX_SECTORS;
+	// free, or not rate limited
+	if(perTick == 0 || C->totalCallBudget <= 0) return count;
+	double budget = C->callBudget * perTick;
+	size_t affordable = budget;
+	if(affordable < budget) affordable++;
+	if(affordable < 1) affordable = 1;
+	return affordable < count ? affordable : count;
 }
 
 typedef enum nn_DrvNum {
@@ -4893,6 +7295,10 @@ typedef enum nn_DrvNum {
 	NN_DRVNUM_READBYTE,
 	NN_DRVNUM_READUBYTE,
 	NN_DRVNUM_WRITEBYTE,
+	NN_DRVNUM_READSECTORS,
+	NN_DRVNUM_WRITESECTORS,
+	NN_DRVNUM_SUBMITREAD,
+	NN_DRVNUM_SUBMITWRITE,
 
 	NN_DRVNUM_COUNT,
 } nn_DrvNum;
@@ -4916,7 +7322,17 @@ static nn_Exit nn_drvHandler(nn_ComponentRequest *request) {
 	nn_Exit e;
 
 	if(request->action == NN_COMP_USERDATA) return NN_OK;
-	if(request->action == NN_COMP_CHECKMETHOD) return NN_OK;
+	if(request->action == NN_COMP_CHECKMETHOD) {
+		unsigned int m = request->methodIdx;
+		// async I/O is opt-in
+		if(m == NN_DRVNUM_SUBMITREAD || m == NN_DRVNUM_SUBMITWRITE) {
+			dreq.action = NN_DRIVE_ISASYNC;
+			dreq.async = false;
+			state->handler(&dreq);
+			request->methodEnabled = dreq.async;
+		}
+		return NN_OK;
+	}
 
 	if(request->action == NN_COMP_DROP) {
 		dreq.action = NN_DRIVE_DROP;
@@ -4926,6 +7342,44 @@ static nn_Exit nn_drvHandler(nn_ComponentRequest *request) {
 	}
 	size_t ss = state->drive.sectorSize;
 	size_t sectorCount = state->drive.capacity / ss;
+	if(request->action == NN_COMP_FORGET) {
+		dreq.action = NN_DRIVE_FORGET;
+		return state->handler(&dreq);
+	}
+	if(request->action == NN_COMP_POLL) {
+		char *buf = nn_alloc(ctx, ss);
+		if(buf == NULL) {
+			// try again next tick
+			request->pollAt = nn_getUptime(C);
+			return NN_ENOMEM;
+		}
+		bool retry = false;
+		dreq.poll.buf = buf;
+		while(true) {
+			dreq.action = NN_DRIVE_POLL;
+			dreq.poll.done = false;
+			dreq.poll.read = false;
+			dreq.poll.err = NN_OK;
+			dreq.poll.pollAt = -1;
+			e = state->handler(&dreq);
+			if(e || !dreq.poll.done) break;
+			const char *err = NULL;
+			if(dreq.poll.err == NN_ENOMEM) err = "out of memory";
+			else if(dreq.poll.err) err = "drive error";
+			// the drive keeps it until the signal is pushed, so a full signal queue is tried again next tick
+			if(nn_pushDriveDone(C, request->compAddress, dreq.poll.id, dreq.poll.read ? buf : NULL, ss, err)) {
+				nn_clearstack(C);
+				retry = true;
+				break;
+			}
+			dreq.action = NN_DRIVE_RETIRE;
+			e = state->handler(&dreq);
+			if(e) break;
+		}
+		nn_free(ctx, buf, ss);
+		request->pollAt = retry ? nn_getUptime(C) : dreq.poll.pollAt;
+		return e;
+	}
 	unsigned int method = request->methodIdx;
 	if(method == NN_DRVNUM_GETCAPACITY) {
 		request->returnCount = 1;
@@ -4981,21 +7435,147 @@ static nn_Exit nn_drvHandler(nn_ComponentRequest *request) {
 		nn_costComponent(C, state->drive.readsPerTick);
 		nn_removeEnergy(C, state->drive.dataEnergyCost * ss);
 
-		char *sector = nn_alloc(ctx, ss);
-		if(sector == NULL) return NN_ENOMEM;
+		char *sector;
+		e = nn_pushlstringBuffer(C, ss, &sector);
+		if(e) return e;
 
 		dreq.action = NN_DRIVE_READSECTOR;
 		dreq.readSector.sector = sec;
 		dreq.readSector.buf = sector;
 		e = state->handler(&dreq);
-		if(e) {
-			nn_free(ctx, sector, ss);
-			return e;
+		if(e) return e;
+		request->returnCount = 1;
+		return nn_commitlstring(C, ss);
+	}
+	if(method == NN_DRVNUM_WRITESECTOR) {
+		if(nn_checkinteger(C, 0, "bad argument #1 (integer expected)")) return NN_EBADCALL;
+		if(nn_checkstring(C, 1, "bad argument #2 (string expected)")) return NN_EBADCALL;
+		int sec = nn_tointeger(C, 0);
+		if(sec < 1 || sec > sectorCount) {
+			nn_setError(C, "sector out of bounds");
+			return NN_EBADCALL;
+		}
+		size_t len;
+		const char *sector = nn_tolstring(C, 1, &len);
+		if(len != ss) {
+			nn_setError(C, "incorrect sector size");
+			return NN_EBADCALL;
 		}
+		dreq.action = NN_DRIVE_CURPOS;
+		e = state->handler(&dreq);
+		if(e) return e;
+
+		nn_drive_seekPenalty(C, dreq.curpos, sec, &state->drive);
+		nn_costComponent(C, state->drive.writesPerTick);
+		nn_removeEnergy(C, state->drive.dataEnergyCost * ss);
+
+		dreq.action = NN_DRIVE_WRITESECTOR;
+		dreq.writeSector.sector = sec;
+		dreq.writeSector.buf = sector;
+		e = state->handler(&dreq);
+		if(e) return e;
 		request->returnCount = 1;
-		e = nn_pushlstring(C, sector, ss);
-		nn_free(ctx, sector, ss);
-		return e;
+		return nn_pushbool(C, true);
+	}
+	if(method == NN_DRVNUM_READSECTORS) {
+		if(nn_checkinteger(C, 0, "bad argument #1 (integer expected)")) return NN_EBADCALL;
+		if(nn_checkinteger(C, 1, "bad argument #2 (integer expected)")) return NN_EBADCALL;
+		intptr_t sec = nn_tointeger(C, 0);
+		intptr_t count = nn_tointeger(C, 1);
+		if(count < 1) count = 0;
+		if(!nn_checkSectorRange(C, sectorCount, sec, count)) return NN_EBADCALL;
+		count = nn_sectorsAffordable(C, count, state->drive.readsPerTick);
+		dreq.action = NN_DRIVE_CURPOS;
+		e = state->handler(&dreq);
+		if(e) return e;
+
+		// costs the same as reading them one by one
+		nn_drive_seekSectors(C, dreq.curpos, sec, count, &state->drive);
+		nn_costComponentN(C, count, state->drive.readsPerTick);
+		nn_removeEnergy(C, state->drive.dataEnergyCost * ss * count);
+
+		char *sectors;
+		e = nn_pushlstringBuffer(C, ss * count, &sectors);
+		if(e) return e;
+
+		dreq.action = NN_DRIVE_READSECTORS;
+		dreq.readSectors.sector = sec;
+		dreq.readSectors.count = count;
+		dreq.readSectors.buf = sectors;
+		e = state->handler(&dreq);
+		if(e) return e;
+		request->returnCount = 1;
+		return nn_commitlstring(C, ss * count);
+	}
+	if(method == NN_DRVNUM_WRITESECTORS) {
+		if(nn_checkinteger(C, 0, "bad argument #1 (integer expected)")) return NN_EBADCALL;
+		if(nn_checkstring(C, 1, "bad argument #2 (string expected)")) return NN_EBADCALL;
+		intptr_t sec = nn_tointeger(C, 0);
+		size_t len;
+		const char *sectors = nn_tolstring(C, 1, &len);
+		if(len % ss != 0) {
+			nn_setError(C, "incorrect sector size");
+			return NN_EBADCALL;
+		}
+		size_t count = len / ss;
+		if(!nn_checkSectorRange(C, sectorCount, sec, count)) return NN_EBADCALL;
+		count = nn_sectorsAffordable(C, count, state->drive.writesPerTick);
+		len = count * ss;
+		dreq.action = NN_DRIVE_CURPOS;
+		e = state->handler(&dreq);
+		if(e) return e;
+
+		nn_drive_seekSectors(C, dreq.curpos, sec, count, &state->drive);
+		nn_costComponentN(C, count, state->drive.writesPerTick);
+		nn_removeEnergy(C, state->drive.dataEnergyCost * len);
+
+		dreq.action = NN_DRIVE_WRITESECTORS;
+		dreq.writeSectors.sector = sec;
+		dreq.writeSectors.count = count;
+		dreq.writeSectors.buf = sectors;
+		e = state->handler(&dreq);
+		if(e) return e;
+		request->returnCount = 1;
+		return nn_pushinteger(C, count);
+	}
+	if(method == NN_DRVNUM_SUBMITREAD || method == NN_DRVNUM_SUBMITWRITE) {
+		bool write = method == NN_DRVNUM_SUBMITWRITE;
+		if(nn_checkinteger(C, 0, "bad argument #1 (integer expected)")) return NN_EBADCALL;
+		if(write && nn_checkstring(C, 1, "bad argument #2 (string expected)")) return NN_EBADCALL;
+		intptr_t sec = nn_tointeger(C, 0);
+		if(!nn_checkSectorRange(C, sectorCount, sec, 1)) return NN_EBADCALL;
+		const char *data = NULL;
+		if(write) {
+			size_t len;
+			data = nn_tolstring(C, 1, &len);
+			if(len != ss) {
+				nn_setError(C, "incorrect sector size");
+				return NN_EBADCALL;
+			}
+		}
+		nn_Component *self = nn_getComponent(C, request->compAddress);
+		if(self == NULL) {
+			nn_setError(C, "drive is not mounted");
+			return NN_EBADCALL;
+		}
+		// asked for first, so a queued request always has a poll to complete it
+		e = nn_pollComponentAt(C, self, nn_getUptime(C));
+		if(e) return e;
+
+		// the seek is paid by the drive in the background, instead of by the computer
+		nn_costComponent(C, write ? state->drive.writesPerTick : state->drive.readsPerTick);
+		nn_removeEnergy(C, state->drive.dataEnergyCost * ss);
+
+		dreq.action = NN_DRIVE_SUBMIT;
+		dreq.submit.sector = sec;
+		dreq.submit.buf = data;
+		dreq.submit.id = 0;
+		dreq.submit.pollAt = nn_getUptime(C);
+		e = state->handler(&dreq);
+		if(e) return e;
+		nn_pollComponentAt(C, self, dreq.submit.pollAt);
+		request->returnCount = 1;
+		return nn_pushinteger(C, dreq.submit.id);
 	}
 
 	if(C) nn_setError(C, "drive: not implemented yet");
@@ -5013,10 +7593,14 @@ nn_Component *nn_createDrive(nn_Universe *universe, const char *address, const n
 		[NN_DRVNUM_GETLABEL] = {"getLabel", "function(): string? - Get drive label", NN_DIRECT},
 		[NN_DRVNUM_SETLABEL] = {"setLabel", "function(label: string?): string - Set drive label", NN_INDIRECT},
 		[NN_DRVNUM_READSECTOR] = {"readSector", "function(sector: integer): string - Read a sector from the drive", NN_DIRECT},
-		[NN_DRVNUM_WRITESECTOR] = {"writeSector", "function(sector: integer): boolean - Read a sector from the drive", NN_DIRECT},
+		[NN_DRVNUM_WRITESECTOR] = {"writeSector", "function(sector: integer, data: string): boolean - Write a sector to the drive", NN_DIRECT},
 		[NN_DRVNUM_READBYTE] = {"readByte", "function(byte: integer): integer - Read a single signed byte", NN_DIRECT},
 		[NN_DRVNUM_READUBYTE] = {"readUByte", "function(byte: integer): integer - Read a single unsigned byte", NN_DIRECT},
 		[NN_DRVNUM_WRITEBYTE] = {"writeByte", "function(byte: integer, value: integer): boolean - Write a single byte", NN_DIRECT},
+		[NN_DRVNUM_READSECTORS] = {"readSectors", "function(sector: integer, count: integer): string - Read consecutive sectors, starting at sector. Stops short once the call budget runs out, so it may return fewer", NN_DIRECT},
+		[NN_DRVNUM_WRITESECTORS] = {"writeSectors", "function(sector: integer, data: string): integer - Write consecutive sectors, starting at sector. The data must be a multiple of the sector size. Stops short once the call budget runs out, and returns how many were written", NN_DIRECT},
+		[NN_DRVNUM_SUBMITREAD] = {"submitRead", "function(sector: integer): integer - Queue a read of a sector. Returns its id, and a drive_done signal with the id and the data is queued once it completes", NN_DIRECT},
+		[NN_DRVNUM_SUBMITWRITE] = {"submitWrite", "function(sector: integer, data: string): integer - Queue a write of a sector. Returns its id, and a drive_done signal with the id and true is queued once it completes", NN_DIRECT},
 	};
 	nn_Exit e = nn_setComponentMethodsArray(c, methods, NN_DRVNUM_COUNT);
 	if(e) {
@@ -5093,6 +7677,8 @@ typedef enum nn_FlashNum {
 	NN_FLASHNUM_READBYTE,
 	NN_FLASHNUM_READUBYTE,
 	NN_FLASHNUM_WRITEBYTE,
+	NN_FLASHNUM_READSECTORS,
+	NN_FLASHNUM_WRITESECTORS,
 
 	NN_FLASHNUM_COUNT,
 } nn_FlashNum;
@@ -5190,21 +7776,17 @@ static nn_Exit nn_flashHandler(nn_ComponentRequest *request) {
 		nn_costComponent(C, state->flash.readsPerTick);
 		nn_removeEnergy(C, state->flash.dataEnergyCost * ss);
 
-		char *sector = nn_alloc(ctx, ss);
-		if(sector == NULL) return NN_ENOMEM;
+		char *sector;
+		e = nn_pushlstringBuffer(C, ss, &sector);
+		if(e) return e;
 
 		freq.action = NN_FLASH_READSECTOR;
 		freq.readsector.sec = sec;
 		freq.readsector.buf = sector;
 		e = state->handler(&freq);
-		if(e) {
-			nn_free(ctx, sector, ss);
-			return e;
-		}
+		if(e) return e;
 		request->returnCount = 1;
-		e = nn_pushlstring(C, sector, ss);
-		nn_free(ctx, sector, ss);
-		return e;
+		return nn_commitlstring(C, ss);
 	}
 	if(method == NN_FLASHNUM_WRITESECTOR) {
 		if(nn_checkinteger(C, 0, "bad argument #1 (integer expected)")) return NN_EBADCALL;
@@ -5242,6 +7824,70 @@ static nn_Exit nn_flashHandler(nn_ComponentRequest *request) {
 		request->returnCount = 1;
 		return nn_pushbool(C, true);
 	}
+	if(method == NN_FLASHNUM_READSECTORS) {
+		if(nn_checkinteger(C, 0, "bad argument #1 (integer expected)")) return NN_EBADCALL;
+		if(nn_checkinteger(C, 1, "bad argument #2 (integer expected)")) return NN_EBADCALL;
+		intptr_t sec = nn_tointeger(C, 0);
+		intptr_t count = nn_tointeger(C, 1);
+		if(count < 1) count = 0;
+		if(!nn_checkSectorRange(C, sectorCount, sec, count)) return NN_EBADCALL;
+		count = nn_sectorsAffordable(C, count, state->flash.readsPerTick);
+		nn_costComponentN(C, count, state->flash.readsPerTick);
+		nn_removeEnergy(C, state->flash.dataEnergyCost * ss * count);
+
+		char *sectors;
+		e = nn_pushlstringBuffer(C, ss * count, &sectors);
+		if(e) return e;
+
+		freq.action = NN_FLASH_READSECTORS;
+		freq.readsectors.sec = sec;
+		freq.readsectors.count = count;
+		freq.readsectors.buf = sectors;
+		e = state->handler(&freq);
+		if(e) return e;
+		request->returnCount = 1;
+		return nn_commitlstring(C, ss * count);
+	}
+	if(method == NN_FLASHNUM_WRITESECTORS) {
+		if(nn_checkinteger(C, 0, "bad argument #1 (integer expected)")) return NN_EBADCALL;
+		if(nn_checkstring(C, 1, "bad argument #2 (string expected)")) return NN_EBADCALL;
+		intptr_t sec = nn_tointeger(C, 0);
+		size_t len;
+		const char *sectors = nn_tolstring(C, 1, &len);
+		if(len % ss != 0) {
+			nn_setError(C, "incorrect sector size");
+			return NN_EBADCALL;
+		}
+		size_t count = len / ss;
+		if(!nn_checkSectorRange(C, sectorCount, sec, count)) return NN_EBADCALL;
+		count = nn_sectorsAffordable(C, count, state->flash.writesPerTick);
+		len = count * ss;
+		freq.action = NN_FLASH_GETWRITES;
+		e = state->handler(&freq);
+		if(e) return e;
+		if(freq.writeCount >= maxWrite * sectorCount) {
+			nn_setError(C, "flash is not conductive enough");
+			return NN_EBADCALL;
+		}
+
+		nn_costComponentN(C, count, state->flash.writesPerTick);
+		nn_removeEnergy(C, state->flash.dataEnergyCost * len);
+
+		// every sector is amplified on its own
+		size_t writesAdded = 0;
+		for(size_t i = 0; i < count; i++) writesAdded += nn_flash_writesAdded(ctx, &state->flash);
+
+		freq.action = NN_FLASH_WRITESECTORS;
+		freq.writesectors.sec = sec;
+		freq.writesectors.count = count;
+		freq.writesectors.buf = sectors;
+		freq.writesectors.writesAdded = writesAdded;
+		e = state->handler(&freq);
+		if(e) return e;
+
+		request->returnCount = 1;
+		return nn_pushinteger(C, count);
+	}
 
 	if(C) nn_setError(C, "nandflash: not implemented yet");
 	return NN_EBADCALL;
@@ -5263,6 +7909,8 @@ nn_Component *nn_createFlash(nn_Universe *universe, const char *address, const n
 		[NN_FLASHNUM_READBYTE] = {"readByte", "function(byte: integer): integer - Read an individual signed byte", NN_DIRECT},
 		[NN_FLASHNUM_READUBYTE] = {"readUByte", "function(byte: integer): integer - Read an individual unsigned byte", NN_DIRECT},
 		[NN_FLASHNUM_WRITEBYTE] = {"writeByte", "function(byte: integer, value: integer): boolean - Write a byte"},
+		[NN_FLASHNUM_READSECTORS] = {"readSectors", "function(sector: integer, count: integer): string - Read consecutive logical sectors, starting at sector. Stops short once the call budget runs out, so it may return fewer", NN_DIRECT},
+		[NN_FLASHNUM_WRITESECTORS] = {"writeSectors", "function(sector: integer, data: string): integer - Write consecutive logical sectors, starting at sector. The data must be a multiple of the sector size. Stops short once the call budget runs out, and returns how many were written", NN_DIRECT},
 	};
 	nn_Exit e = nn_setComponentMethodsArray(c, methods, NN_FLASHNUM_COUNT);
 	if(e) {
@@ -6606,19 +9254,16 @@ static nn_Exit nn_dataHandler(nn_ComponentRequest *req) {
 		}
 		if(n > dataCard.maxRandom) return NN_ELIMIT;
 		nn_removeEnergy(C, dataCard.complexCost + dataCard.complexCostByte * n);
-		char *buf = nn_alloc(ctx, n);
+		char *buf;
+		e = nn_pushlstringBuffer(C, n, &buf);
+		if(e) return e;
 		dreq.action = NN_DATA_RANDOM;
 		dreq.randbuf.buf = buf;
 		dreq.randbuf.buflen = n;
 		e = state->handler(&dreq);
-		if(e) {
-			nn_free(ctx, buf, n);
-			return e;
-		}
+		if(e) return e;
 		req->returnCount = 1;
-		e = nn_pushlstring(C, buf, n);
-		nn_free(ctx, buf, n);
-		return e;
+		return nn_commitlstring(C, n);
 	}
 	if(method == NN_DATANUM_ENCRYPT) {
 		nn_costComponent(C, dataCard.encryptPerTick);
@@ -97,6 +97,28 @@ void *_alloca(size_t);
 #define NN_MAX_SIGNALSIZE 8192
 // maximum amount of signals.
 #define NN_MAX_SIGNALS 128
+// the amount of values all queued signals of a computer can hold at once.
+// Every value costs at least 2, so a signal of NN_MAX_SIGNALSIZE always fits.
+#define NN_MAX_SIGNALVALUES (NN_MAX_SIGNALSIZE / 2)
+// maximum amount of memory strings and tables on the call stack can take from the computer's transient arena.
+// Past it, they are allocated normally.
+#define NN_MAX_TRANSIENT (64 * NN_KiB)
+// maximum amount of sectors one readSectors or writeSectors call moves, even if the call budget allows more
+#define NN_MAX_SECTORS 256
+// maximum amount of calls in one nn_invokeBatch()
+#define NN_MAX_BATCH 64
+// maximum amount of (component type, method) pairs a computer's profile can hold
+#define NN_MAX_PROFILE 128
+// maximum length of the names in a profile entry. Longer ones are truncated.
+#define NN_MAX_PROFILENAME 64
+// amount of buckets in the latency histogram of a profile entry
+#define NN_PROFILE_BUCKETS 64
+// maximum length of the method, signal and address names in a trace event. Longer ones are truncated.
+#define NN_MAX_TRACENAME 40
+// maximum amount of components a computer can have pending polls for, see nn_pollComponentAt()
+#define NN_MAX_POLLS 16
+// maximum amount of posted signals waiting in a computer's inbox. Must be a power of 2.
+#define NN_MAX_INBOX 256
 // the maximum value of a port. Ports start at 1.
 #define NN_MAX_PORT 65535
 // the magic port number to close all ports
@@ -263,6 +285,11 @@ void *nn_realloc(nn_Context *ctx, void *memory, size_t oldSize, size_t newSize);
 char *nn_strdup(nn_Context *ctx, const char *s);
 void nn_strfree(nn_Context *ctx, char *s);
 
+// The string hash used by NN, for component addresses and method names.
+// It is not stable across platforms or versions, so do not store it. It is never 0.
+size_t nn_strhash(const char *s);
+size_t nn_lstrhash(const char *s, size_t len);
+
 typedef struct nn_Lock nn_Lock;
 
 nn_Lock *nn_createLock(nn_Context *ctx);
@@ -423,6 +450,10 @@ typedef enum nn_EnvironmentAction {
 	NN_ENV_CRASHED,
 	NN_ENV_BEEP,
 	NN_ENV_BEEPMORSE,
+	// a signal came in for a computer blocked in nn_waitForSignal(), so it should be ticked soon.
+	// When the signal was posted with nn_postSignal(), this runs on the posting thread.
+	// It may be sent more than once per wait.
+	NN_ENV_WAKEUP,
 } nn_EnvironmentAction;
 
 typedef struct nn_EnvironmentRequest {
@@ -558,19 +589,33 @@ size_t nn_getFreeMemory(nn_Computer *computer);
 // This is just the total minus the free, and does not take into
 // account the overhead of storing the computer instance.
 size_t nn_getUsedMemory(nn_Computer *computer);
+// Returns how many component and userdata methods were invoked on the computer since it was created, including failed calls.
+size_t nn_getInvokeCount(nn_Computer *computer);
 // gets the current uptime of a computer. When the computer is not running, this value can be anything and loses all meaning.
 double nn_getUptime(nn_Computer *computer);
 
-// Deserialize an encoded computer state.
-// Encoding depends on architecture.
-// Will push it as a string and then call the architecture, which will decode it and pop it.
-nn_Exit nn_deserializeComputer(nn_Computer *computer, const char *buf, size_t buflen);
-
-// Serialize the computer state.
-// Encoding depends on architecture.
-// Pushes the output, if successful, as a string on the stack.
+// Snapshots are versioned binary images of a whole computer, so idle computers can be hibernated or moved to another process.
+// They hold the state, energy, uptime, users, tmp address, device info, component slots, queued signals,
+// userdata (through nn_serializeUserdata()) and the architecture's own state, which is opaque to NN.
+// Components are not part of it, as they belong to the host. Like the network encoding,
+// snapshots use the native sizes and endianness, and are rejected by machines where those differ.
+#define NN_SNAPSHOT_VERSION 1
+
+// Writes a snapshot of the computer into a buffer allocated with its context, which must be freed with nn_free(ctx, *buf, *len).
+// Posted signals are drained into the queue first, so only call this from whoever ticks the computer.
+// Requests still in flight in components, like queued drive I/O, are not part of a snapshot, and restoring one cancels them,
+// so a program waiting on their signals would hang. It thus returns NN_EBADSTATE while nn_getPendingPollCount() is not 0;
+// keep ticking the computer until they are done.
+nn_Exit nn_snapshotComputer(nn_Computer *computer, char **buf, size_t *len);
+
+// Serializes the computer with nn_snapshotComputer(), and pushes the snapshot, if successful, as a string on the stack.
 nn_Exit nn_serializeComputer(nn_Computer *computer);
 
+// Restores a snapshot into the computer, which is stopped first. Its architecture must be the snapshot's, or a supported one,
+// and every component of the snapshot must already be mounted, as their slots are restored but not the components themselves.
+// On failure, the computer may be left partially restored, and should be stopped.
+nn_Exit nn_deserializeComputer(nn_Computer *computer, const char *buf, size_t buflen);
+
 // address is copied.
 // It can be NULL if you wish to have no tmp address.
 // It can fail due to out-of-memory errors.
@@ -625,6 +670,15 @@ double nn_getTotalEnergy(nn_Computer *computer);
 double nn_getEnergy(nn_Computer *computer);
 // Returns true if there is no more energy left, and a blackout has occured.
 bool nn_removeEnergy(nn_Computer *computer, double energy);
+// Opts into a local energy ledger. nn_getEnergy() then returns a cached balance, and nn_removeEnergy() debits it,
+// instead of sending NN_ENV_DRAWENERGY every time.
+// The debits are sent as one NN_ENV_DRAWENERGY at the start of every nn_tick(), once they add up to [threshold] (if above 0),
+// or once the balance runs out, which is when a blackout is detected, like without the ledger.
+// Enabling or disabling it flushes the ledger.
+void nn_setEnergyLedger(nn_Computer *computer, bool enabled, double threshold);
+bool nn_hasEnergyLedger(nn_Computer *computer);
+// Sends the pending debits of the ledger to the environment and refreshes the balance. Does nothing without a ledger.
+void nn_flushEnergy(nn_Computer *computer);
 
 // copies the string into the local error buffer. The error is NULL terminated, but also capped by NN_MAX_ERROR_SIZE
 void nn_setError(nn_Computer *computer, const char *s);
@@ -649,6 +703,28 @@ bool nn_isComputerIdle(nn_Computer *computer);
 // Shifts over the idle timestamp.
 void nn_addIdleTime(nn_Computer *computer, double time);
 void nn_resetIdleTime(nn_Computer *computer);
+// Makes the computer idle for up to [timeout] seconds, or until a signal is pushed or posted to it, whichever comes first.
+// Meant for architectures which block on signals, so event-driven hosts do not need to poll it.
+// Once a signal comes in, the environment gets NN_ENV_WAKEUP, and the computer is moved to the front of the idle timer wheel.
+void nn_waitForSignal(nn_Computer *computer, double timeout);
+bool nn_isWaitingForSignal(nn_Computer *computer);
+
+// The universe keeps the idle computers in a timer wheel, keyed on their idle deadline, so hosts with many computers
+// do not need to tick every computer just to find out it is idle.
+// A computer enters the wheel when nn_tick() or nn_tickSynchronized() leaves it idle, and leaves it once ticked while not idle,
+// once polled, or once destroyed. A host can thus only tick the computers which are not idle, plus the ones nn_pollIdleTimers() returns.
+// The computers which are not in the wheel make up the universe's active set, which includes new computers and ones which are off.
+
+// Writes up to [max] computers whose idle deadline passed into [computers], moving them from the wheel to the active set, and returns how many there were.
+// Their deadlines are 1ms granular. The computers are not retained.
+size_t nn_pollIdleTimers(nn_Universe *universe, nn_Computer **computers, size_t max);
+// Writes up to [max] computers of the active set into [computers] and returns how many it wrote.
+// Call nn_pollIdleTimers() first so the ones whose deadline passed are in it. The computers are not retained.
+size_t nn_getActiveComputers(nn_Universe *universe, nn_Computer **computers, size_t max);
+size_t nn_getActiveCount(nn_Universe *universe);
+// Returns how many seconds at least until nn_pollIdleTimers() returns something, so a host can sleep,
+// 0 if it already would, or -1 if no computer is in the wheel.
+double nn_timeUntilIdleTimer(nn_Universe *universe);
 // runs a tick of the computer. Make sure to check the state as well!
 // Does not do anything if we're currently waiting on a synced call
 // This automatically resets the component budgets and call budget.
@@ -662,6 +738,49 @@ nn_Exit nn_tick(nn_Computer *computer);
 // Architectures should generally NOT ignore this if they can.
 nn_Exit nn_tickSynchronized(nn_Computer *computer);
 
+// A scheduler ticks many computers in rounds, spreading nn_tick() over a pool of workers which steal work from each other,
+// and then running nn_tickSynchronized() for every computer on the calling thread.
+// NN does not create threads. Worker 0 is whoever calls nn_tickScheduler(), while the other workers are threads
+// owned by you which call nn_runSchedulerWorker() in a loop.
+typedef struct nn_Scheduler nn_Scheduler;
+
+// Statistics of a worker, accumulated since the scheduler was created or its stats were reset.
+typedef struct nn_SchedulerStats {
+	// how many computers it ticked
+	size_t ticks;
+	// how many of those were stolen from other workers
+	size_t steals;
+	// seconds spent ticking computers
+	double busyTime;
+	// seconds spent in rounds. busyTime / roundTime is the utilization of the worker.
+	double roundTime;
+} nn_SchedulerStats;
+
+// [maxComputers] is how many computers can be scheduled at once, [workerCount] is at least 1.
+nn_Scheduler *nn_createScheduler(nn_Universe *universe, size_t maxComputers, size_t workerCount);
+// No worker may be running when it is destroyed.
+void nn_destroyScheduler(nn_Scheduler *scheduler);
+// Retains the computer and ticks it in every round it is not idle in. Must not be called during a round.
+// A computer can only be in one scheduler, of its own universe.
+nn_Exit nn_scheduleComputer(nn_Scheduler *scheduler, nn_Computer *computer);
+// Drops the computer if it was scheduled. Must not be called during a round.
+void nn_unscheduleComputer(nn_Scheduler *scheduler, nn_Computer *computer);
+size_t nn_getScheduledCount(nn_Scheduler *scheduler);
+size_t nn_getSchedulerWorkerCount(nn_Scheduler *scheduler);
+// Runs a round: it polls the idle timers, then every scheduled computer in the active set which is running or booting up is ticked by the workers,
+// and then gets a synchronized tick on the calling thread. Idle computers are not looked at, so a round costs as much as the active set.
+// The exits of the ticks are not reported, check the computer states afterwards, like you would after nn_tick().
+// Idle computers have their inbox drained once their timer expires, or once a signal wakes them up if they wait for one.
+// This blocks until the round is over, and if there are no other workers, it ticks everything itself.
+void nn_tickScheduler(nn_Scheduler *scheduler);
+// Ticks computers of the current round, from the worker's own queue and then from others, until there are none left.
+// Returns how many computers it ticked, so a worker thread can sleep or yield when it returns 0.
+// [worker] must be between 1 and the worker count - 1, and only one thread may use each worker.
+size_t nn_runSchedulerWorker(nn_Scheduler *scheduler, size_t worker);
+void nn_getSchedulerStats(nn_Scheduler *scheduler, size_t worker, nn_SchedulerStats *stats);
+// Must not be called during a round.
+void nn_resetSchedulerStats(nn_Scheduler *scheduler);
+
 // raw component and methods
 
 typedef struct nn_Component nn_Component;
@@ -697,6 +816,11 @@ typedef enum nn_ComponentAction {
 	NN_COMP_CHECKMETHOD,
 	// userdata request
 	NN_COMP_USERDATA,
+	// a poll asked for with nn_pollComponentAt() is due
+	NN_COMP_POLL,
+	// the computer stopped, so whatever the component kept for it should be dropped.
+	// Only sent to components which asked for a poll.
+	NN_COMP_FORGET,
 } nn_ComponentAction;
 
 typedef enum nn_UserdataAction {
@@ -742,6 +866,9 @@ typedef struct nn_ComponentRequest {
 		// method enabled
 		bool methodEnabled;
 		nn_UserdataRequest *user;
+		// for NN_COMP_POLL, set to the uptime to be polled again at.
+		// It starts negative, meaning no further polls.
+		double pollAt;
 	};
 } nn_ComponentRequest;
 
@@ -806,6 +933,17 @@ nn_Exit nn_unmountComponent(nn_Computer *c, const char *address, bool silent);
 nn_Exit nn_swapComponents(nn_Computer *c, nn_Component *previous, nn_Component *next, int slot);
 // gets a component by address. Will return NULL if there is none.
 nn_Component *nn_getComponent(nn_Computer *c, const char *address);
+// like nn_getComponent, but with the address already hashed by nn_strhash().
+// Useful for addresses which are looked up often, like the screen a GPU is bound to.
+nn_Component *nn_getComponentHashed(nn_Computer *c, const char *address, size_t hash);
+// Asks for the component to be sent NN_COMP_POLL once the computer's uptime reaches at, from within nn_tick().
+// It is how components finish work in the background, like queued I/O. A computer waiting for a signal
+// wakes up for it. The component is retained until then, and a component only has one pending poll per computer,
+// so this moves the previous one. Returns NN_ELIMIT if the computer already has NN_MAX_POLLS of them.
+// When the computer stops, pending polls are cancelled with NN_COMP_FORGET.
+nn_Exit nn_pollComponentAt(nn_Computer *c, nn_Component *comp, double at);
+// how many components have a pending poll, which is work in flight that snapshots cannot hold
+size_t nn_getPendingPollCount(nn_Computer *c);
 int nn_getComponentSlot(nn_Computer *c, const char *address);
 size_t nn_countComponents(nn_Computer *c);
 void nn_getComponents(nn_Computer *c, const char **components);
@@ -817,6 +955,47 @@ void nn_getComponents(nn_Computer *c, const char **components);
 // In the case of errors, the contents of the stack is undefined
 nn_Exit nn_invokeComponent(nn_Computer *computer, const char *compAddress, const char *method);
 
+// A component method resolved by nn_resolveMethod().
+// The fields are private, only pass it around.
+typedef struct nn_MethodHandle {
+	nn_Computer *computer;
+	nn_Component *component;
+	size_t generation;
+	unsigned int methodIdx;
+	nn_MethodFlags flags;
+	const char *method;
+} nn_MethodHandle;
+
+// Resolves a method of a mounted component into a handle, so invoking it does not look up the address or method name again.
+// Handles are invalidated when any component is unmounted from the computer, after which they must be resolved again.
+// Handles do not retain the component, and are only valid on the computer which resolved them.
+nn_Exit nn_resolveMethod(nn_Computer *computer, const char *compAddress, const char *method, nn_MethodHandle *handle);
+// like nn_resolveMethod, but with the address already hashed by nn_strhash(), like nn_getComponentHashed().
+nn_Exit nn_resolveMethodHashed(nn_Computer *computer, const char *compAddress, size_t hash, const char *method, nn_MethodHandle *handle);
+// whether the handle can still be invoked.
+bool nn_isMethodHandleValid(nn_Computer *computer, const nn_MethodHandle *handle);
+// the method flags at the time it was resolved.
+nn_MethodFlags nn_getMethodHandleFlags(const nn_MethodHandle *handle);
+// same semantics as nn_invokeComponent, but with a resolved method.
+// Errors if the handle is no longer valid.
+nn_Exit nn_invokeHandle(nn_Computer *computer, const nn_MethodHandle *handle);
+
+// One call of nn_invokeBatch()
+typedef struct nn_BatchCall {
+	const nn_MethodHandle *handle;
+	// how many arguments it takes from the stack
+	size_t argc;
+	// set to how many values it returned
+	size_t retc;
+} nn_BatchCall;
+
+// Invokes many methods in one go, to amortize the overhead of each call.
+// The stack must contain exactly the arguments of every call, in order.
+// On return, it contains the results of every call which ran, in order, with calls[i].retc telling how many belong to each.
+// It stops early once the components are overused, or at the first error, which is returned.
+// [done] is set to how many calls returned successfully.
+nn_Exit nn_invokeBatch(nn_Computer *computer, nn_BatchCall *calls, size_t count, size_t *done);
+
 // send a signal to a component.
 // Computer actually can be NULL, but the component may crash if the signal
 // assumes one is specified.
@@ -856,6 +1035,70 @@ nn_Exit nn_serializeUserdata(nn_Computer *computer, size_t userdata);
 // NOTE: if the component does not exist, or the userdata index is already taken, this errors.
 nn_Exit nn_deserializeUserdata(nn_Computer *computer, size_t userdata, const char *compAddress, const char *buf, size_t len);
 
+// Profiling!!!
+// Only available if NeoNucleus is compiled with NN_PROFILE defined.
+// It records every nn_invokeComponent(), nn_invokeHandle() and nn_invokeUserdata() call, per component type and method.
+
+typedef struct nn_ProfileEntry {
+	char type[NN_MAX_PROFILENAME];
+	char method[NN_MAX_PROFILENAME];
+	// whether it is a method of userdata
+	bool userdata;
+	size_t calls;
+	// calls which returned an error
+	size_t errors;
+	// the total and highest time spent in the handler, in seconds
+	double time;
+	double maxTime;
+	// call budget spent, through nn_costComponent()
+	double budget;
+	// energy spent, through nn_removeEnergy()
+	double energy;
+	// a log-linear histogram of the latencies, see nn_getProfilePercentile()
+	unsigned int latency[NN_PROFILE_BUCKETS];
+} nn_ProfileEntry;
+
+typedef struct nn_Profile {
+	// when the window started, and how long it has been
+	double windowStart;
+	double windowTime;
+	// calls which were not recorded, as there were too many entries
+	size_t dropped;
+	size_t len;
+	nn_ProfileEntry entries[NN_MAX_PROFILE];
+} nn_Profile;
+
+// Starts or stops profiling. Stopping discards the profile.
+// Returns NN_EBADSTATE if profiling is not compiled in.
+nn_Exit nn_setProfiling(nn_Computer *computer, bool enabled);
+// Returns the profile of the current window, or NULL if not profiling.
+// It is only valid until the next call on this computer.
+const nn_Profile *nn_getProfile(nn_Computer *computer);
+// Clears the profile, which starts a new window.
+void nn_resetProfile(nn_Computer *computer);
+// Returns the latency under which [percentile] (0 to 1) of the calls were, in seconds.
+// It is precise to about 25%, as it comes from the histogram.
+double nn_getProfilePercentile(const nn_ProfileEntry *entry, double percentile);
+
+// Tracing!!!
+// Each computer can record its ticks, synchronized ticks, invokes, pushed and popped signals, and architecture events
+// into a fixed ring of events, which keeps the latest ones.
+// When off, it costs one branch per event.
+
+// Starts tracing into a ring of [capacity] events, or stops if [capacity] is 0.
+// Any previous events are discarded. Must not be called while exporting the trace of this computer.
+nn_Exit nn_setTracing(nn_Computer *computer, size_t capacity);
+bool nn_isTracing(nn_Computer *computer);
+// Records an instant event, meant for architectures, such as when they yield.
+void nn_traceInstant(nn_Computer *computer, const char *name);
+
+typedef void nn_TraceWriter(void *userdata, const char *data, size_t len);
+
+// Writes the events of the computers as Chrome Trace Event JSON, which Perfetto and chrome://tracing can open.
+// Each computer gets its own track, named after its address. Computers which are not tracing are skipped.
+// It may run while the computers are ticked on other threads; events overwritten meanwhile are left out.
+void nn_exportTrace(nn_Computer **computers, size_t count, nn_TraceWriter *writer, void *userdata);
+
 // default call budgets for 4 tiers of CPUs
 extern double nn_defaultCallBudgets[4];
 // the call budget of a creative CPU
@@ -917,6 +1160,12 @@ nn_Exit nn_pushstring(nn_Computer *computer, const char *str);
 // pushes a string on the call stack. The string is copied, so you can free it afterwards without worry. The copy will have a NULL terminator inserted
 // at the end for APIs which need it, but the length is also stored.
 nn_Exit nn_pushlstring(nn_Computer *computer, const char *str, size_t len);
+// pushes a string of [capacity] bytes and sets [buf] to its contents, so they can be written in place instead of copied.
+// Its final length must be set with nn_commitlstring() before anything else is pushed.
+nn_Exit nn_pushlstringBuffer(nn_Computer *computer, size_t capacity, char **buf);
+// sets the length of the string pushed by nn_pushlstringBuffer(), which must be at most its capacity.
+// If it fails, the string may have been popped.
+nn_Exit nn_commitlstring(nn_Computer *computer, size_t len);
 // pushes a computer userdata to the stack. This is indicative of a resource, such as an HTTP request.
 nn_Exit nn_pushuserdata(nn_Computer *computer, size_t userdataIdx);
 // pushes a table meant to be an array. [len] is the length of the array. The keys are numbers and 1-indexed, just like in Lua.
@@ -1032,9 +1281,13 @@ double nn_tonumber(nn_Computer *computer, size_t idx);
 // the behavior is platform, ABI and compiler-specific.
 intptr_t nn_tointeger(nn_Computer *computer, size_t idx);
 // Returns the string value at [idx].
+// Short strings are stored inside the stack slot, so the pointer is only valid while the value stays at [idx].
 const char *nn_tostring(nn_Computer *computer, size_t idx);
 // Returns the string value and its length at [idx].
 const char *nn_tolstring(nn_Computer *computer, size_t idx, size_t *len);
+// gets the component whose address is the string at idx, or NULL if there is none.
+// The hash of the string is cached, so looking it up again does not rehash it.
+nn_Component *nn_tocomponent(nn_Computer *computer, size_t idx);
 // Returns the userdata index at [idx].
 size_t nn_touserdata(nn_Computer *computer, size_t idx);
 // Takes a table value and pushes onto the stack the key-value pairs, as well as writes how many there were in [len].
@@ -1286,6 +1539,11 @@ nn_Exit nn_pushMotion(nn_Computer *computer, double relX, double relY, double re
 // This signal is queued when an internet socket is ready for commmunication.
 nn_Exit nn_pushInternetReady(nn_Computer *computer, const char *id, size_t idlen);
 
+// Pushes a drive_done signal, for a request queued with submitRead or submitWrite.
+// A read carries its data, a write carries true, and a failed request carries nil and the error.
+// data is NULL for a write, and error is NULL unless it failed.
+nn_Exit nn_pushDriveDone(nn_Computer *computer, const char *driveAddress, size_t id, const char *data, size_t len, const char *error);
+
 // A buffer with encoded values
 typedef struct nn_EncodedNetworkContents {
 	nn_Context *ctx;
@@ -1326,6 +1584,40 @@ nn_Exit nn_pushNetworkContents(nn_Computer *computer, const nn_EncodedNetworkCon
 // Note that relays should change the sender.
 nn_Exit nn_pushModemMessage(nn_Computer *computer, const char *modemAddress, const char *sender, int port, double distance, const nn_EncodedNetworkContents *contents);
 
+// Initializes empty contents, which values can be appended to without needing a computer.
+// This is how other threads build signals to post.
+void nn_initNetworkContents(nn_Context *ctx, nn_EncodedNetworkContents *contents);
+nn_Exit nn_appendnull(nn_EncodedNetworkContents *contents);
+nn_Exit nn_appendbool(nn_EncodedNetworkContents *contents, bool truthy);
+nn_Exit nn_appendnumber(nn_EncodedNetworkContents *contents, double num);
+nn_Exit nn_appendinteger(nn_EncodedNetworkContents *contents, intptr_t num);
+// appends a NULL-terminated string. If str is NULL, null is appended.
+nn_Exit nn_appendstring(nn_EncodedNetworkContents *contents, const char *str);
+nn_Exit nn_appendlstring(nn_EncodedNetworkContents *contents, const char *str, size_t len);
+// appends all the values of other.
+nn_Exit nn_appendNetworkContents(nn_EncodedNetworkContents *contents, const nn_EncodedNetworkContents *other);
+
+// Posts a signal made of the encoded values to the computer's inbox.
+// Unlike nn_pushSignal(), this can be called from any thread without locking the computer, as the inbox is a bounded lock-free queue.
+// Posted signals are moved into the signal queue at the start of nn_tick(), in the order they were posted.
+// On success, the inbox takes ownership of the contents, so do not drop them.
+// If the inbox is full, NN_ELIMIT is returned and the contents are still yours.
+// If NN_ATOMIC_NONE is defined, this is not thread-safe.
+nn_Exit nn_postSignal(nn_Computer *computer, nn_EncodedNetworkContents *contents);
+// Moves posted signals into the signal queue. This is called by nn_tick(), and must only be called by whoever ticks the computer.
+// Signals which do not fit in the queue yet are kept for later.
+// If the computer is not running, they are dropped, like with nn_pushSignal(), as are those from players which are not users.
+void nn_drainInbox(nn_Computer *computer);
+// Like their push counterparts, but posted to the inbox.
+// The player is checked against the users once the signal is drained, by the thread which ticks the computer,
+// so the users can change while other threads post signals.
+nn_Exit nn_postTouch(nn_Computer *computer, const char *screenAddress, double x, double y, int button, const char *player);
+nn_Exit nn_postKeyDown(nn_Computer *computer, const char *keyboardAddress, nn_codepoint charcode, int keycode, const char *player);
+nn_Exit nn_postKeyUp(nn_Computer *computer, const char *keyboardAddress, nn_codepoint charcode, int keycode, const char *player);
+nn_Exit nn_postRedstoneChanged(nn_Computer *computer, const char *redstoneAddress, int side, int oldValue, int newValue, int color);
+// This does not drop the network contents.
+nn_Exit nn_postModemMessage(nn_Computer *computer, const char *modemAddress, const char *sender, int port, double distance, const nn_EncodedNetworkContents *contents);
+
 // EEPROM class
 
 // reads and writes are always 1/1
@@ -1593,6 +1885,21 @@ typedef enum nn_DriveAction {
 	NN_DRIVE_WRITEBYTE,
 	// is drive read-only
 	NN_DRIVE_ISRO,
+	// read consecutive sectors into one buffer
+	NN_DRIVE_READSECTORS,
+	// write consecutive sectors from one buffer
+	NN_DRIVE_WRITESECTORS,
+	// whether submitRead and submitWrite are available. Computer is NULL.
+	NN_DRIVE_ISASYNC,
+	// queue a read or a write, to be completed later
+	NN_DRIVE_SUBMIT,
+	// complete one due request of the computer, if any. It stays queued, and is returned again, until it is retired.
+	// Writes must only land once, while reads may be done again.
+	NN_DRIVE_POLL,
+	// the drive_done signal of the request with the id in poll.id was pushed, so it can be dropped
+	NN_DRIVE_RETIRE,
+	// the computer stopped, so its requests should be dropped
+	NN_DRIVE_FORGET,
 } nn_DriveAction;
 
 typedef struct nn_DriveRequest {
@@ -1621,12 +1928,50 @@ typedef struct nn_DriveRequest {
 			size_t sector;
 			const char *buf;
 		} writeSector;
+		struct {
+			// 1-indexed, the first one
+			size_t sector;
+			size_t count;
+			// count * sectorSize bytes
+			char *buf;
+		} readSectors;
+		struct {
+			// 1-indexed, the first one
+			size_t sector;
+			size_t count;
+			// count * sectorSize bytes
+			const char *buf;
+		} writeSectors;
+		struct {
+			// 1-indexed
+			size_t sector;
+			// the data to write, sectorSize bytes, or NULL for a read
+			const char *buf;
+			// set to the id of the request, which its drive_done signal carries
+			size_t id;
+			// set to when the computer should poll next, in uptime
+			double pollAt;
+		} submit;
+		struct {
+			// sectorSize bytes, to read into
+			char *buf;
+			// set to whether a request completed
+			bool done;
+			// set to whether it was a read, with its data in buf
+			bool read;
+			size_t id;
+			// set if the request failed
+			nn_Exit err;
+			// set to when the computer should poll next, in uptime, or a negative number if nothing is left
+			double pollAt;
+		} poll;
 		struct {
 			// 1-indexed
 			size_t byte;
 			unsigned char value;
 		} writeByte;
 		bool readonly;
+		bool async;
 	};
 } nn_DriveRequest;
 
@@ -1635,6 +1980,8 @@ typedef nn_Exit (nn_DriveHandler)(nn_DriveRequest *request);
 nn_Component *nn_createDrive(nn_Universe *universe, const char *address, const nn_Drive *drive, void *state, nn_DriveHandler *handler);
 
 bool nn_mergeDrives(nn_Drive *merged, const nn_Drive *drives, size_t len);
+// How long the drive takes to seek from one sector to another, in seconds, which is what accessing sectors costs in idle time.
+double nn_getDriveSeekTime(const nn_Drive *drive, size_t from, size_t to);
 
 typedef struct nn_NandFlash {
 	// capacity of flash
@@ -1679,6 +2026,11 @@ typedef enum nn_FlashAction {
 	NN_FLASH_WRITEBYTE,
 	// get the amount of writes
 	NN_FLASH_GETWRITES,
+	// read consecutive sectors into one buffer
+	NN_FLASH_READSECTORS,
+	// write consecutive sectors from one buffer
+	// also adds an amount of writes
+	NN_FLASH_WRITESECTORS,
 } nn_FlashAction;
 
 typedef struct nn_FlashRequest {
@@ -1714,6 +2066,22 @@ typedef struct nn_FlashRequest {
 			// how many writes to add
 			size_t writesAdded;
 		} writebyte;
+		struct {
+			// count * sectorSize bytes
+			char *buf;
+			// 1-indexed, the first one
+			size_t sec;
+			size_t count;
+		} readsectors;
+		struct {
+			// count * sectorSize bytes
+			const char *buf;
+			// 1-indexed, the first one
+			size_t sec;
+			size_t count;
+			// how many writes to add, for all of them
+			size_t writesAdded;
+		} writesectors;
 		// for GETWRITES
 		size_t writeCount;
 		bool readonly;